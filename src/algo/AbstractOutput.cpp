@@ -5,60 +5,200 @@
  * See the LICENSE file for terms of use.
  */
 
-#include <sstream>
+#include <map>
+#include <vector>
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
-#include <boost/algorithm/string/replace.hpp>
 #include "boost-xtime.hpp"
+#include <boost/thread.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/iostreams/stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
 
 #include "AbstractOutput.hpp"
 #include "BlockSet.hpp"
 #include "Block.hpp"
 #include "name_to_stream.hpp"
+#include "Exception.hpp"
 #include "throw_assert.hpp"
 #include "global.hpp"
 
 namespace npge {
 
-typedef boost::shared_ptr<std::ostringstream> SstreamPtr;
-typedef std::map<Block*, SstreamPtr> Block2SP;
+typedef boost::mutex Mutex;
+typedef boost::mutex::scoped_lock Lock;
+typedef boost::condition_variable Condition;
+typedef boost::iostreams::back_insert_device<std::string> StringDevice;
+typedef boost::iostreams::stream<StringDevice> StringStream;
 
+// number of blocks per worker which can be printed
+// before previous blocks are written
+const int WINDOW_PER_WORKER = 8;
+
+/** Reorder buffer.
+Workers print blocks to buffers, writer thread writes them
+to the output in order of blocks. A worker waits if its block
+is too far from the first unwritten block, so at most window_
+buffers are in memory. Buffers are reused.
+*/
 struct AbstractOutput::Impl {
-    boost::mutex mutex_;
-    Block2SP block2op_;
-    Blocks blocks_;
-    Blocks::const_iterator blocks_it_;
+    Mutex mutex_;
+    Condition condition_;
+    std::map<const Block*, size_t> block2pos_;
+    std::vector<std::string*> window_; // by pos % window size
+    std::vector<std::string*> pool_; // free buffers
+    size_t written_; // number of written blocks
+    bool stop_;
+    std::string error_;
+    boost::thread writer_;
+    bool threaded_;
     boost::shared_ptr<std::ostream> out_;
-    bool main_thread_;
 
-    void move_text() {
-        // do not call this from concurent threads
-        std::vector<SstreamPtr> sstreams;
+    Impl():
+        written_(0), stop_(false), threaded_(false) {
+    }
+
+    ~Impl() {
+        stop_writer();
+        BOOST_FOREACH (std::string* buffer, window_) {
+            delete buffer;
+        }
+        BOOST_FOREACH (std::string* buffer, pool_) {
+            delete buffer;
+        }
+    }
+
+    void set_blocks(const Blocks& blocks, int workers) {
+        stop_writer();
+        block2pos_.clear();
+        for (size_t i = 0; i < blocks.size(); i++) {
+            block2pos_[blocks[i]] = i;
+        }
+        BOOST_FOREACH (std::string* buffer, window_) {
+            delete buffer;
+        }
+        window_.clear();
+        window_.resize(workers * WINDOW_PER_WORKER, 0);
+        written_ = 0;
+        stop_ = false;
+        error_.clear();
+        threaded_ = true;
+    }
+
+    void start_writer() {
+        writer_ = boost::thread(boost::bind(&Impl::write_loop, this));
+    }
+
+    void stop_writer() {
+        if (writer_.joinable()) {
+            {
+                Lock lock(mutex_);
+                stop_ = true;
+            }
+            condition_.notify_all();
+            writer_.join();
+        }
+        threaded_ = false;
+    }
+
+    /** Stop the writer and waiting workers, keep first error */
+    void fail(const std::string& message) {
         {
-            boost::mutex::scoped_lock lock(mutex_);
-            while (blocks_it_ != blocks_.end()) {
-                Block* block = *blocks_it_;
-                Block2SP::iterator it = block2op_.find(block);
-                if (it != block2op_.end()) {
-                    sstreams.push_back(it->second);
-                    block2op_.erase(it);
-                    blocks_it_++;
-                } else {
-                    break;
-                }
+            Lock lock(mutex_);
+            if (error_.empty()) {
+                error_ = message;
             }
+            stop_ = true;
         }
-        ASSERT_TRUE(out_);
-        std::ostream& out = *out_;
-        BOOST_FOREACH (SstreamPtr& sstr, sstreams) {
-            out << sstr->str();
+        condition_.notify_all();
+    }
+
+    /** Wait until all blocks are written.
+    Throw if the writer or a worker failed.
+    */
+    void finish_writer() {
+        {
+            Lock lock(mutex_);
+            while (written_ < block2pos_.size() && !stop_) {
+                condition_.wait(lock);
+            }
+        }
+        stop_writer();
+        if (!error_.empty()) {
+            throw Exception(error_);
         }
     }
 
-    void add_text(Block* block, const SstreamPtr& sstr) {
-        boost::mutex::scoped_lock lock(mutex_);
-        block2op_[block] = sstr;
+    std::string*& slot(size_t pos) {
+        return window_[pos % window_.size()];
+    }
+
+    /** Return position of the block, wait for free place in window */
+    size_t wait_for_window(const Block* block) {
+        std::map<const Block*, size_t>::const_iterator it =
+            block2pos_.find(block);
+        ASSERT_TRUE(it != block2pos_.end());
+        size_t pos = it->second;
+        Lock lock(mutex_);
+        while (pos >= written_ + window_.size() && !stop_) {
+            condition_.wait(lock);
+        }
+        if (stop_) {
+            throw Exception("Output was stopped: " + error_);
+        }
+        return pos;
+    }
+
+    std::string* get_buffer() {
+        Lock lock(mutex_);
+        if (pool_.empty()) {
+            return new std::string;
+        }
+        std::string* buffer = pool_.back();
+        pool_.pop_back();
+        return buffer;
+    }
+
+    void add_text(size_t pos, std::string* buffer) {
+        {
+            Lock lock(mutex_);
+            slot(pos) = buffer;
+        }
+        condition_.notify_all();
+    }
+
+    void write_loop() {
+        try {
+            while (true) {
+                std::string* buffer;
+                {
+                    Lock lock(mutex_);
+                    while (!stop_ && written_ < block2pos_.size() &&
+                            !slot(written_)) {
+                        condition_.wait(lock);
+                    }
+                    if (stop_ || written_ == block2pos_.size()) {
+                        break;
+                    }
+                    buffer = slot(written_);
+                    slot(written_) = 0;
+                }
+                out_->write(buffer->c_str(), buffer->size());
+                buffer->clear(); // capacity is kept
+                {
+                    Lock lock(mutex_);
+                    pool_.push_back(buffer);
+                    written_ += 1;
+                }
+                condition_.notify_all();
+            }
+        } catch (std::exception& e) {
+            fail(e.what());
+        } catch (...) {
+            fail("Unknown error in writer");
+        }
+        condition_.notify_all();
     }
 };
 
@@ -75,45 +215,53 @@ AbstractOutput::~AbstractOutput() {
 void AbstractOutput::change_blocks_impl(Blocks& blocks) const {
     sort_blocks(blocks);
     if (workers() >= 2) {
-        impl_->blocks_ = blocks;
-        impl_->blocks_it_ = impl_->blocks_.begin();
+        impl_->set_blocks(blocks, workers());
     }
 }
 
 void AbstractOutput::initialize_work_impl() const {
-    impl_->main_thread_ = false;
     std::string file = opt_value("file").as<std::string>();
     impl_->out_ = name_to_ostream(file);
     print_header(*impl_->out_);
     prepare();
-}
-
-ThreadData* AbstractOutput::before_thread_impl() const {
-    if (!impl_->main_thread_) {
-        impl_->main_thread_ = true;
-        return new ThreadData;
+    if (impl_->threaded_) {
+        impl_->start_writer();
     }
-    return 0;
 }
 
-void AbstractOutput::process_block_impl(Block* block, ThreadData* data) const {
-    if (workers() >= 2) {
-        SstreamPtr sstr(new std::ostringstream);
-        print_block(*sstr, block);
-        impl_->add_text(block, sstr);
-        if (data) {
-            // existance of data mark this thread as moving
-            // buffers to the output file
-            impl_->move_text();
+void AbstractOutput::process_block_impl(Block* block,
+                                        ThreadData*) const {
+    if (impl_->threaded_) {
+        size_t pos = impl_->wait_for_window(block);
+        std::string* buffer = impl_->get_buffer();
+        try {
+            StringStream stream(*buffer);
+            print_block(stream, block);
+        } catch (...) {
+            // the writer must not wait for this block
+            buffer->clear();
+            impl_->add_text(pos, buffer);
+            throw;
         }
+        impl_->add_text(pos, buffer);
     } else {
         print_block(*impl_->out_, block);
     }
+    // output does not change blocks, free cached matrix
+    block->drop_matrix();
+}
+
+void AbstractOutput::fail_thread_impl(ThreadData*,
+                                      const std::string& message) const {
+    if (impl_->threaded_) {
+        // blocks of the failed worker will never be printed
+        impl_->fail(message);
+    }
 }
 
 void AbstractOutput::finish_work_impl() const {
-    if (workers() >= 2) {
-        impl_->move_text();
+    if (impl_->threaded_) {
+        impl_->finish_writer();
     }
     print_footer(*impl_->out_);
     impl_->out_.reset(); // close file
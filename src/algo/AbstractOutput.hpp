@@ -14,7 +14,14 @@
 
 namespace npge {
 
-/** Print some function from blocks to file or to stdout */
+/** Print some function from blocks to file or to stdout.
+If workers() >= 2, blocks are printed to buffers by workers and
+written in order by separate writer thread. Workers wait if
+their blocks are too far ahead of the writer, so memory used
+for buffers does not depend on number of blocks.
+If a worker fails, the writer and other workers are stopped
+and the first error is thrown.
+*/
 class AbstractOutput : public BlocksJobs {
 public:
     /** Constructor */
@@ -29,10 +36,11 @@ protected:
 
     void initialize_work_impl() const;
 
-    ThreadData* before_thread_impl() const;
-
     void process_block_impl(Block* block, ThreadData* data) const;
 
+    void fail_thread_impl(ThreadData* data,
+                          const std::string& message) const;
+
     void finish_work_impl() const;
 
     /** Do something in the beginning.
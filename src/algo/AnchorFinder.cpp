@@ -6,36 +6,59 @@
  */
 
 #include <map>
+#include <algorithm>
+#include <queue>
+#include <fstream>
+#include <cstring>
 #include "boost-xtime.hpp"
+#include <boost/bind.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 #include <boost/foreach.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 
 #include "AnchorFinder.hpp"
 #include "SeqI.hpp"
+#include "hash128.hpp"
 #include "Block.hpp"
 #include "BlockSet.hpp"
-#include "BloomFilter.hpp"
+#include "Sequence.hpp"
+#include "BlockedBloomFilter.hpp"
 #include "Exception.hpp"
 #include "thread_pool.hpp"
 #include "throw_assert.hpp"
 #include "SortedVector.hpp"
+#include "HashSet.hpp"
+#include "HashCounter.hpp"
 #include "boundaries.hpp"
 #include "cast.hpp"
+#include "name_to_stream.hpp"
 
 namespace npge {
 
-typedef SortedVector<hash_t> Hashes;
-
 struct AnchorFinderImpl {
-    Hashes used_hashes_;
+    HashSet<hash_t> used_hashes_;
+    HashSet<hash128_t> used_wide_hashes_; // anchor > MAX_ANCHOR_SIZE
+    bool used_file_read_;
 };
 
 struct AnchorFinder::Impl : public AnchorFinderImpl {
 };
 
+static bool check_anchor_sampling(std::string& message,
+                                  Processor* p) {
+    std::string v = p->opt_value("anchor-sampling").as<std::string>();
+    if (v != "all" && v != "minimizer") {
+        message = "anchor-sampling must be 'all' or 'minimizer'";
+        return false;
+    }
+    return true;
+}
+
 AnchorFinder::AnchorFinder():
     impl_(new Impl) {
+    impl_->used_file_read_ = false;
     add_gopt("anchor-size", "anchor size", "ANCHOR_SIZE");
     add_gopt("anchor-fp",
              "Probability of false positive in Bloom filter "
@@ -43,12 +66,37 @@ AnchorFinder::AnchorFinder():
     add_opt("anchor-similar",
             "If neighbour anchors are skipped",
             true);
+    add_opt("anchor-sampling",
+            "Which k-mers are used as anchors "
+            "('all' or 'minimizer' of anchor-window k-mers)",
+            std::string("all"));
+    add_opt_check(boost::bind(check_anchor_sampling, _1, this));
+    add_opt("anchor-window",
+            "Number of k-mers in window of minimizer "
+            "(if anchor-sampling=minimizer)", 10);
+    add_opt_rule("anchor-window >= 1");
+    add_opt("anchor-exact-count",
+            "Count k-mers exactly instead of using Bloom filter "
+            "(needed for anchor-min-count and anchor-max-count)",
+            false);
+    add_opt("anchor-min-count",
+            "Minimum number of occurrences of anchor "
+            "(if anchor-exact-count)", 2);
+    add_opt("anchor-max-count",
+            "Maximum number of occurrences of anchor "
+            "(if anchor-exact-count, 0 means no limit)", 0);
+    add_opt_rule("anchor-min-count >= 2");
+    add_opt_rule("anchor-max-count >= 0");
+    add_opt("anchor-used-file",
+            "File with hashes of anchors found before "
+            "(read before first run, written after each run; "
+            "must match anchor-size and names of sequences)",
+            std::string(""));
     add_gopt("max-anchor-fragments",
              "Maximum number of anchors fragments to return",
              "MAX_ANCHOR_FRAGMENTS");
     add_opt_rule("anchor-size > 0");
-    int max_anchor_size = sizeof(hash_t) * 8 / 2;
-    add_opt_rule("anchor-size <= " + TO_S(MAX_ANCHOR_SIZE));
+    add_opt_rule("anchor-size <= " + TO_S(MAX_WIDE_ANCHOR_SIZE));
     declare_bs("target", "Blockset to search anchors in");
 }
 
@@ -62,6 +110,7 @@ struct AnchorFinderOptions : public SeqBase {
     double error_prob_;
     int max_anchor_fragments_;
     bool similar_;
+    int window_; // 0 means all k-mers
 
     AnchorFinderOptions(const AnchorFinder* f):
         SeqBase(*f->block_set()),
@@ -70,13 +119,217 @@ struct AnchorFinderOptions : public SeqBase {
         Decimal ep_d = f->opt_value("anchor-fp").as<Decimal>();
         error_prob_ = ep_d.to_d();
         similar_ = f->opt_value("anchor-similar").as<bool>();
+        window_ = 0;
+        std::string sampling;
+        sampling = f->opt_value("anchor-sampling").as<std::string>();
+        if (sampling == "minimizer") {
+            window_ = f->opt_value("anchor-window").as<int>();
+        }
         max_anchor_fragments_ =
             f->opt_value("max-anchor-fragments").as<int>();
         make_seqs();
     }
 };
 
-// Bloom filter
+// K-mers and found fragments are distributed to parts by hash,
+// so parts can be sorted and processed independently.
+const int PARTS_PER_WORKER = 4;
+
+template<typename H>
+static int part_of_hash(const H& hash, int parts) {
+    return mix_hash(fold_hash(hash)) % parts;
+}
+
+// exact counting of k-mers
+
+/** Hashes of k-mers with good number of occurrences, by parts */
+template<typename H>
+struct GoodHashes {
+    std::vector<HashSet<H> > parts_;
+
+    bool has_elem(const H& hash) const {
+        int part = part_of_hash(hash, parts_.size());
+        return parts_[part].has_elem(hash);
+    }
+};
+
+/** Part of k-mers counted by all workers */
+template<typename H>
+struct CountPart {
+    HashCounter<H> counts_;
+    boost::mutex mutex_;
+};
+
+template<typename H>
+class CountTG : public ReusingThreadGroup,
+    public AnchorFinderOptions {
+public:
+    typedef std::vector<H> Kmers;
+    typedef boost::shared_ptr<CountPart<H> > CountPartPtr;
+    typedef std::vector<CountPartPtr> Parts;
+
+    const HashSet<H>& used_;
+    int min_count_;
+    int max_count_; // 0 means no limit
+    Parts parts_; // counts of k-mers
+    GoodHashes<H> good_; // output
+    bool counting_; // if false, collect k-mers
+    int next_part_;
+
+    CountTG(const AnchorFinder* finder,
+            const HashSet<H>& used_hashes):
+        AnchorFinderOptions(finder),
+        used_(used_hashes),
+        counting_(false),
+        next_part_(0) {
+        min_count_ = finder->opt_value("anchor-min-count").as<int>();
+        max_count_ = finder->opt_value("anchor-max-count").as<int>();
+        set_workers(finder->workers());
+        parts_.resize(workers() * PARTS_PER_WORKER);
+        BOOST_FOREACH (CountPartPtr& part, parts_) {
+            part.reset(new CountPart<H>);
+        }
+        good_.parts_.resize(parts_.size());
+    }
+
+    void perform_stage(bool counting) {
+        counting_ = counting;
+        perform();
+    }
+
+    ThreadTask* create_task_impl(ThreadWorker* worker);
+
+    ThreadWorker* create_worker_impl();
+};
+
+/** Buffers k-mers of each part and adds them to counts of the part.
+Parts are locked once per BUFFER k-mers.
+*/
+template<typename H>
+class CollectWorker : public ThreadWorker {
+public:
+    typedef typename CountTG<H>::Kmers Kmers;
+
+    static const size_t BUFFER = 4096;
+
+    std::vector<Kmers> buffers_;
+
+    CollectWorker(ThreadGroup* group):
+        ThreadWorker(group) {
+        CountTG<H>* g = D_CAST<CountTG<H>*>(group);
+        buffers_.resize(g->parts_.size());
+    }
+
+    void add(const H& hash) {
+        int part = part_of_hash(hash, buffers_.size());
+        Kmers& buffer = buffers_[part];
+        buffer.push_back(hash);
+        if (buffer.size() >= BUFFER) {
+            flush(part);
+        }
+    }
+
+    void flush(int part) {
+        CountTG<H>* g = D_CAST<CountTG<H>*>(thread_group());
+        CountPart<H>& dst = *(g->parts_[part]);
+        Kmers& buffer = buffers_[part];
+        boost::mutex::scoped_lock lock(dst.mutex_);
+        BOOST_FOREACH (const H& hash, buffer) {
+            dst.counts_.add(hash);
+        }
+        buffer.clear();
+    }
+
+    ~CollectWorker() {
+        for (int i = 0; i < buffers_.size(); i++) {
+            flush(i);
+        }
+    }
+};
+
+template<typename H>
+class CollectTask : public ThreadTask {
+public:
+    typedef CountTG<H> TG;
+
+    Sequence* seq_;
+    int anchor_;
+    int window_;
+    const HashSet<H>& used_;
+    CollectWorker<H>* output_;
+
+    CollectTask(Sequence* seq, ThreadWorker* w):
+        ThreadTask(w),
+        seq_(seq),
+        anchor_(D_CAST<TG*>(thread_group())->anchor_),
+        window_(D_CAST<TG*>(thread_group())->window_),
+        used_(D_CAST<TG*>(thread_group())->used_),
+        output_(D_CAST<CollectWorker<H>*>(worker())) {
+    }
+
+    void process(const H& hash, pos_t /* pos */, int ori) {
+        if (ori != 0 && !used_.has_elem(hash)) {
+            output_->add(hash);
+        }
+    }
+
+    void run_impl() {
+        for_each_kmer<H>(seq_, anchor_, window_, *this);
+    }
+};
+
+template<typename H>
+class CountTask : public ThreadTask {
+public:
+    typedef CountTG<H> TG;
+    typedef typename HashCounter<H>::Count Count;
+
+    int part_;
+
+    CountTask(int part, ThreadWorker* w):
+        ThreadTask(w),
+        part_(part) {
+    }
+
+    void run_impl() {
+        TG* tg = D_CAST<TG*>(thread_group());
+        HashCounter<H>& counts = tg->parts_[part_]->counts_;
+        HashSet<H>& good = tg->good_.parts_[part_];
+        Count min_count = tg->min_count_;
+        Count max_count = HashCounter<H>::MAX_COUNT;
+        if (tg->max_count_ > 0) {
+            max_count = tg->max_count_;
+        }
+        typename TG::Kmers kmers;
+        counts.elements(kmers, min_count, max_count);
+        counts.clear();
+        BOOST_FOREACH (const H& hash, kmers) {
+            good.insert(hash);
+        }
+    }
+};
+
+template<typename H>
+ThreadTask* CountTG<H>::create_task_impl(ThreadWorker* worker) {
+    if (!counting_ && it_ != end_) {
+        Sequence* seq = *it_;
+        it_++;
+        return new CollectTask<H>(seq, worker);
+    } else if (counting_ && next_part_ < parts_.size()) {
+        int part = next_part_;
+        next_part_ += 1;
+        return new CountTask<H>(part, worker);
+    } else {
+        return 0;
+    }
+}
+
+template<typename H>
+ThreadWorker* CountTG<H>::create_worker_impl() {
+    return new CollectWorker<H>(this);
+}
+
+// Bloom filter (or exact counts)
 
 static size_t estimate_length(const BlockSet& bs) {
     typedef std::map<std::string, size_t> GenomeToLength;
@@ -96,20 +349,28 @@ static size_t estimate_length(const BlockSet& bs) {
     }
 }
 
+template<typename H>
 class BloomTG : public ReusingThreadGroup,
     public AnchorFinderOptions {
 public:
-    const Hashes& used_;
-    BloomFilter bloom_;
+    typedef SortedVector<H> Hashes;
+
+    const HashSet<H>& used_;
+    const GoodHashes<H>* good_; // 0 means Bloom filter
+    BlockedBloomFilter bloom_;
     Hashes hashes_; // output
     size_t length_sum_;
 
     BloomTG(const AnchorFinder* finder,
-            const Hashes& used_hashes):
+            const HashSet<H>& used_hashes,
+            const GoodHashes<H>* good = 0):
         AnchorFinderOptions(finder),
-        used_(used_hashes) {
+        used_(used_hashes),
+        good_(good) {
         set_workers(finder->workers());
-        initialize_bloom();
+        if (!good_) {
+            initialize_bloom();
+        }
     }
 
     static size_t pow4(int anchor_size) {
@@ -126,6 +387,10 @@ public:
                 length_sum_ = all_anchors;
             }
         }
+        if (window_) {
+            // density of minimizers is 2 / (w + 1)
+            length_sum_ = length_sum_ * 2 / (window_ + 1) + 1;
+        }
         bloom_.set_members(length_sum_, error_prob_);
         bloom_.set_optimal_hashes(length_sum_);
     }
@@ -135,8 +400,11 @@ public:
     ThreadWorker* create_worker_impl();
 };
 
+template<typename H>
 class BloomWorker : public ThreadWorker {
 public:
+    typedef SortedVector<H> Hashes;
+
     Hashes hashes_;
 
     BloomWorker(ThreadGroup* group):
@@ -144,35 +412,49 @@ public:
     }
 
     ~BloomWorker() {
-        BloomTG* g = D_CAST<BloomTG*>(thread_group());
+        BloomTG<H>* g = D_CAST<BloomTG<H>*>(thread_group());
         g->hashes_.extend(hashes_);
     }
 };
 
-class BloomTask : public ThreadTask, public SeqI {
+template<typename H>
+class BloomTask : public ThreadTask {
 public:
-    const Hashes& used_;
-    BloomFilter& bloom_;
+    typedef SortedVector<H> Hashes;
+    typedef BloomTG<H> TG;
+
+    Sequence* seq_;
+    int anchor_;
+    const HashSet<H>& used_;
+    const GoodHashes<H>* good_;
+    BlockedBloomFilter& bloom_;
     Hashes& hashes_;
     bool prev_;
     bool similar_;
+    int window_;
 
     BloomTask(Sequence* seq, ThreadWorker* w):
         ThreadTask(w),
-        SeqI(seq, D_CAST<BloomTG*>(thread_group())),
-        used_(D_CAST<BloomTG*>(thread_group())->used_),
-        bloom_(D_CAST<BloomTG*>(thread_group())->bloom_),
-        hashes_(D_CAST<BloomWorker*>(worker())->hashes_),
+        seq_(seq),
+        anchor_(D_CAST<TG*>(thread_group())->anchor_),
+        used_(D_CAST<TG*>(thread_group())->used_),
+        good_(D_CAST<TG*>(thread_group())->good_),
+        bloom_(D_CAST<TG*>(thread_group())->bloom_),
+        hashes_(D_CAST<BloomWorker<H>*>(worker())->hashes_),
         prev_(false),
-        similar_(D_CAST<BloomTG*>(thread_group())->similar_) {
+        similar_(D_CAST<TG*>(thread_group())->similar_),
+        window_(D_CAST<TG*>(thread_group())->window_) {
     }
 
-    void test_and_add() {
+    void process(const H& hash, pos_t /* pos */, int ori) {
         bool hash_found = false;
-        if (ns_ == 0) {
-            hash_t hash = std::min(dir_, rev_);
+        if (ori != 0) {
             if (!used_.has_elem(hash)) {
-                hash_found = bloom_.test_and_add(hash);
+                if (good_) {
+                    hash_found = good_->has_elem(hash);
+                } else {
+                    hash_found = bloom_.test_and_add(fold_hash(hash));
+                }
                 if (hash_found && (!prev_ || !similar_)) {
                     hashes_.push_back(hash);
                 }
@@ -182,57 +464,52 @@ public:
     }
 
     void run_impl() {
-        if (seq_->size() < anchor_) {
-            return;
-        }
-        init_state();
         prev_ = false;
-        test_and_add();
-        size_t n = seq_->size() - anchor_;
-        for (size_t i = 0; i < n; i++) {
-            next_hash();
-            test_and_add();
-        }
+        for_each_kmer<H>(seq_, anchor_, window_, *this);
     }
 };
 
-ThreadTask* BloomTG::create_task_impl(ThreadWorker* worker) {
+template<typename H>
+ThreadTask* BloomTG<H>::create_task_impl(ThreadWorker* worker) {
     if (it_ != end_) {
         Sequence* seq = *it_;
         it_++;
-        return new BloomTask(seq, worker);
+        return new BloomTask<H>(seq, worker);
     } else {
         return 0;
     }
 }
 
-ThreadWorker* BloomTG::create_worker_impl() {
-    return new BloomWorker(this);
+template<typename H>
+ThreadWorker* BloomTG<H>::create_worker_impl() {
+    return new BloomWorker<H>(this);
 }
 
-static void bloomtg_postprocess(BloomTG& g) {
+template<typename H>
+static void bloomtg_postprocess(BloomTG<H>& g) {
     g.bloom_.clear();
-    Hashes& hashes = g.hashes_;
+    SortedVector<H>& hashes = g.hashes_;
     hashes.sort();
     hashes.unique();
 }
 
 // find fragments matching found hashes
 
+template<typename H>
 struct FoundFragment {
-    hash_t hash_;
+    H hash_;
     Sequence* seq_;
     size_t pos_; // if ori = -1, pos = size + min_pos
 
     FoundFragment() {
     }
 
-    FoundFragment(hash_t hash, Sequence* seq, size_t pos):
+    FoundFragment(const H& hash, Sequence* seq, size_t pos):
         hash_(hash), seq_(seq), pos_(pos) {
     }
 
     bool operator<(const FoundFragment& o) const {
-        typedef boost::tuple<hash_t, Sequence*, size_t> Tie;
+        typedef boost::tuple<H, Sequence*, size_t> Tie;
         return Tie(hash_, seq_, pos_) <
                Tie(o.hash_, o.seq_, o.pos_);
     }
@@ -246,19 +523,23 @@ struct FoundFragment {
     }
 };
 
-typedef SortedVector<FoundFragment> FFs;
-
+template<typename H>
 class FragmentTG : public ReusingThreadGroup,
     public AnchorFinderOptions {
 public:
+    typedef SortedVector<H> Hashes;
+    typedef SortedVector<FoundFragment<H> > FFs;
+    typedef std::vector<FFs> Parts;
+
     const Hashes& hashes_; // input
-    FFs ffs_; // output
+    Parts parts_; // output
 
     FragmentTG(const Hashes& hashes,
                const AnchorFinder* finder):
         AnchorFinderOptions(finder),
         hashes_(hashes) {
         set_workers(finder->workers());
+        parts_.resize(workers() * PARTS_PER_WORKER);
     }
 
     ThreadTask* create_task_impl(ThreadWorker* worker);
@@ -266,77 +547,120 @@ public:
     ThreadWorker* create_worker_impl();
 };
 
+/** Keeps max-anchor-fragments smallest fragments found by worker.
+Only they can be among max-anchor-fragments smallest fragments
+found by all workers (see find_last()).
+*/
+template<typename H>
 class FragmentWorker : public ThreadWorker {
 public:
+    typedef typename FragmentTG<H>::FFs FFs;
+    typedef typename FragmentTG<H>::Parts Parts;
+
     FFs ffs_;
+    size_t max_ffs_;
 
     FragmentWorker(ThreadGroup* group):
         ThreadWorker(group) {
+        FragmentTG<H>* g = D_CAST<FragmentTG<H>*>(group);
+        max_ffs_ = std::max(g->max_anchor_fragments_, 0);
+    }
+
+    void add(const FoundFragment<H>& ff) {
+        if (max_ffs_ == 0) {
+            return;
+        }
+        ffs_.push_back(ff);
+        // prune rarely to keep adding O(1) amortized
+        if (ffs_.size() >= 2 * max_ffs_) {
+            prune();
+        }
+    }
+
+    void prune() {
+        if (ffs_.size() > max_ffs_) {
+            std::nth_element(ffs_.begin(), ffs_.begin() + max_ffs_,
+                             ffs_.end());
+            ffs_.resize(max_ffs_);
+        }
     }
 
     ~FragmentWorker() {
-        FragmentTG* g = D_CAST<FragmentTG*>(thread_group());
-        g->ffs_.extend(ffs_);
+        FragmentTG<H>* g = D_CAST<FragmentTG<H>*>(thread_group());
+        prune();
+        Parts parts(g->parts_.size());
+        BOOST_FOREACH (const FoundFragment<H>& ff, ffs_) {
+            int part = part_of_hash(ff.hash_, parts.size());
+            parts[part].push_back(ff);
+        }
+        FFs().swap(ffs_);
+        for (int i = 0; i < parts.size(); i++) {
+            if (g->parts_[i].empty()) {
+                g->parts_[i].swap(parts[i]);
+            } else {
+                g->parts_[i].extend(parts[i]);
+            }
+        }
     }
 };
 
-class FragmentTask : public ThreadTask, public SeqI {
+template<typename H>
+class FragmentTask : public ThreadTask {
 public:
+    typedef FragmentTG<H> TG;
+    typedef typename TG::Hashes Hashes;
+
+    Sequence* seq_;
+    int anchor_;
+    int window_;
     const Hashes& hashes_; // input
-    FFs& ffs_; // output
+    FragmentWorker<H>* output_;
 
     FragmentTask(Sequence* seq, ThreadWorker* w):
         ThreadTask(w),
-        SeqI(seq, D_CAST<FragmentTG*>(thread_group())),
-        hashes_(D_CAST<FragmentTG*>(thread_group())->hashes_),
-        ffs_(D_CAST<FragmentWorker*>(worker())->ffs_) {
+        seq_(seq),
+        anchor_(D_CAST<TG*>(thread_group())->anchor_),
+        window_(D_CAST<TG*>(thread_group())->window_),
+        hashes_(D_CAST<TG*>(thread_group())->hashes_),
+        output_(D_CAST<FragmentWorker<H>*>(worker())) {
     }
 
-    void push(hash_t hash, bool direct) {
-        size_t pos = pos_;
+    void push(const H& hash, pos_t pos, bool direct) {
+        size_t p = pos;
         if (direct == false) {
-            pos += seq_->size();
+            p += seq_->size();
         }
-        ffs_.push_back(FoundFragment(hash, seq_, pos));
+        output_->add(FoundFragment<H>(hash, seq_, p));
     }
 
-    void test_and_push() {
-        if (ns_ == 0) {
-            hash_t hash = std::min(dir_, rev_);
+    void process(const H& hash, pos_t pos, int ori) {
+        if (ori != 0) {
             bool hash_found = hashes_.has_elem(hash);
             if (hash_found) {
-                bool direct = (hash == dir_);
-                push(hash, direct);
+                push(hash, pos, ori == 1);
             }
         }
     }
 
     void run_impl() {
-        if (seq_->size() < anchor_) {
-            return;
-        }
-        init_state();
-        test_and_push();
-        size_t n = seq_->size() - anchor_;
-        for (size_t i = 0; i < n; i++) {
-            next_hash();
-            test_and_push();
-        }
+        for_each_kmer<H>(seq_, anchor_, window_, *this);
     }
 };
 
-ThreadTask* FragmentTG::create_task_impl(ThreadWorker* worker) {
+template<typename H>
+ThreadTask* FragmentTG<H>::create_task_impl(ThreadWorker* worker) {
     if (it_ != end_) {
         Sequence* seq = *it_;
         it_++;
-        return new FragmentTask(seq, worker);
+        return new FragmentTask<H>(seq, worker);
     } else {
         return 0;
     }
 }
 
-ThreadWorker* FragmentTG::create_worker_impl() {
-    return new FragmentWorker(this);
+template<typename H>
+ThreadWorker* FragmentTG<H>::create_worker_impl() {
+    return new FragmentWorker<H>(this);
 }
 
 static void check_block(const Block* block, int anchor) {
@@ -353,56 +677,313 @@ static void check_block(const Block* block, int anchor) {
     }
 }
 
-static void fragmenttg_postprocess(FragmentTG& tg,
-                                   Hashes& used_hashes) {
-    FFs& ffs = tg.ffs_;
-    ffs.sort();
-    ASSERT_TRUE(ffs.is_sorted_unique());
-    if (ffs.size() > tg.max_anchor_fragments_) {
-        ffs.resize(tg.max_anchor_fragments_);
+// sort parts and make blocks from them
+
+template<typename H>
+class PartsTG : public ReusingThreadGroup {
+public:
+    typedef FoundFragment<H> FF;
+    typedef SortedVector<FF> FFs;
+    typedef typename FragmentTG<H>::Parts Parts;
+
+    Parts& parts_; // input
+    int anchor_;
+    bool sort_; // if false, make blocks
+    const FF* last_; // last found fragment to use (0 = all)
+    int next_part_;
+    std::vector<Blocks> blocks_; // output
+    std::vector<SortedVector<H> > used_; // output
+
+    PartsTG(FragmentTG<H>& tg):
+        parts_(tg.parts_), anchor_(tg.anchor_),
+        sort_(true), last_(0), next_part_(0),
+        blocks_(parts_.size()), used_(parts_.size()) {
+        set_workers(tg.workers());
     }
-    int anchor = tg.anchor_;
-    BlockSet& bs = tg.bs_;
-    const FoundFragment* prev = 0;
-    Block* block = 0;
-    BOOST_FOREACH (const FoundFragment& ff, ffs) {
-        if (prev == 0) {
-            prev = &ff;
-        } else if (prev->hash_ == ff.hash_) {
-            if (block == 0) {
-                block = new Block;
-                bs.insert(block);
-                block->insert(prev->make_fragment(anchor));
+
+    void perform_stage(bool sort) {
+        sort_ = sort;
+        next_part_ = 0;
+        perform();
+    }
+
+    ThreadTask* create_task_impl(ThreadWorker* worker);
+};
+
+template<typename H>
+class PartTask : public ThreadTask {
+public:
+    typedef PartsTG<H> TG;
+    typedef typename TG::FF FF;
+    typedef typename TG::FFs FFs;
+
+    int part_;
+
+    PartTask(int part, ThreadWorker* w):
+        ThreadTask(w),
+        part_(part) {
+    }
+
+    void sort_part(FFs& ffs) {
+        ffs.sort();
+        ASSERT_TRUE(ffs.is_sorted_unique());
+    }
+
+    void make_blocks(FFs& ffs, const FF* last, int anchor,
+                     Blocks& blocks, SortedVector<H>& used) {
+        typename FFs::const_iterator end = ffs.end();
+        if (last) {
+            end = ffs.upper_bound(*last);
+        }
+        const FF* prev = 0;
+        Block* block = 0;
+        for (typename FFs::const_iterator it = ffs.begin();
+                it != end; ++it) {
+            const FF& ff = *it;
+            if (prev && prev->hash_ == ff.hash_) {
+                if (block == 0) {
+                    block = new Block;
+                    blocks.push_back(block);
+                    block->insert(prev->make_fragment(anchor));
+                }
+                ASSERT_TRUE(block);
+                block->insert(ff.make_fragment(anchor));
+            } else {
+                prev = &ff;
+                if (block) {
+                    check_block(block, anchor);
+                }
+                block = 0;
+                used.push_back(ff.hash_);
             }
-            ASSERT_TRUE(block);
-            block->insert(ff.make_fragment(anchor));
+        }
+        if (block) {
+            check_block(block, anchor);
+        }
+        FFs().swap(ffs);
+    }
+
+    void run_impl() {
+        TG* tg = D_CAST<TG*>(thread_group());
+        FFs& ffs = tg->parts_[part_];
+        if (tg->sort_) {
+            sort_part(ffs);
         } else {
-            prev = &ff;
-            if (block) {
-                check_block(block, anchor);
-            }
-            block = 0;
-            used_hashes.push_back(ff.hash_);
+            make_blocks(ffs, tg->last_, tg->anchor_,
+                        tg->blocks_[part_], tg->used_[part_]);
         }
     }
-    if (block) {
-        check_block(block, anchor);
+};
+
+template<typename H>
+ThreadTask* PartsTG<H>::create_task_impl(ThreadWorker* worker) {
+    if (next_part_ < parts_.size()) {
+        int part = next_part_;
+        next_part_ += 1;
+        return new PartTask<H>(part, worker);
+    } else {
+        return 0;
     }
 }
 
-void AnchorFinder::run_impl() const {
-    BloomTG bloomtg(this, impl_->used_hashes_);
+template<typename H>
+struct PartCursor {
+    const FoundFragment<H>* ff_;
+    const FoundFragment<H>* end_;
+
+    bool operator<(const PartCursor& o) const {
+        // reversed for std::priority_queue (max-heap)
+        return *o.ff_ < *ff_;
+    }
+};
+
+/** Return last found fragment among max_ffs smallest ones.
+Return 0 if number of found fragments <= max_ffs.
+max_ffs must be positive.
+Parts must be sorted.
+*/
+template<typename H>
+static const FoundFragment<H>* find_last(
+    const typename FragmentTG<H>::Parts& parts, size_t max_ffs) {
+    size_t total = 0;
+    BOOST_FOREACH (const typename FragmentTG<H>::FFs& ffs, parts) {
+        total += ffs.size();
+    }
+    if (total <= max_ffs) {
+        return 0;
+    }
+    typedef PartCursor<H> Cursor;
+    std::priority_queue<Cursor> queue;
+    BOOST_FOREACH (const typename FragmentTG<H>::FFs& ffs, parts) {
+        if (!ffs.empty()) {
+            Cursor cursor;
+            cursor.ff_ = &ffs.front();
+            cursor.end_ = &ffs.back() + 1;
+            queue.push(cursor);
+        }
+    }
+    const FoundFragment<H>* last = 0;
+    for (size_t i = 0; i < max_ffs; i++) {
+        Cursor cursor = queue.top();
+        queue.pop();
+        last = cursor.ff_;
+        cursor.ff_ += 1;
+        if (cursor.ff_ != cursor.end_) {
+            queue.push(cursor);
+        }
+    }
+    return last;
+}
+
+template<typename H>
+static void fragmenttg_postprocess(FragmentTG<H>& tg,
+                                   HashSet<H>& used_hashes) {
+    PartsTG<H> parts_tg(tg);
+    if (tg.max_anchor_fragments_ <= 0) {
+        return;
+    }
+    parts_tg.perform_stage(/* sort */ true);
+    parts_tg.last_ = find_last<H>(tg.parts_,
+                                  tg.max_anchor_fragments_);
+    parts_tg.perform_stage(/* sort */ false);
+    BlockSet& bs = tg.bs_;
+    for (int i = 0; i < tg.parts_.size(); i++) {
+        BOOST_FOREACH (Block* block, parts_tg.blocks_[i]) {
+            bs.insert(block);
+        }
+        BOOST_FOREACH (const H& hash, parts_tg.used_[i]) {
+            used_hashes.insert(hash);
+        }
+    }
+}
+
+template<typename H>
+static void find_anchors(const AnchorFinder* finder,
+                         HashSet<H>& used_hashes) {
+    GoodHashes<H> good;
+    bool exact = finder->opt_value("anchor-exact-count").as<bool>();
+    if (exact) {
+        CountTG<H> counttg(finder, used_hashes);
+        counttg.perform_stage(/* counting */ false);
+        counttg.perform_stage(/* counting */ true);
+        good.parts_.swap(counttg.good_.parts_);
+    }
+    BloomTG<H> bloomtg(finder, used_hashes, exact ? &good : 0);
     bloomtg.perform();
     bloomtg_postprocess(bloomtg);
-    FragmentTG fragmenttg(bloomtg.hashes_, this);
+    FragmentTG<H> fragmenttg(bloomtg.hashes_, finder);
     fragmenttg.perform();
     bloomtg.hashes_.clear();
-    bool sort_used_hashes = !impl_->used_hashes_.empty();
-    fragmenttg_postprocess(fragmenttg, impl_->used_hashes_);
-    if (sort_used_hashes) {
-        impl_->used_hashes_.sort();
+    fragmenttg_postprocess(fragmenttg, used_hashes);
+}
+
+// file with used hashes: magic, header, hash_t's, hash128_t's
+static const char USED_MAGIC[] = "NPGEUH02";
+
+/** Hashes are valid only for same anchor size and sequences */
+struct UsedHeader {
+    int32_t anchor_size_;
+    uint64_t seqs_checksum_; // of names of sequences
+};
+
+// FNV-1a of sorted names of sequences
+static uint64_t seqs_checksum(const BlockSet& bs) {
+    Strings names;
+    BOOST_FOREACH (const SequencePtr& seq, bs.seqs()) {
+        names.push_back(seq->name());
+    }
+    std::sort(names.begin(), names.end());
+    uint64_t result = 0xcbf29ce484222325ULL;
+    BOOST_FOREACH (const std::string& name, names) {
+        // '\0' separates names
+        for (int i = 0; i <= name.size(); i++) {
+            result ^= uint64_t((unsigned char)(name.c_str()[i]));
+            result *= 0x100000001b3ULL;
+        }
+    }
+    return result;
+}
+
+static UsedHeader make_used_header(const AnchorFinder* finder) {
+    UsedHeader header;
+    header.anchor_size_ = finder->opt_value("anchor-size").as<int>();
+    header.seqs_checksum_ = seqs_checksum(*finder->block_set());
+    return header;
+}
+
+static void read_used_hashes(AnchorFinderImpl* impl,
+                             const std::string& filename,
+                             const UsedHeader& expected) {
+    std::ifstream in(filename.c_str(), std::ios::binary);
+    if (!in) {
+        // no file yet
+        return;
+    }
+    char magic[sizeof(USED_MAGIC) - 1];
+    UsedHeader header;
+    if (!in.read(magic, sizeof(magic)) ||
+            memcmp(magic, USED_MAGIC, sizeof(magic)) != 0 ||
+            !in.read(reinterpret_cast<char*>(&header.anchor_size_),
+                     sizeof(header.anchor_size_)) ||
+            !in.read(reinterpret_cast<char*>(&header.seqs_checksum_),
+                     sizeof(header.seqs_checksum_))) {
+        throw Exception("Bad file with used hashes: " + filename);
+    }
+    if (header.anchor_size_ != expected.anchor_size_) {
+        throw Exception("File with used hashes " + filename +
+                        " was written with anchor-size=" +
+                        TO_S(header.anchor_size_));
+    }
+    if (header.seqs_checksum_ != expected.seqs_checksum_) {
+        throw Exception("File with used hashes " + filename +
+                        " was written for other sequences");
+    }
+    if (!impl->used_hashes_.read(in) ||
+            !impl->used_wide_hashes_.read(in)) {
+        throw Exception("Bad file with used hashes: " + filename);
+    }
+}
+
+static void write_used_hashes(const AnchorFinderImpl* impl,
+                              const std::string& filename,
+                              const UsedHeader& header) {
+    // file is replaced only when written completely
+    std::string tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp.c_str(), std::ios::binary);
+        out.write(USED_MAGIC, sizeof(USED_MAGIC) - 1);
+        out.write(reinterpret_cast<const char*>(&header.anchor_size_),
+                  sizeof(header.anchor_size_));
+        out.write(reinterpret_cast<const char*>(&header.seqs_checksum_),
+                  sizeof(header.seqs_checksum_));
+        impl->used_hashes_.write(out);
+        impl->used_wide_hashes_.write(out);
+        out.close();
+        if (!out) {
+            remove_file(tmp);
+            throw Exception("Can't write used hashes to " + filename);
+        }
+    }
+    rename_file(tmp, filename);
+}
+
+void AnchorFinder::run_impl() const {
+    std::string used_file;
+    used_file = opt_value("anchor-used-file").as<std::string>();
+    UsedHeader header = make_used_header(this);
+    if (!used_file.empty() && !impl_->used_file_read_) {
+        read_used_hashes(impl_, used_file, header);
+        impl_->used_file_read_ = true;
+    }
+    int anchor = opt_value("anchor-size").as<int>();
+    if (anchor <= MAX_ANCHOR_SIZE) {
+        find_anchors(this, impl_->used_hashes_);
+    } else {
+        find_anchors(this, impl_->used_wide_hashes_);
+    }
+    if (!used_file.empty()) {
+        write_used_hashes(impl_, used_file, header);
     }
-    ASSERT_TRUE(impl_->used_hashes_.is_sorted_unique());
 }
 
 const char* AnchorFinder::name_impl() const {
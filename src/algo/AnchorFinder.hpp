@@ -20,10 +20,31 @@ returned as a anchor (unless --anchor-similar=false).
 
 AnchorFinder memorizes hashes of previous run()'s
 and skips them from output.
+If --anchor-used-file is set, these hashes are read from
+the file before first run() and written to it after each run(),
+so a resumed pipeline skips anchors found before.
+The file stores anchor-size and checksum of names of sequences;
+a file written for other anchor-size or sequences is rejected.
+The file is replaced by renaming of new temporary file.
 
-\note Using >= 2 workers may (very unlikely) cause races,
-    since bloom filter is not protected by a mutex.
-    Such a races may cause some anchors not to be found.
+With --anchor-sampling=minimizer only (w,k)-minimizers
+(w = --anchor-window) are used in both passes.
+This reduces memory used by Bloom filter and found fragments
+about w/2 times, while every repeat longer than w+k-1
+still gets an anchor.
+
+With --anchor-exact-count the first pass counts k-mers exactly
+(in hash tables partitioned by hash) instead of Bloom filter.
+This takes more memory, but has no false positives and
+allows to select anchors by number of occurrences
+(--anchor-min-count, --anchor-max-count), e.g. to skip
+high-copy repeats.
+
+Anchors longer than MAX_ANCHOR_SIZE (up to MAX_WIDE_ANCHOR_SIZE)
+are found using 128-bit hashes (hash128_t).
+
+\note Bloom filter of first step is updated atomically,
+    so any number of workers can be used.
 \note The smallest piece of work, passed to a worker,
     is one sequence.
     So it is useless to set workers > sequences.
@@ -0,0 +1,158 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+
+#include "BlockedBloomFilter.hpp"
+#include "BloomFilter.hpp"
+#include "make_hash.hpp"
+#include "rand_name.hpp"
+
+namespace npge {
+
+const size_t CACHE_LINE = BlockedBloomFilter::BLOCK_WORDS * sizeof(hash_t);
+const int HASH_BITS = sizeof(hash_t) * 8;
+const int BIT_SHIFT = HASH_BITS - 6; // 2^6 == bits in word
+const int BLOCK_WORDS_SHIFT = 3; // 2^3 == BLOCK_WORDS
+
+static hash_t random_odd() {
+    hash_t result = 0;
+    for (int i = 0; i < 4; i++) {
+        result = (result << 16) ^ hash_t(std::rand());
+    }
+    return result | 1;
+}
+
+static hash_t atomic_or(hash_t* word, hash_t mask) {
+    return __sync_fetch_and_or(word, mask);
+}
+
+static int popcount(hash_t word) {
+    int result = 0;
+    while (word) {
+        word &= word - 1;
+        result += 1;
+    }
+    return result;
+}
+
+BlockedBloomFilter::BlockedBloomFilter():
+    words_(0), blocks_(0), word_shift_(HASH_BITS),
+    word_parameter_(1) {
+}
+
+BlockedBloomFilter::BlockedBloomFilter(size_t members,
+                                       double error_prob):
+    words_(0), blocks_(0), word_shift_(HASH_BITS),
+    word_parameter_(1) {
+    set_members(members, error_prob);
+    set_optimal_hashes(members);
+}
+
+void BlockedBloomFilter::clear() {
+    std::vector<hash_t>().swap(storage_);
+    words_ = 0;
+    blocks_ = 0;
+    word_shift_ = HASH_BITS;
+    hash_parameter_.clear();
+}
+
+void BlockedBloomFilter::set_members(size_t members,
+                                     double error_prob) {
+    set_bits(BloomFilter::optimal_bits(members, error_prob));
+}
+
+size_t BlockedBloomFilter::bits() const {
+    return blocks_ * BLOCK_BITS;
+}
+
+void BlockedBloomFilter::set_bits(size_t bits) {
+    blocks_ = 1;
+    word_shift_ = HASH_BITS - BLOCK_WORDS_SHIFT;
+    while (blocks_ * BLOCK_BITS < bits) {
+        blocks_ *= 2;
+        word_shift_ -= 1;
+    }
+    std::vector<hash_t>().swap(storage_);
+    // one more block to align words_ to cache line
+    storage_.resize((blocks_ + 1) * BLOCK_WORDS, 0);
+    size_t address = reinterpret_cast<size_t>(&storage_[0]);
+    size_t misalignment = address % CACHE_LINE;
+    size_t shift = misalignment ? CACHE_LINE - misalignment : 0;
+    words_ = &storage_[0] + shift / sizeof(hash_t);
+    std::srand(make_seed());
+    word_parameter_ = random_odd();
+}
+
+void BlockedBloomFilter::set_optimal_hashes(size_t members) {
+    set_hashes(BloomFilter::optimal_hashes(members, bits()));
+}
+
+size_t BlockedBloomFilter::hashes() const {
+    return hash_parameter_.size();
+}
+
+void BlockedBloomFilter::set_hashes(size_t hashes) {
+    hash_parameter_.resize(0);
+    hash_parameter_.resize(hashes);
+    std::srand(make_seed());
+    for (size_t i = 0; i < hashes; i++) {
+        hash_parameter_[i] = random_odd();
+    }
+}
+
+bool BlockedBloomFilter::test_and_add(hash_t hash) {
+    hash = mix_hash(hash);
+    hash_t* word = word_of(hash);
+    hash_t mask = make_mask(hash);
+    // check without locking the bus first
+    hash_t old = *static_cast<volatile hash_t*>(word);
+    if ((old & mask) != mask) {
+        old = atomic_or(word, mask);
+    }
+    return (old & mask) == mask;
+}
+
+void BlockedBloomFilter::add(hash_t hash) {
+    test_and_add(hash);
+}
+
+bool BlockedBloomFilter::test(hash_t hash) const {
+    hash = mix_hash(hash);
+    hash_t mask = make_mask(hash);
+    return (*word_of(hash) & mask) == mask;
+}
+
+size_t BlockedBloomFilter::true_bits() const {
+    size_t result = 0;
+    size_t words = blocks_ * BLOCK_WORDS;
+    for (size_t i = 0; i < words; i++) {
+        result += popcount(words_[i]);
+    }
+    return result;
+}
+
+hash_t* BlockedBloomFilter::word_of(hash_t hash) const {
+    size_t word = 0;
+    if (word_shift_ < HASH_BITS) {
+        word = (hash * word_parameter_) >> word_shift_;
+    }
+    return words_ + word;
+}
+
+hash_t BlockedBloomFilter::make_mask(hash_t hash) const {
+    hash_t mask = 0;
+    size_t hashes_number = hashes();
+    for (size_t i = 0; i < hashes_number; i++) {
+        hash_t parameter = hash_parameter_[i];
+        int bit = (hash * parameter) >> BIT_SHIFT;
+        mask |= hash_t(1) << bit;
+    }
+    return mask;
+}
+
+}
@@ -0,0 +1,114 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_BLOCKED_BLOOM_FILTER_HPP_
+#define NPGE_BLOCKED_BLOOM_FILTER_HPP_
+
+#include <vector>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Register-blocked Bloom filter.
+
+All bits of a member are set in one 64-bit word, selected by
+the member's hash, so each test reads one word.
+Storage is allocated in blocks of one cache line (512 bits).
+Number of words is a power of two, word and bits
+are selected by multiply-shift hashing of mixed hash
+(no divisions).
+
+A member is added with one atomic operation, so
+test_and_add() can be called from several threads
+without locking: exactly one of concurrent calls adding
+a new member returns false (unless the member is
+a false positive). Any added member is found by test().
+
+False positive probability is higher than
+the one of BloomFilter with same bits and hashes.
+*/
+class BlockedBloomFilter {
+public:
+    /** Number of 64-bit words in a block */
+    static const int BLOCK_WORDS = 8;
+
+    /** Number of bits in a block */
+    static const int BLOCK_BITS = BLOCK_WORDS * 64;
+
+    /** Default constructor.
+    Postconditions: bits() = 0, hashes() = 0.
+    */
+    BlockedBloomFilter();
+
+    /** Constructor.
+    \see set_members, set_optimal_hashes
+    */
+    BlockedBloomFilter(size_t members, double error_prob);
+
+    /** Clear internal state */
+    void clear();
+
+    /** Set optimal bits number.
+    \see BloomFilter::optimal_bits(), set_bits()
+    */
+    void set_members(size_t members, double error_prob);
+
+    /** Get bits number */
+    size_t bits() const;
+
+    /** Set bits number.
+    The number is rounded up to power of two blocks.
+    \warning This method clears all added members.
+    */
+    void set_bits(size_t bits);
+
+    /** Set optimal hash functions number.
+    \see BloomFilter::optimal_hashes(), set_hashes()
+    */
+    void set_optimal_hashes(size_t members);
+
+    /** Get hash functions number */
+    size_t hashes() const;
+
+    /** Set hash functions number.
+    \warning This method invalidates all added members.
+    */
+    void set_hashes(size_t hashes);
+
+    /** Return if the member is likely to be added and add it.
+    This method is thread-safe.
+    */
+    bool test_and_add(hash_t hash);
+
+    /** Add member.
+    This method is thread-safe.
+    */
+    void add(hash_t hash);
+
+    /** Return if the member is likely to be added */
+    bool test(hash_t hash) const;
+
+    /** Return the number of "true" (used) bits */
+    size_t true_bits() const;
+
+private:
+    std::vector<hash_t> storage_;
+    hash_t* words_; // aligned to cache line
+    size_t blocks_;
+    int word_shift_;
+    hash_t word_parameter_;
+    std::vector<hash_t> hash_parameter_;
+
+    hash_t* word_of(hash_t hash) const;
+    hash_t make_mask(hash_t hash) const;
+};
+
+}
+
+#endif
+
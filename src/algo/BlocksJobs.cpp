@@ -88,6 +88,22 @@ public:
     }
 
     void work_impl() {
+        if (thread_group()->workers() == 1) {
+            do_work();
+            return;
+        }
+        try {
+            do_work();
+        } catch (std::exception& e) {
+            jobs_->fail_thread(data_, e.what());
+            throw;
+        } catch (...) {
+            jobs_->fail_thread(data_, "unknown error");
+            throw;
+        }
+    }
+
+    void do_work() {
         jobs_->initialize_thread(data_);
         ThreadWorker::work_impl();
         jobs_->finish_thread(data_);
@@ -221,6 +237,11 @@ void BlocksJobs::finish_thread(ThreadData* data) const {
     finish_thread_impl(data);
 }
 
+void BlocksJobs::fail_thread(ThreadData* data,
+                             const std::string& message) const {
+    fail_thread_impl(data, message);
+}
+
 void BlocksJobs::after_thread(ThreadData* data) const {
     after_thread_impl(data);
     delete data;
@@ -266,6 +287,10 @@ void BlocksJobs::after_thread_impl(ThreadData* data) const {
 void BlocksJobs::finish_thread_impl(ThreadData* data) const {
 }
 
+void BlocksJobs::fail_thread_impl(ThreadData* data,
+                                  const std::string& message) const {
+}
+
 void BlocksJobs::finish_work_impl() const {
 }
 
@@ -111,6 +111,12 @@ public:
     */
     void finish_thread(ThreadData* data) const;
 
+    /** Do some job if the thread failed (threw an exception).
+    Other threads may be processing blocks at this time.
+    Called if workers() >= 2.
+    */
+    void fail_thread(ThreadData* data, const std::string& message) const;
+
     /** Do some job after all threads finished.
     Post-action.
 
@@ -170,6 +176,12 @@ protected:
     */
     virtual void finish_thread_impl(ThreadData* data) const;
 
+    /** Do some job if the thread failed (implementation).
+    Does nothing by default.
+    */
+    virtual void fail_thread_impl(ThreadData* data,
+                                  const std::string& message) const;
+
     /** Do some job after all threads finished.
     Does nothing.
     */
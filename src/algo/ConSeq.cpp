@@ -44,6 +44,7 @@ void ConSeq::process_block_impl(Block* b, ThreadData* d) const {
     } else if (b->size() >= 2) {
         seq = create_sequence(this);
         seq->set_block(b);
+        b->drop_matrix();
     }
     CSData* data = boost::polymorphic_cast<CSData*>(d);
     data->seqs_.push_back(seq);
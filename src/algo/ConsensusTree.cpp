@@ -6,6 +6,7 @@
  */
 
 #include <cmath>
+#include <set>
 #include <vector>
 #include <algorithm>
 #include <boost/bind.hpp>
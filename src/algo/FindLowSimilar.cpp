@@ -132,12 +132,11 @@ void FindLowSimilar::reduce_regions(Regions& regions, int min_length) {
 void FindLowSimilar::process_block_impl(Block* block,
                                         ThreadData* data) const {
     int L = block->alignment_length();
+    std::vector<bool> ident, gap;
+    test_columns(block, ident, gap);
     std::vector<bool> good_col((L));
     for (int col = 0; col < L; col++) {
-        bool ident, gap, pure_gap;
-        int atgc[LETTERS_NUMBER];
-        test_column(block, col, ident, gap, pure_gap, atgc);
-        good_col[col] = ident && !gap;
+        good_col[col] = ident[col] && !gap[col];
     }
     int min_length = opt_value("min-fragment").as<int>();
     Decimal min_identity = opt_value("min-identity").as<Decimal>();
@@ -20,10 +20,11 @@ static int substitution(char a, char b) {
     return (a == b && a != 'N') ? 0 : 1;
 }
 
-static void equal_at(const Fragment* a, const Fragment* b,
+static void equal_at(const std::vector<char>& a,
+                     const std::vector<char>& b,
                      pos_t pos, bool& eq, bool& gap) {
-    char ac = a->alignment_at(pos);
-    char bc = b->alignment_at(pos);
+    char ac = a[pos];
+    char bc = b[pos];
     eq = (ac == bc);
     gap = (ac == '\0');
 }
@@ -46,18 +47,22 @@ FragmentDistance::Distance FragmentDistance::fragment_distance(
     if (length < 3) {
         return result;
     }
+    // rows are decoded at once
+    std::vector<char> a_letters(length), b_letters(length);
+    a->alignment_chars(0, length, &a_letters[0]);
+    b->alignment_chars(0, length, &b_letters[0]);
     // cycle buffer
     bool eq[3];
     bool gap[3];
     for (int i = 0; i < 2; i++) {
-        equal_at(a, b, i, eq[i], gap[i]);
+        equal_at(a_letters, b_letters, i, eq[i], gap[i]);
     }
     for (int i = 2; i < length; i++) {
         // i is index of third letter (added)
         int prev = (i - 2) % 3;
         int curr = (i - 1) % 3;
         int next = i % 3;
-        equal_at(a, b, i, eq[next], gap[next]);
+        equal_at(a_letters, b_letters, i, eq[next], gap[next]);
         bool prev_good = eq[prev] && !gap[prev];
         bool curr_good = !eq[curr];
         bool next_good = eq[next] && !gap[next];
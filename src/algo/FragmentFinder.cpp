@@ -5,11 +5,18 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <algorithm>
+#include <map>
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 #include "FragmentFinder.hpp"
 #include "SeqI.hpp"
+#include "hash128.hpp"
+#include "HashSet.hpp"
+#include "FastaReader.hpp"
+#include "name_to_stream.hpp"
+#include "FragmentCollection.hpp"
 #include "Block.hpp"
 #include "thread_pool.hpp"
 
@@ -20,8 +27,9 @@ static bool pattern_length(const Processor* f,
     std::string p;
     p = f->opt_value("pattern").as<std::string>();
     Sequence::to_atgcn(p);
-    if (p.empty()) {
-        message = "'pattern' should not be empty";
+    std::string file = f->opt_value("patterns").as<std::string>();
+    if (p.empty() && file.empty()) {
+        message = "'pattern' or 'patterns' should not be empty";
         return false;
     }
     return true;
@@ -30,30 +38,123 @@ static bool pattern_length(const Processor* f,
 FragmentFinder::FragmentFinder() {
     add_opt("pattern", "Sequence searched for",
             std::string(""));
+    add_opt("patterns", "FASTA file with sequences searched for "
+            "(if set, 'pattern' is ignored)",
+            std::string(""));
     add_opt_check(boost::bind(pattern_length, this, _1));
-    add_gopt("max-matches", "Maximum number of matches",
-             "MAX_MATCHES");
+    add_gopt("max-matches", "Maximum number of matches "
+             "(of each pattern)", "MAX_MATCHES");
     add_opt_rule("max-matches >= 1");
     declare_bs("target", "search in sequences, add fragments");
 }
 
+struct Pattern {
+    std::string name_;
+    std::string seq_;
+};
+
+typedef std::vector<Pattern> Patterns;
+
+class PatternsReader : public FastaReader {
+public:
+    PatternsReader(Patterns& patterns, std::istream& input):
+        FastaReader(input),
+        patterns_(patterns) {
+    }
+
+    void new_sequence(const std::string& name,
+                      const std::string& /* description */) {
+        patterns_.push_back(Pattern());
+        patterns_.back().name_ = name;
+    }
+
+    void grow_sequence(const std::string& data) {
+        ASSERT_FALSE(patterns_.empty());
+        patterns_.back().seq_ += data;
+    }
+
+    Patterns& patterns_;
+};
+
+static void read_patterns(const FragmentFinder* f,
+                          Patterns& patterns) {
+    std::string file = f->opt_value("patterns").as<std::string>();
+    if (file.empty()) {
+        Pattern pattern;
+        pattern.seq_ = f->opt_value("pattern").as<std::string>();
+        patterns.push_back(pattern);
+    } else {
+        boost::shared_ptr<std::istream> input = name_to_istream(file);
+        PatternsReader reader(patterns, *input);
+        reader.read_all_sequences();
+    }
+    Patterns good;
+    BOOST_FOREACH (Pattern& pattern, patterns) {
+        Sequence::to_atgcn(pattern.seq_);
+        if (!pattern.seq_.empty()) {
+            good.push_back(pattern);
+        }
+    }
+    patterns.swap(good);
+}
+
+/** Patterns of same length */
+template<typename H>
+struct PatternGroup {
+    typedef std::pair<H, int> HashAndPattern;
+
+    int length_;
+    HashSet<H> hashes_; // for fast rejection
+    std::vector<HashAndPattern> index_; // sorted by hash
+};
+
+template<typename H>
+struct CmpHash {
+    typedef typename PatternGroup<H>::HashAndPattern HashAndPattern;
+
+    bool operator()(const HashAndPattern& a,
+                    const HashAndPattern& b) const {
+        return a.first < b.first;
+    }
+};
+
+template<typename H>
 class FinderTG : public ReusingThreadGroup,
     public SeqBase {
 public:
-    Fragments ff_;
-    hash_t pattern_;
-    std::string p_;
+    typedef std::vector<Fragments> FragmentsByPattern;
+
+    FragmentsByPattern ff_;
+    const Patterns& patterns_;
+    std::vector<bool> has_n_;
+    std::vector<PatternGroup<H> > groups_; // by length asc
     int max_matches_;
-    bool has_n_;
-
-    FinderTG(const FragmentFinder* f):
-        SeqBase(*f->block_set()) {
-        p_ = f->opt_value("pattern").as<std::string>();
-        Sequence::to_atgcn(p_);
-        anchor_ = p_.size();
-        pattern_ = make_hash(p_.c_str(), p_.size(), 1);
+
+    FinderTG(const FragmentFinder* f, const Patterns& patterns):
+        SeqBase(*f->block_set()),
+        patterns_(patterns) {
+        ff_.resize(patterns_.size());
+        has_n_.resize(patterns_.size());
+        std::map<int, PatternGroup<H> > groups;
+        for (int i = 0; i < patterns_.size(); i++) {
+            const std::string& p = patterns_[i].seq_;
+            has_n_[i] = (p.find('N') != std::string::npos);
+            PatternGroup<H>& group = groups[p.size()];
+            group.length_ = p.size();
+            H hash = make_hash<H>(p.c_str(), p.size(), 1);
+            group.hashes_.insert(hash);
+            group.index_.push_back(std::make_pair(hash, i));
+        }
+        typedef typename std::map<int, PatternGroup<H> >::value_type Pair;
+        BOOST_FOREACH (Pair& pair, groups) {
+            PatternGroup<H>& group = pair.second;
+            std::sort(group.index_.begin(), group.index_.end(),
+                      CmpHash<H>());
+            groups_.push_back(PatternGroup<H>());
+            std::swap(groups_.back(), group);
+        }
+        anchor_ = groups_.front().length_;
         max_matches_ = f->opt_value("max-matches").as<int>();
-        has_n_ = (p_.find('N') != std::string::npos);
         set_workers(f->workers());
         make_seqs();
     }
@@ -63,102 +164,222 @@ public:
     ThreadWorker* create_worker_impl();
 };
 
+template<typename H>
 class FinderWorker : public ThreadWorker {
 public:
-    Fragments ff_;
+    typename FinderTG<H>::FragmentsByPattern ff_;
 
     FinderWorker(ThreadGroup* group):
         ThreadWorker(group) {
+        FinderTG<H>* g = D_CAST<FinderTG<H>*>(group);
+        ff_.resize(g->ff_.size());
     }
 
     ~FinderWorker() {
-        FinderTG* g = D_CAST<FinderTG*>(thread_group());
-        Fragments& dst = g->ff_;
-        dst.insert(dst.end(), ff_.begin(), ff_.end());
+        FinderTG<H>* g = D_CAST<FinderTG<H>*>(thread_group());
+        for (int i = 0; i < ff_.size(); i++) {
+            Fragments& dst = g->ff_[i];
+            dst.insert(dst.end(), ff_[i].begin(), ff_[i].end());
+        }
     }
 };
 
-class FinderTask : public ThreadTask, public SeqI {
+/** Search all patterns in one pass over sequence.
+One rolling hash (SeqI) is used for each length of patterns.
+*/
+template<typename H>
+class FinderTask : public ThreadTask {
 public:
-    Fragments& ff_;
-    hash_t pattern_;
-    std::string p_;
-    int max_matches_;
-    bool has_n_;
+    typedef FinderTG<H> TG;
+    typedef typename PatternGroup<H>::HashAndPattern HashAndPattern;
+    typedef typename std::vector<HashAndPattern>::const_iterator It;
+
+    Sequence* seq_;
+    const TG& tg_;
+    typename TG::FragmentsByPattern& ff_;
+    int full_; // number of patterns with max_matches_ matches
+    pos_t limit_; // matches after it can't replace kept matches
 
-    FinderTask(Sequence* seq, FinderWorker* w, FinderTG* g):
+    FinderTask(Sequence* seq, FinderWorker<H>* w, const TG* g):
         ThreadTask(w),
-        SeqI(seq, g),
+        seq_(seq),
+        tg_(*g),
         ff_(w->ff_),
-        pattern_(g->pattern_),
-        p_(g->p_),
-        max_matches_(g->max_matches_),
-        has_n_(g->has_n_) {
+        full_(0),
+        limit_(-1) {
+    }
+
+    /** Count patterns with max_matches_ matches */
+    void set_full(const Fragments& ff) {
+        full_ += 1;
+        // top of heap only decreases, so limit_ remains valid
+        limit_ = std::max(limit_, ff.front()->min_pos());
     }
 
-    void add_match(int ori) {
-        pos_t min_pos = pos_;
-        pos_t max_pos = min_pos + anchor_ - 1;
+    /** Add match, keep max_matches_ least matches of pattern.
+    Matches of pattern are kept as heap with the greatest match
+    on top, so the matches kept by all workers include the least
+    matches, whatever sequences were scanned by each worker.
+    */
+    void add_match(const SeqI<H>& s, int pattern, int ori) {
+        Fragments& ff = ff_[pattern];
+        const std::string& p = tg_.patterns_[pattern].seq_;
+        pos_t min_pos = s.pos_;
+        pos_t max_pos = min_pos + s.anchor_ - 1;
+        bool full = (ff.size() >= tg_.max_matches_);
+        if (full) {
+            Fragment candidate(seq_, min_pos, max_pos, ori);
+            if (!(candidate < *ff.front())) {
+                return;
+            }
+        }
         pos_t begin = (ori == 1) ? min_pos : max_pos;
-        if ((!has_n_ && !ns_ && anchor_ <= MAX_ANCHOR_SIZE) ||
-                seq_->substr(begin, anchor_, ori) == p_) {
+        if ((!tg_.has_n_[pattern] && !s.ns_ &&
+                s.anchor_ <= max_hash_letters<H>()) ||
+                seq_->substr(begin, s.anchor_, ori) == p) {
             Fragment* f = new Fragment(seq_, min_pos,
                                        max_pos, ori);
-            ff_.push_back(f);
+            if (full) {
+                std::pop_heap(ff.begin(), ff.end(), FragmentCompare());
+                delete ff.back();
+                ff.back() = f;
+            } else {
+                ff.push_back(f);
+            }
+            std::push_heap(ff.begin(), ff.end(), FragmentCompare());
+            if (!full && ff.size() == tg_.max_matches_) {
+                set_full(ff);
+            }
         }
     }
 
-    void test() {
-        if (dir_ == pattern_) {
-            add_match(1);
-        }
-        if (rev_ == pattern_) {
-            add_match(-1);
+    void test(const PatternGroup<H>& group, const SeqI<H>& s,
+              const H& hash, int ori) {
+        if (group.hashes_.has_elem(hash)) {
+            HashAndPattern key(hash, 0);
+            std::pair<It, It> range = std::equal_range(
+                    group.index_.begin(), group.index_.end(),
+                    key, CmpHash<H>());
+            for (It it = range.first; it != range.second; ++it) {
+                add_match(s, it->second, ori);
+            }
         }
     }
 
+    void test(const PatternGroup<H>& group, const SeqI<H>& s) {
+        test(group, s, s.dir_, 1);
+        test(group, s, s.rev_, -1);
+    }
+
     void run_impl() {
-        init_state();
-        test();
-        pos_t n = seq_->size() - anchor_;
-        for (pos_t i = 0; i < n; i++) {
-            next_hash();
-            test();
-            if (ff_.size() > max_matches_) {
+        std::vector<SeqI<H> > states;
+        BOOST_FOREACH (const PatternGroup<H>& group, tg_.groups_) {
+            if (group.length_ > seq_->size()) {
+                break;
+            }
+            states.push_back(SeqI<H>(seq_, group.length_));
+            states.back().init_state();
+        }
+        int patterns = ff_.size();
+        for (int p = 0; p < patterns; p++) {
+            if (ff_[p].size() >= tg_.max_matches_) {
+                // found by previous task of this worker
+                set_full(ff_[p]);
+            }
+        }
+        pos_t n = seq_->size() - tg_.anchor_;
+        for (pos_t i = 0; i <= n; i++) {
+            if (full_ == patterns && i > limit_) {
+                // fragments are compared by min_pos first
                 return;
             }
+            for (int g = 0; g < states.size(); g++) {
+                SeqI<H>& s = states[g];
+                if (i + s.anchor_ > seq_->size()) {
+                    // groups are sorted by length
+                    states.erase(states.begin() + g, states.end());
+                    break;
+                }
+                if (i > 0) {
+                    s.next_hash();
+                }
+                test(tg_.groups_[g], s);
+            }
         }
     }
 };
 
-ThreadTask* FinderTG::create_task_impl(ThreadWorker* worker) {
+template<typename H>
+ThreadTask* FinderTG<H>::create_task_impl(ThreadWorker* worker) {
     if (it_ != end_) {
         Sequence* seq = *it_;
         it_++;
-        FinderWorker* w = D_CAST<FinderWorker*>(worker);
-        return new FinderTask(seq, w, this);
+        FinderWorker<H>* w = D_CAST<FinderWorker<H>*>(worker);
+        return new FinderTask<H>(seq, w, this);
     } else {
         return 0;
     }
 }
 
-ThreadWorker* FinderTG::create_worker_impl() {
-    return new FinderWorker(this);
+template<typename H>
+ThreadWorker* FinderTG<H>::create_worker_impl() {
+    return new FinderWorker<H>(this);
 }
 
-void FragmentFinder::run_impl() const {
-    FinderTG tg(this);
+template<typename H>
+static void find_fragments(const FragmentFinder* finder,
+                           const Patterns& patterns,
+                           std::vector<Fragments>& ff) {
+    FinderTG<H> tg(finder, patterns);
     tg.perform();
+    ff.swap(tg.ff_);
+}
+
+void FragmentFinder::run_impl() const {
+    Patterns patterns;
+    read_patterns(this, patterns);
+    if (patterns.empty()) {
+        return;
+    }
+    int max_length = 0;
+    BOOST_FOREACH (const Pattern& pattern, patterns) {
+        max_length = std::max(max_length, int(pattern.seq_.size()));
+    }
+    std::vector<Fragments> ff;
+    if (max_length <= MAX_ANCHOR_SIZE) {
+        find_fragments<hash_t>(this, patterns, ff);
+    } else {
+        // wider hash makes less false matches to check
+        find_fragments<hash128_t>(this, patterns, ff);
+    }
     BlockSet& bs = *block_set();
     int max_matches = opt_value("max-matches").as<int>();
-    int matches = 0;
-    BOOST_FOREACH (Fragment* f, tg.ff_) {
-        if (matches < max_matches) {
-            Block* block = new Block;
-            block->insert(f);
-            bs.insert(block);
+    bool block_per_pattern = !opt_value("patterns").as<std::string>().empty();
+    for (int i = 0; i < patterns.size(); i++) {
+        Fragments& fragments = ff[i];
+        // matches of workers are merged in arbitrary order
+        std::sort(fragments.begin(), fragments.end(), FragmentCompare());
+        for (int j = max_matches; j < fragments.size(); j++) {
+            delete fragments[j];
+        }
+        if (fragments.size() > max_matches) {
+            fragments.resize(max_matches);
+        }
+        if (block_per_pattern) {
+            if (!fragments.empty()) {
+                Block* block = new Block;
+                BOOST_FOREACH (Fragment* f, fragments) {
+                    block->insert(f);
+                }
+                block->set_name(patterns[i].name_);
+                bs.insert(block);
+            }
         } else {
-            delete f;
+            BOOST_FOREACH (Fragment* f, fragments) {
+                Block* block = new Block;
+                block->insert(f);
+                bs.insert(block);
+            }
         }
     }
 }
@@ -13,7 +13,14 @@
 
 namespace npge {
 
-/** Locate fragment by its sequence */
+/** Locate fragment by its sequence.
+
+With --pattern each match is added as a separate block.
+With --patterns (FASTA file) all patterns are searched
+in one pass over sequences (one rolling hash per length
+of patterns). Matches of each pattern are added as one block,
+named as the pattern.
+*/
 class FragmentFinder : public Processor {
 public:
     /** Default constructor */
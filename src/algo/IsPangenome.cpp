@@ -5,6 +5,7 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <set>
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
 
@@ -6,6 +6,7 @@
  */
 
 #include <string>
+#include <vector>
 #include <boost/foreach.hpp>
 #include <boost/bind.hpp>
 
@@ -32,10 +33,15 @@ void PrintMutations::find_mutations(const Block* block,
     if (size == 1) {
         ASSERT_EQ(block->alignment_length(), cons.size());
     }
+    std::vector<char> letters(cons.size());
+    std::vector<pos_t> positions(cons.size());
     BOOST_FOREACH (Fragment* f, *block) {
+        if (!cons.empty()) {
+            f->alignment_chars(0, cons.size(), &letters[0], &positions[0]);
+        }
         int gaps = 0;
         for (int pos = 0; pos < cons.size(); pos++) {
-            char x = f->alignment_at(pos);
+            char x = letters[pos];
             if (size == 1) {
                 ASSERT_EQ(x, cons[pos]);
             }
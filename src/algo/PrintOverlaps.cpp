@@ -56,6 +56,7 @@ void PrintOverlaps::prepare() const {
 }
 
 void PrintOverlaps::finish_work_impl() const {
+    AbstractOutput::finish_work_impl();
     s2f_.clear();
 }
 
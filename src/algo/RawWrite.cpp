@@ -8,6 +8,7 @@
 #include <ostream>
 #include <algorithm>
 #include <boost/foreach.hpp>
+#include <boost/algorithm/string/predicate.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 
@@ -16,6 +17,10 @@
 #include "Block.hpp"
 #include "Fragment.hpp"
 #include "Sequence.hpp"
+#include "block_set_binary.hpp"
+#include "block_set_index.hpp"
+#include "name_to_stream.hpp"
+#include "gzip_stream.hpp"
 
 namespace npge {
 
@@ -26,6 +31,10 @@ RawWrite::RawWrite(const std::string& prefix) {
     add_opt("export-contents", "print contents of fragments", true);
     add_opt("export-alignment",
             "use alignment information if available", true);
+    add_opt("binary", "write binary blockset (bsb); "
+            "also used if file name ends with .bsb", false);
+    add_opt("index", "write index (file.bsi) to read blocks "
+            "by name (see BlockSetIndex)", false);
     declare_bs("target", "Target blockset");
 }
 
@@ -37,7 +46,17 @@ static struct FragmentCompareName2 {
     }
 } fcn2;
 
+bool RawWrite::binary() const {
+    using namespace boost::algorithm;
+    return opt_value("binary").as<bool>() ||
+           ends_with(opt_value("file").as<std::string>(), ".bsb");
+}
+
 void RawWrite::print_block(std::ostream& o, Block* block) const {
+    if (binary()) {
+        // whole blockset is written by print_header
+        return;
+    }
     bool export_alignment = opt_value("export-alignment").as<bool>();
     bool export_contents = opt_value("export-contents").as<bool>();
     if (opt_value("dump-block").as<bool>()) {
@@ -64,6 +83,10 @@ struct SeqNameCmp {
 };
 
 void RawWrite::print_header(std::ostream& o) const {
+    if (binary()) {
+        write_block_set_binary(*block_set(), o);
+        return;
+    }
     if (opt_value("dump-seq").as<bool>()) {
         std::vector<SequencePtr> seqs = block_set()->seqs();
         std::sort(seqs.begin(), seqs.end(), SeqNameCmp());
@@ -73,6 +96,15 @@ void RawWrite::print_header(std::ostream& o) const {
     }
 }
 
+void RawWrite::finish_work_impl() const {
+    AbstractOutput::finish_work_impl();
+    std::string file = opt_value("file").as<std::string>();
+    if (opt_value("index").as<bool>() && !binary() &&
+            !is_gzip_name(file) && file_exists(file)) {
+        write_block_set_index(file);
+    }
+}
+
 const char* RawWrite::name_impl() const {
     return "Write blockset to file";
 }
@@ -12,7 +12,11 @@
 
 namespace npge {
 
-/** Print blocks in fasta format to file or to stdout */
+/** Print blocks in fasta format to file or to stdout.
+With --binary (or file name *.bsb) whole blockset is written
+in binary format (see write_block_set_binary).
+With --index, index of the file is written (see BlockSetIndex).
+*/
 class RawWrite : public AbstractOutput {
 public:
     /** Constructor */
@@ -24,6 +28,11 @@ protected:
     void print_block(std::ostream& o, Block* block) const;
 
     void print_header(std::ostream& o) const;
+
+    void finish_work_impl() const;
+
+private:
+    bool binary() const;
 };
 
 }
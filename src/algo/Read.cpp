@@ -5,6 +5,7 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <set>
 #include <vector>
 #include <boost/foreach.hpp>
 
@@ -13,10 +14,15 @@
 #include "Fragment.hpp"
 #include "Block.hpp"
 #include "BlockSet.hpp"
+#include "Sequence.hpp"
 #include "SeqStorage.hpp"
 #include "RowStorage.hpp"
 #include "name_to_stream.hpp"
 #include "read_block_set.hpp"
+#include "genome_index.hpp"
+#include "block_set_binary.hpp"
+#include "block_set_index.hpp"
+#include "key_value.hpp"
 #include "block_hash.hpp"
 #include "throw_assert.hpp"
 #include "cast.hpp"
@@ -31,28 +37,169 @@ Read::Read():
     add_row_storage_options(this);
     declare_bs("target",
                "Default blockset where blocks are added");
+    add_opt("read-batch", "size of records (MiB) processed at once, "
+            "0 means whole input", 0);
+    add_opt_rule("read-batch >= 0");
+    add_opt("only-blocks", "read only these blocks and their "
+            "sequences using index of file (file.bsi)", Strings());
 }
 
-void Read::run_impl() const {
-    Strings block_sets;
-    get_block_sets(block_sets);
+typedef std::vector<SequencePtr> SeqPtrs;
+typedef std::set<SequencePtr> SeqsSet;
+
+static void read_files(const Read* p, const Strings& block_sets,
+                       const Strings& input_files) {
     typedef boost::shared_ptr<std::istream> IStreamPtr;
     std::vector<IStreamPtr> files;
-    BOOST_FOREACH (std::string f, file_reader_.input_files()) {
+    BOOST_FOREACH (std::string f, input_files) {
         files.push_back(name_to_istream(f));
     }
     ASSERT_GTE(files.size(), 1);
-    BlockSetFastaReader reader(*block_set(), *(files[0]),
-                               row_type(this), seq_type(this));
+    BlockSetFastaReader reader(*p->block_set(), *(files[0]),
+                               row_type(p), seq_type(p));
     // add remaining files
     for (int i = 1; i < files.size(); i++) {
         reader.add_input(*(files[i]));
     }
     BOOST_FOREACH (const std::string& bs_name, block_sets) {
-        reader.set_block_set(bs_name, get_bs(bs_name).get());
+        reader.set_block_set(bs_name, p->get_bs(bs_name).get());
     }
-    reader.set_workers(workers());
+    reader.set_workers(p->workers());
+    size_t batch = p->opt_value("read-batch").as<int>();
+    reader.set_batch_size(batch * 1024 * 1024);
     reader.run();
+}
+
+static int blocks_number(const Read* p, const Strings& block_sets) {
+    int result = 0;
+    BOOST_FOREACH (const std::string& bs_name, block_sets) {
+        result += p->get_bs(bs_name)->size();
+    }
+    return result;
+}
+
+static SeqsSet all_seqs(const Read* p, const Strings& block_sets) {
+    SeqsSet result;
+    BOOST_FOREACH (const std::string& bs_name, block_sets) {
+        SeqPtrs seqs = p->get_bs(bs_name)->seqs();
+        result.insert(seqs.begin(), seqs.end());
+    }
+    return result;
+}
+
+/** Write genome index of sequences and replace them with mapped ones.
+Only files of sequences for default blockset are indexed.
+*/
+static void make_genome_index(const Read* p,
+                              const Strings& block_sets,
+                              const std::string& fasta,
+                              const SeqPtrs& seqs) {
+    BOOST_FOREACH (const SequencePtr& seq, seqs) {
+        if (!extract_value(seq->description(), "set").empty()) {
+            return;
+        }
+    }
+    std::string index = genome_index_name(fasta);
+    try {
+        write_genome_index(seqs, index);
+    } catch (const std::exception& e) {
+        p->write_log(e.what());
+        return;
+    }
+    SeqPtrs mapped = read_genome_index(index);
+    ASSERT_EQ(mapped.size(), seqs.size());
+    BOOST_FOREACH (const std::string& bs_name, block_sets) {
+        BlockSet& bs = *p->get_bs(bs_name);
+        SeqsSet bs_seqs;
+        SeqPtrs bs_seqs_v = bs.seqs();
+        bs_seqs.insert(bs_seqs_v.begin(), bs_seqs_v.end());
+        for (int i = 0; i < seqs.size(); i++) {
+            if (bs_seqs.find(seqs[i]) != bs_seqs.end()) {
+                bs.remove_sequence(seqs[i]);
+                bs.add_sequence(mapped[i]);
+            }
+        }
+    }
+}
+
+static void read_mapped(const Read* p, const Strings& block_sets,
+                        const std::string& file) {
+    if (has_genome_index(file)) {
+        p->block_set()->add_sequences(
+            read_genome_index(genome_index_name(file)));
+        return;
+    }
+    int blocks_before = blocks_number(p, block_sets);
+    SeqsSet seqs_before = all_seqs(p, block_sets);
+    read_files(p, block_sets, Strings(1, file));
+    if (!file_exists(file) ||
+            blocks_number(p, block_sets) != blocks_before) {
+        // not a file of genomes
+        return;
+    }
+    SeqsSet seqs_after = all_seqs(p, block_sets);
+    SeqPtrs new_seqs;
+    BOOST_FOREACH (const SequencePtr& seq, seqs_after) {
+        if (seqs_before.find(seq) == seqs_before.end()) {
+            new_seqs.push_back(seq);
+        }
+    }
+    if (!new_seqs.empty()) {
+        make_genome_index(p, block_sets, file, new_seqs);
+    }
+}
+
+/** Read selected blocks of file using index.
+The index is written if needed. Blocks absent in the file are skipped.
+*/
+static void read_indexed(const Read* p, const std::string& file,
+                         const Strings& blocks) {
+    if (!has_block_set_index(file)) {
+        write_block_set_index(file);
+    }
+    BlockSetIndex index(file);
+    Strings names;
+    BOOST_FOREACH (const std::string& name, blocks) {
+        if (index.has_block(name)) {
+            names.push_back(name);
+        }
+    }
+    index.read_blocks(*p->block_set(), names,
+                      row_type(p), seq_type(p));
+}
+
+/** Read binary blockset (bsb), return false if it is not bsb */
+static bool read_binary(const Read* p, const std::string& file) {
+    boost::shared_ptr<std::istream> input = name_to_istream(file);
+    if (!is_block_set_binary(*input)) {
+        return false;
+    }
+    read_block_set_binary(*p->block_set(), *input,
+                          row_type(p), seq_type(p));
+    return true;
+}
+
+void Read::run_impl() const {
+    Strings block_sets;
+    get_block_sets(block_sets);
+    Strings input_files;
+    BOOST_FOREACH (const std::string& file, file_reader_.input_files()) {
+        if (!read_binary(this, file)) {
+            input_files.push_back(file);
+        }
+    }
+    Strings only_blocks = opt_value("only-blocks").as<Strings>();
+    if (!only_blocks.empty()) {
+        BOOST_FOREACH (const std::string& file, input_files) {
+            read_indexed(this, file, only_blocks);
+        }
+    } else if (seq_type(this) == MAPPED_SEQUENCE) {
+        BOOST_FOREACH (const std::string& file, input_files) {
+            read_mapped(this, block_sets, file);
+        }
+    } else if (!input_files.empty()) {
+        read_files(this, block_sets, input_files);
+    }
     BOOST_FOREACH (const std::string& bs_name, block_sets) {
         BOOST_FOREACH (const Block* block, *get_bs(bs_name)) {
             test_block(block);
@@ -26,6 +26,22 @@ or sequence. Default blockset is named "target". "set=all" means adding
 this block or sequence to all blocksets. Use "set=s1,s2,s3" to
 specify multiple sets.
 
+With --seq-storage=mapped, sequences of a FASTA file are read from
+its genome index (file.npgi) if the index is up to date.
+Otherwise the file is parsed and, if it has only sequences of
+default blockset, the index is written next to it.
+
+With --read-batch, records are processed in batches of this size
+to bound memory used for large blocksets
+(see BlockSetFastaReader::set_batch_size).
+
+With --only-blocks, only listed blocks and their sequences are read
+into default blockset using index of each file (see BlockSetIndex).
+The index is written if it is missing or outdated.
+
+Binary blockset files (see write_block_set_binary) are detected
+by their first byte and added to default blockset.
+
 See stream >> block_set, stream >> alignment_row.
 */
 class Read : public Processor {
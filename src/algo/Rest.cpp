@@ -5,6 +5,7 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <set>
 #include <algorithm>
 #include <boost/foreach.hpp>
 
@@ -14,9 +14,9 @@
 namespace npge {
 
 static bool check_row_type(std::string& message, Processor* p) {
-    if (p->opt_value("row-type").as<std::string>() != "map" &&
-            p->opt_value("row-type").as<std::string>() != "compact") {
-        message = "row-type must be 'map' or 'compact'";
+    std::string rt = p->opt_value("row-type").as<std::string>();
+    if (rt != "map" && rt != "compact" && rt != "gap") {
+        message = "row-type must be 'map', 'compact' or 'gap'";
         return false;
     }
     return true;
@@ -24,14 +24,17 @@ static bool check_row_type(std::string& message, Processor* p) {
 
 void add_row_storage_options(Processor* p) {
     p->add_opt("row-type",
-               "way of storing alignments in memory ('map' or 'compact')",
+               "way of storing alignments in memory "
+               "('map', 'compact' or 'gap' (runs of gaps))",
                std::string("compact"));
     p->add_opt_check(boost::bind(check_row_type, _1, p));
 }
 
 RowType row_type(const Processor* p) {
-    return (p->opt_value("row-type").as<std::string>() == "map") ?
-           MAP_ROW : COMPACT_ROW;
+    std::string rt = p->opt_value("row-type").as<std::string>();
+    return (rt == "map") ? MAP_ROW :
+           (rt == "gap") ? GAP_ROW :
+           COMPACT_ROW;
 }
 
 AlignmentRow* create_row(const Processor* p) {
@@ -9,12 +9,14 @@
 #define NPGE_SEQ_I_HPP_
 
 #include <algorithm>
+#include <deque>
 
 #include "global.hpp"
 #include "Sequence.hpp"
 #include "Fragment.hpp"
 #include "BlockSet.hpp"
 #include "make_hash.hpp"
+#include "hash128.hpp"
 #include "complement.hpp"
 #include "throw_assert.hpp"
 
@@ -67,6 +69,41 @@ inline int ns_in_fragment(const Fragment& f) {
     return result;
 }
 
+/** Functor returning letters of sequence for make_hash_base */
+template<int ori>
+struct SeqChar {
+    const Sequence* seq_;
+    pos_t index_;
+
+    SeqChar(const Sequence* seq, pos_t index):
+        seq_(seq), index_(index) {
+    }
+
+    char operator()(pos_t pos) {
+        if (ori == 1) {
+            return seq_->char_at(index_ + pos);
+        } else {
+            return seq_->char_at(index_ - pos);
+        }
+    }
+};
+
+/** Hash of type H of fragment of sequence.
+\see Sequence::hash
+*/
+template<typename H>
+H seq_hash(const Sequence* seq, pos_t index, pos_t length,
+           int ori) {
+    if (ori == 1) {
+        typedef SeqChar<1> F;
+        return make_hash_base<H, F, 1>(F(seq, index), length);
+    } else {
+        typedef SeqChar < -1 > F;
+        return make_hash_base < H, F, -1 > (F(seq, index), length);
+    }
+}
+
+template<typename H = hash_t>
 class SeqI {
 public:
     Sequence* seq_;
@@ -74,7 +111,7 @@ public:
     int ns_;
     int anchor_;
 
-    hash_t dir_, rev_;
+    H dir_, rev_;
 
     SeqI(Sequence* seq, SeqBase* base):
         seq_(seq),
@@ -83,19 +120,22 @@ public:
         anchor_(base->anchor_) {
     }
 
+    SeqI(Sequence* seq, int anchor):
+        seq_(seq),
+        pos_(0),
+        ns_(0),
+        anchor_(anchor) {
+    }
+
     void init_state() {
         ASSERT_GTE(seq_->size(), anchor_);
         Fragment init_f(seq_, 0, anchor_ - 1);
         ns_ = ns_in_fragment(init_f);
-        dir_ = init_f.hash();
-        init_f.inverse();
-        rev_ = init_f.hash();
-        if (ns_ == 0) {
-            ASSERT_EQ(rev_, complement_hash(dir_, anchor_));
-        }
+        dir_ = seq_hash<H>(seq_, 0, anchor_, 1);
+        rev_ = seq_hash<H>(seq_, anchor_ - 1, anchor_, -1);
     }
 
-    void update_hash(hash_t& hash, char remove_char,
+    void update_hash(H& hash, char remove_char,
                      char add_char, bool direct) {
         hash = reuse_hash(hash, anchor_,
                           remove_char, add_char,
@@ -119,6 +159,208 @@ public:
     }
 };
 
+/** Canonical hashes of type H of k-mers of a sequence.
+Generic version, rolls hashes with reuse_hash.
+\see Sequence::canonical_hashes
+*/
+template<typename H>
+void canonical_hashes(const Sequence* seq, pos_t from, pos_t to,
+                      int k, H* hashes, signed char* oris) {
+    H dir = seq_hash<H>(seq, from, k, 1);
+    H rev = seq_hash<H>(seq, from + k - 1, k, -1);
+    int ns = 0;
+    for (pos_t i = from; i < from + k; i++) {
+        if (seq->char_at(i) == 'N') {
+            ns += 1;
+        }
+    }
+    pos_t n = to - from;
+    for (pos_t i = 0; i < n; i++) {
+        if (i > 0) {
+            char remove_char = seq->char_at(from + i - 1);
+            char add_char = seq->char_at(from + i - 1 + k);
+            if (remove_char == 'N') {
+                ns -= 1;
+            }
+            if (add_char == 'N') {
+                ns += 1;
+            }
+            dir = reuse_hash(dir, k, remove_char, add_char, true);
+            rev = reuse_hash(rev, k, complement(remove_char),
+                             complement(add_char), false);
+        }
+        if (dir <= rev) {
+            hashes[i] = dir;
+            oris[i] = ns ? 0 : 1;
+        } else {
+            hashes[i] = rev;
+            oris[i] = ns ? 0 : -1;
+        }
+    }
+}
+
+/** Canonical hashes of k-mers of a sequence.
+Uses fast implementation of the sequence.
+\see Sequence::canonical_hashes
+*/
+inline void canonical_hashes(const Sequence* seq,
+                             pos_t from, pos_t to, int k,
+                             hash_t* hashes, signed char* oris) {
+    seq->canonical_hashes(from, to, k, hashes, oris);
+}
+
+/** Number of k-mers in one chunk of HashChunks */
+const pos_t HASH_CHUNK = 4096;
+
+/** Canonical hashes of k-mers of a sequence, chunk by chunk.
+Type of hash H is hash_t or hash128_t (for k > MAX_ANCHOR_SIZE).
+\see Sequence::canonical_hashes
+*/
+template<typename H>
+class HashChunks {
+public:
+    Sequence* seq_;
+    int anchor_;
+    pos_t begin_, end_; // current chunk
+    pos_t kmers_;
+
+    std::vector<H> hashes_;
+    std::vector<signed char> oris_;
+
+    HashChunks(Sequence* seq, int anchor):
+        seq_(seq),
+        anchor_(anchor),
+        begin_(0),
+        end_(0),
+        kmers_(seq->size() - anchor + 1) {
+    }
+
+    /** Calculate hashes of next chunk.
+    Return false if no k-mers left.
+    */
+    bool next() {
+        begin_ = end_;
+        if (begin_ >= kmers_) {
+            return false;
+        }
+        end_ = std::min(begin_ + HASH_CHUNK, kmers_);
+        hashes_.resize(end_ - begin_);
+        oris_.resize(end_ - begin_);
+        canonical_hashes(seq_, begin_, end_, anchor_,
+                         &hashes_[0], &oris_[0]);
+        return true;
+    }
+};
+
+/** Selects (w,k)-minimizers from stream of k-mers.
+Minimizer is k-mer with minimum mixed canonical hash among
+w consecutive k-mers. Windows of neighbour positions
+mostly share minimizer, so about 2/(w+1) of k-mers are selected.
+Equal fragments of length >= w+k-1 have equal minimizers.
+K-mers with 'N' are never selected.
+*/
+template<typename H>
+class Minimizers {
+public:
+    /** K-mer */
+    struct Kmer {
+        hash_t order_;
+        pos_t pos_;
+        H hash_;
+        int ori_;
+    };
+
+    /** Constructor */
+    Minimizers(int window):
+        window_(window), last_(-1), kmers_(0) {
+    }
+
+    /** Add next k-mer.
+    Return true and set minimizer if new minimizer was selected.
+    */
+    bool add(const H& hash, pos_t pos, int ori, Kmer& minimizer) {
+        kmers_ += 1;
+        while (!deque_.empty() &&
+                deque_.front().pos_ + window_ <= pos) {
+            deque_.pop_front();
+        }
+        if (ori != 0) {
+            Kmer kmer;
+            kmer.order_ = mix_hash(fold_hash(hash));
+            kmer.pos_ = pos;
+            kmer.hash_ = hash;
+            kmer.ori_ = ori;
+            while (!deque_.empty() &&
+                    deque_.back().order_ > kmer.order_) {
+                deque_.pop_back();
+            }
+            deque_.push_back(kmer);
+        }
+        if (kmers_ >= window_) {
+            return select(minimizer);
+        }
+        return false;
+    }
+
+    /** Select minimizer of sequence shorter than window.
+    Call this after adding last k-mer.
+    */
+    bool finish(Kmer& minimizer) {
+        if (kmers_ < window_) {
+            return select(minimizer);
+        }
+        return false;
+    }
+
+private:
+    std::deque<Kmer> deque_;
+    int window_;
+    pos_t last_;
+    pos_t kmers_;
+
+    bool select(Kmer& minimizer) {
+        if (!deque_.empty() && deque_.front().pos_ != last_) {
+            minimizer = deque_.front();
+            last_ = minimizer.pos_;
+            return true;
+        }
+        return false;
+    }
+};
+
+/** Call f.process(hash, pos, ori) for k-mers of sequence.
+If window is 0, all k-mers are passed, otherwise
+only (window,k)-minimizers.
+*/
+template<typename H, typename F>
+void for_each_kmer(Sequence* seq, int anchor, int window, F& f) {
+    HashChunks<H> chunks(seq, anchor);
+    if (window == 0) {
+        while (chunks.next()) {
+            pos_t n = chunks.end_ - chunks.begin_;
+            for (pos_t i = 0; i < n; i++) {
+                f.process(chunks.hashes_[i], chunks.begin_ + i,
+                          chunks.oris_[i]);
+            }
+        }
+        return;
+    }
+    Minimizers<H> minimizers(window);
+    typename Minimizers<H>::Kmer m;
+    while (chunks.next()) {
+        pos_t n = chunks.end_ - chunks.begin_;
+        for (pos_t i = 0; i < n; i++) {
+            if (minimizers.add(chunks.hashes_[i], chunks.begin_ + i,
+                               chunks.oris_[i], m)) {
+                f.process(m.hash_, m.pos_, m.ori_);
+            }
+        }
+    }
+    if (minimizers.finish(m)) {
+        f.process(m.hash_, m.pos_, m.ori_);
+    }
+}
+
 }
 
 #endif
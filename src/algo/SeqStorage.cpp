@@ -17,9 +17,10 @@ static bool check_seq_type(std::string& message, Processor* p) {
     std::string st;
     st = p->opt_value("seq-storage").as<std::string>();
     if (st != "asis" && st != "compact" &&
-            st != "compact_low_n") {
-        message = "seq-storage must be 'asis', 'compact' "
-                  "or 'compact_low_n'";
+            st != "compact_low_n" && st != "packed" &&
+            st != "mapped") {
+        message = "seq-storage must be 'asis', 'compact', "
+                  "'compact_low_n', 'packed' or 'mapped'";
         return false;
     }
     return true;
@@ -28,7 +29,8 @@ static bool check_seq_type(std::string& message, Processor* p) {
 void add_seq_storage_options(Processor* p) {
     p->add_opt("seq-storage",
                "way of storing sequences in memory "
-               "('asis', 'compact' or 'compact_low_n')",
+               "('asis', 'compact', 'compact_low_n', 'packed' or "
+               "'mapped' (packed, memory-mapped from genome index))",
                std::string("compact_low_n"));
     p->add_opt_check(boost::bind(check_seq_type, _1, p));
 }
@@ -38,6 +40,8 @@ SequenceType seq_type(const Processor* p) {
     st = p->opt_value("seq-storage").as<std::string>();
     return (st == "asis") ? ASIS_SEQUENCE :
            (st == "compact") ? COMPACT_SEQUENCE :
+           (st == "packed") ? PACKED_SEQUENCE :
+           (st == "mapped") ? MAPPED_SEQUENCE :
            COMPACT_LOW_N_SEQUENCE;
 }
 
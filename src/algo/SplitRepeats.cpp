@@ -6,6 +6,8 @@
  */
 
 #include <set>
+#include <vector>
+#include <algorithm>
 #include <boost/foreach.hpp>
 #include <boost/cast.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -79,27 +81,41 @@ void fragmentsToClade(std::string& clade,
 // 1 - ident, 2 - 2 variants, or 0
 void buildStatus(Ints& status, const Fragments& all) {
     int length = status.size();
-    for (int pos = 0; pos < length; pos++) {
-        char first_letter = all[0]->alignment_at(pos);
-        char second_letter = 0;
-        bool gap = false;
-        bool more_than_3 = false;
-        BOOST_FOREACH (Fragment* f, all) {
-            char c = f->alignment_at(pos);
-            if (c == '-') {
-                gap = true;
-                break;
-            } else if (c != first_letter) {
-                if (!second_letter) {
-                    second_letter = c;
-                } else if (second_letter != c) {
-                    more_than_3 = true;
+    int rows = all.size();
+    std::vector<char> letters;
+    std::vector<pos_t> positions;
+    for (int tile = 0; tile < length; tile += TILE_COLUMNS) {
+        int tile_stop = std::min(tile + TILE_COLUMNS, length);
+        int stride = tile_stop - tile;
+        letters.resize(rows * stride);
+        positions.resize(stride);
+        for (int i = 0; i < rows; i++) {
+            all[i]->alignment_chars(tile, tile_stop, &letters[i * stride],
+                                    &positions[0]);
+        }
+        for (int pos = tile; pos < tile_stop; pos++) {
+            const char* column = &letters[pos - tile];
+            char first_letter = column[0];
+            char second_letter = 0;
+            bool gap = false;
+            bool more_than_3 = false;
+            for (int i = 0; i < rows; i++) {
+                char c = column[i * stride];
+                if (c == '-') {
+                    gap = true;
                     break;
+                } else if (c != first_letter) {
+                    if (!second_letter) {
+                        second_letter = c;
+                    } else if (second_letter != c) {
+                        more_than_3 = true;
+                        break;
+                    }
                 }
             }
-        }
-        if (!gap && !more_than_3) {
-            status[pos] = second_letter ? 2 : 1;
+            if (!gap && !more_than_3) {
+                status[pos] = second_letter ? 2 : 1;
+            }
         }
     }
 }
@@ -162,10 +178,10 @@ typedef std::vector<int> Ints;
 
 static void find_mutations(Ints& mutations, const Block* block) {
     int l = block->alignment_length();
+    std::vector<bool> ident, gap;
+    test_columns(block, ident, gap);
     for (int col = 0; col < l; col++) {
-        bool ident, gap;
-        test_column(block, col, ident, gap);
-        if (!ident || gap) {
+        if (!ident[col] || gap[col]) {
             mutations.push_back(col);
         }
     }
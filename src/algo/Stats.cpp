@@ -74,6 +74,7 @@ static void report_weighted_average_identity(
     BOOST_FOREACH (Block* block, *bs) {
         AlignmentStat al_stat;
         make_stat(al_stat, block);
+        block->drop_matrix();
         double identity = block_identity(al_stat).to_d();
         identity_wsum += double(block->alignment_length()) *
             identity;
@@ -103,6 +104,8 @@ void Stats::run_impl() const {
         block_size.push_back(b->size());
         AlignmentStat al_stat;
         make_stat(al_stat, b);
+        // blocks are not changed, free the matrix
+        b->drop_matrix();
         identity.push_back(block_identity(al_stat));
         gc.push_back(al_stat.gc());
         bool has_overlaps = false;
@@ -11,9 +11,9 @@
 #include <boost/foreach.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "TrySmth.hpp"
-#include "Union.hpp"
 #include "Move.hpp"
 #include "MetaProcessor.hpp"
 #include "Clear.hpp"
@@ -25,6 +25,7 @@
 #include "SizeLimits.hpp"
 #include "BlockSet.hpp"
 #include "Block.hpp"
+#include "block_set_snapshot.hpp"
 #include "block_hash.hpp"
 #include "throw_assert.hpp"
 #include "convert_position.hpp"
@@ -181,14 +182,64 @@ const char* AddingLoopBySize::name_impl() const {
     return "Align and move overlapless from other to target";
 }
 
+typedef boost::shared_ptr<BlockSetSnapshot> SnapshotPtr;
+
+class TakeSnapshot : public Processor {
+public:
+    TakeSnapshot(SnapshotPtr snapshot):
+        snapshot_(snapshot) {
+        declare_bs("target", "Blockset to be saved");
+    }
+
+protected:
+    void run_impl() const {
+        snapshot_->take(*block_set());
+    }
+
+    const char* name_impl() const {
+        return "Save blocks of blockset";
+    }
+
+private:
+    SnapshotPtr snapshot_;
+};
+
+class RestoreSnapshot : public Processor {
+public:
+    RestoreSnapshot(SnapshotPtr snapshot):
+        snapshot_(snapshot) {
+        declare_bs("target", "Blockset to which saved blocks are added");
+        declare_bs("other", "Blockset with unchanged blocks");
+    }
+
+protected:
+    void run_impl() const {
+        snapshot_->restore(*block_set(), other().get());
+        snapshot_->clear();
+    }
+
+    const char* name_impl() const {
+        return "Add saved blocks, which were changed";
+    }
+
+private:
+    SnapshotPtr snapshot_;
+};
+
 TrySmth::TrySmth() {
-    add(new Union, "target=smth-copy other=target");
-    add(new UniqueNames, "target=smth-copy");
+    // Original blocks are stored compactly while smth- runs.
+    // Blocks which smth- did not change are not restored:
+    // they are moved from target instead.
+    SnapshotPtr snapshot(new BlockSetSnapshot);
+    add(new TakeSnapshot(snapshot), "target=target");
     add(new MetaProcessor, "prefix|smth-");
     add(new RemoveNames, "target=target --remove-seqs-names:=0 "
         " --remove-blocks-names:=1");
     add(new ReAlign, "target=target");
     add(new Align, "target=target");
+    add(new RestoreSnapshot(snapshot),
+        "target=smth-copy other=target");
+    add(new UniqueNames, "target=smth-copy");
     add(new Move, "target=smth-copy other=target");
     add(new AddingLoopBySize, "target=target other=smth-copy");
     add(new UniqueNames, "target=target");
@@ -48,6 +48,8 @@ template<typename Contents> class GeneralAligner;
 class Sequence;
 class InMemorySequence;
 class CompactSequence;
+class PackedSequence;
+class MappedSequence;
 class Fragment;
 class AlignmentStat;
 class Block;
@@ -55,6 +57,7 @@ class BlockSet;
 class AlignmentRow;
 class MapAlignmentRow;
 class CompactAlignmentRow;
+class AlignmentMatrix;
 class BlockSetFastaReader;
 
 // algo
@@ -94,13 +97,16 @@ class Exception;
 enum SequenceType {
     ASIS_SEQUENCE, /**< InMemorySequence */
     COMPACT_SEQUENCE, /**< CompactSequence */
-    COMPACT_LOW_N_SEQUENCE /**< CompactLowNSequence */
+    COMPACT_LOW_N_SEQUENCE, /**< CompactLowNSequence */
+    PACKED_SEQUENCE, /**< PackedSequence */
+    MAPPED_SEQUENCE /**< MappedSequence (read from genome index) */
 };
 
 /** Type of AlignmentRow */
 enum RowType {
     MAP_ROW, /**< MapAlignmentRow */
-    COMPACT_ROW /**< CompactAlignmentRow */
+    COMPACT_ROW, /**< CompactAlignmentRow */
+    GAP_ROW /**< GapAlignmentRow */
 };
 
 /** Creat new BlockSet and return shared pointer to it */
@@ -1017,9 +1017,20 @@ void BlockSetWidget::alignment_clicked(const QModelIndex& index) {
     ui->geneNameLineEdit->setText(tip.toString());
 }
 
+void BlockSetWidget::set_index(boost::shared_ptr<BlockSetIndex> index) {
+    index_ = index;
+}
+
 void BlockSetWidget::on_blockNameLineEdit_editingFinished() {
-    QString pattern = ui->blockNameLineEdit->text();
-    block_set_model_->set_pattern(pattern.toStdString());
+    std::string pattern = ui->blockNameLineEdit->text().toStdString();
+    if (index_ && index_->has_block(pattern) &&
+            !block_set()->find_block(pattern)) {
+        // fetch the block from the file
+        index_->read_blocks(*block_set(), Strings(1, pattern),
+                            COMPACT_ROW, COMPACT_LOW_N_SEQUENCE);
+        set_block_set(block_set());
+    }
+    block_set_model_->set_pattern(pattern);
 }
 
 void BlockSetWidget::on_clearBlockNameButton_clicked() {
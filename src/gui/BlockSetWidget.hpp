@@ -13,6 +13,7 @@
 #ifndef Q_MOC_RUN
 #include "gui-global.hpp"
 #include "global.hpp"
+#include "block_set_index.hpp"
 #endif
 
 using namespace npge;
@@ -46,6 +47,12 @@ public:
 
     void set_bsa(std::string bsa_name);
 
+    /** Set index of blockset file.
+    Blocks absent in blockset are read from the file
+    when their names are entered to the filter.
+    */
+    void set_index(boost::shared_ptr<BlockSetIndex> index);
+
     static void moveBsaWidget(BlockSetWidget* dst,
                               BlockSetWidget* src);
 
@@ -68,6 +75,7 @@ private:
     std::map<const Block*, Fragments> fragments_;
     typedef std::map<Fragment*, Fragment*> F2F;
     F2F normal2global_;
+    boost::shared_ptr<BlockSetIndex> index_;
 
 private slots:
     void set_block(const Block* block);
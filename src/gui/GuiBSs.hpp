@@ -10,6 +10,7 @@
 
 #ifndef Q_MOC_RUN
 #include "global.hpp"
+#include "block_set_index.hpp"
 #endif
 
 using namespace npge;
@@ -20,6 +21,7 @@ struct GuiBSs {
     BlockSetPtr split_parts_;
     BlockSetPtr low_similarity_;
     BlockSetPtr global_blocks_;
+    boost::shared_ptr<BlockSetIndex> pangenome_index_;
 };
 
 #endif
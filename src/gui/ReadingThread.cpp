@@ -11,6 +11,7 @@
 #include "bsa_algo.hpp"
 #include "name_to_stream.hpp"
 #include "Read.hpp"
+#include "block_set_index.hpp"
 #include "cast.hpp"
 
 using namespace npge;
@@ -70,7 +71,12 @@ void ReadingThread::run_impl() {
     BlockSetPtr& low_similarity = bss_->low_similarity_;
     BlockSetPtr& global_blocks = bss_->global_blocks_;
     pangenome_bs = new_bs();
-    if (!fname_.empty()) {
+    if (!fname_.empty() && has_block_set_index(fname_)) {
+        // only sequences, blocks are read on demand
+        bss_->pangenome_index_.reset(new BlockSetIndex(fname_));
+        bss_->pangenome_index_->read_sequences(*pangenome_bs,
+                                               COMPACT_LOW_N_SEQUENCE);
+    } else if (!fname_.empty()) {
         read_bs(pangenome_bs, fname_, true);
     } else {
         read_bs(pangenome_bs, "pangenome/pangenome.bs", true);
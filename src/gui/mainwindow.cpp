@@ -54,6 +54,9 @@ void MainWindow::onReadingFinished(QString message) {
         }
         ui->verticalLayout_2->addWidget(bsw);
         bsw->set_block_set(bss_.pangenome_bs_);
+        if (bss_.pangenome_index_) {
+            bsw->set_index(bss_.pangenome_index_);
+        }
         if (bss_.genes_bs_) {
             bsw->set_genes(bss_.genes_bs_);
         }
@@ -0,0 +1,147 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <algorithm>
+
+#include "AlignmentMatrix.hpp"
+#include "Block.hpp"
+#include "block_stat.hpp"
+#include "char_to_size.hpp"
+#include "throw_assert.hpp"
+
+namespace npge {
+
+const int CELL_BITS = 4;
+const int CELLS_IN_WORD = 32 / CELL_BITS;
+const boost::uint32_t CELL = 0xF;
+const boost::uint32_t GAP_BIT = 0x8;
+
+// bit of each cell
+const boost::uint32_t LOW_BITS = 0x11111111;
+const boost::uint32_t GAP_BITS = 0x88888888;
+const boost::uint32_t LETTER_BITS = 0x77777777;
+
+static int popcount(boost::uint32_t word) {
+    int result = 0;
+    while (word) {
+        word &= word - 1;
+        result += 1;
+    }
+    return result;
+}
+
+AlignmentMatrix::AlignmentMatrix():
+    rows_(0), columns_(0), words_(0), last_mask_(0) {
+}
+
+AlignmentMatrix::AlignmentMatrix(const Block* block):
+    rows_(0), columns_(0), words_(0), last_mask_(0) {
+    build(block);
+}
+
+void AlignmentMatrix::build(const Block* block) {
+    rows_ = block->size();
+    columns_ = block->alignment_length();
+    words_ = (rows_ + CELLS_IN_WORD - 1) / CELLS_IN_WORD;
+    int tail = rows_ % CELLS_IN_WORD;
+    last_mask_ = tail ? ((Word(1) << (tail * CELL_BITS)) - 1) : ~Word(0);
+    Words(words_ * columns_, 0).swap(cells_);
+    if (rows_ == 0) {
+        return;
+    }
+    std::vector<char> letters;
+    for (int tile = 0; tile < columns_; tile += TILE_COLUMNS) {
+        int tile_stop = std::min(tile + TILE_COLUMNS, columns_);
+        int stride = tile_stop - tile;
+        decode_tile(letters, block, tile, tile_stop);
+        for (int row = 0; row < rows_; row++) {
+            const char* line = &letters[row * stride];
+            int word = row / CELLS_IN_WORD;
+            int shift = (row % CELLS_IN_WORD) * CELL_BITS;
+            for (int column = tile; column < tile_stop; column++) {
+                char c = line[column - tile];
+                Word cell = c ? Word(char_to_size(c)) : GAP_BIT;
+                cells_[column * words_ + word] |= cell << shift;
+            }
+        }
+    }
+}
+
+size_t AlignmentMatrix::memory() const {
+    return cells_.size() * sizeof(Word);
+}
+
+size_t AlignmentMatrix::memory(int rows, int columns) {
+    size_t words = (rows + CELLS_IN_WORD - 1) / CELLS_IN_WORD;
+    return words * columns * sizeof(Word);
+}
+
+const AlignmentMatrix* block_matrix(const Block* block,
+                                    AlignmentMatrix& local) {
+    const AlignmentMatrix* matrix = block->weak() ? 0 : block->matrix();
+    if (!matrix) {
+        local.build(block);
+        matrix = &local;
+    }
+    return matrix;
+}
+
+char AlignmentMatrix::at(int row, int column) const {
+    ASSERT_LT(row, rows_);
+    ASSERT_LT(column, columns_);
+    Word word = cells_[column * words_ + row / CELLS_IN_WORD];
+    Word cell = (word >> ((row % CELLS_IN_WORD) * CELL_BITS)) & CELL;
+    return (cell & GAP_BIT) ? 0 : size_to_char(cell);
+}
+
+void AlignmentMatrix::test_column(int column, bool& ident, bool& gap,
+                                  bool& pure_gap, int* atgc) const {
+    ASSERT_LT(column, columns_);
+    ident = true;
+    gap = false;
+    pure_gap = true;
+    Word pattern = 0;
+    const Word* words = words_ ? &cells_[column * words_] : 0;
+    for (int i = 0; i < words_; i++) {
+        Word mask = (i == words_ - 1) ? last_mask_ : ~Word(0);
+        Word word = words[i];
+        Word gap_bits = word & GAP_BITS & mask;
+        // all bits of cells with gaps
+        Word gap_cells = (gap_bits >> 3) * CELL;
+        Word letter_cells = mask & ~gap_cells;
+        if (gap_bits) {
+            gap = true;
+        }
+        if (!letter_cells) {
+            continue;
+        }
+        if (pure_gap) {
+            // first letter of column
+            int shift = 0;
+            while (!((letter_cells >> shift) & CELL)) {
+                shift += CELL_BITS;
+            }
+            pattern = ((word >> shift) & CELL) * LOW_BITS;
+            pure_gap = false;
+        }
+        if ((word ^ pattern) & letter_cells & LETTER_BITS) {
+            ident = false;
+        }
+        if (atgc) {
+            for (int letter = 0; letter < LETTERS_NUMBER; letter++) {
+                Word diff = (word ^ (letter * LOW_BITS)) & LETTER_BITS;
+                // low bit of cell is 1 if cell differs
+                Word differ = (diff | (diff >> 1) | (diff >> 2)) & LOW_BITS;
+                Word equal = ~differ & letter_cells & LOW_BITS;
+                atgc[letter] += popcount(equal);
+            }
+        }
+    }
+}
+
+}
+
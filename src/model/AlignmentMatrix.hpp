@@ -0,0 +1,85 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_ALIGNMENT_MATRIX_HPP_
+#define NPGE_ALIGNMENT_MATRIX_HPP_
+
+#include <vector>
+#include <boost/utility.hpp>
+#include <boost/cstdint.hpp>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Column-major matrix of letters of aligned fragments of block.
+Each cell takes 4 bits: 3 bits of letter (char_to_size)
+and gap bit. Cells of a column are packed into 32-bit words,
+so a column is tested word by word.
+Rows follow order of fragments in block.
+
+\see Block::matrix()
+*/
+class AlignmentMatrix : boost::noncopyable {
+public:
+    /** Constructor (empty matrix) */
+    AlignmentMatrix();
+
+    /** Constructor (matrix of block) */
+    AlignmentMatrix(const Block* block);
+
+    /** Replace contents of the matrix with letters of block */
+    void build(const Block* block);
+
+    /** Return number of rows (fragments) */
+    int rows() const {
+        return rows_;
+    }
+
+    /** Return number of columns (alignment length) */
+    int columns() const {
+        return columns_;
+    }
+
+    /** Return memory used by cells (bytes) */
+    size_t memory() const;
+
+    /** Return memory used by cells of matrix of given size */
+    static size_t memory(int rows, int columns);
+
+    /** Return letter of row in column or 0 for gap */
+    char at(int row, int column) const;
+
+    /** Test column of block.
+    Results are equal to results of test_column() (see block_stat.hpp).
+    atgc may be 0.
+    */
+    void test_column(int column, bool& ident, bool& gap,
+                     bool& pure_gap, int* atgc) const;
+
+private:
+    typedef boost::uint32_t Word;
+    typedef std::vector<Word> Words;
+
+    int rows_;
+    int columns_;
+    int words_; // words in column
+    Word last_mask_; // cells of last word of column, used by rows
+    Words cells_;
+};
+
+/** Return block->matrix() or matrix built in local.
+Local matrix is used for weak blocks and if the matrix
+is not cached (see Block::set_matrix_cache_limit()).
+*/
+const AlignmentMatrix* block_matrix(const Block* block,
+                                    AlignmentMatrix& local);
+
+}
+
+#endif
+
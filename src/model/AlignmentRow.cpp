@@ -8,11 +8,16 @@
 #include <cctype>
 #include <algorithm>
 #include <boost/lexical_cast.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
 
 #include "AlignmentRow.hpp"
 #include "Fragment.hpp"
+#include "Block.hpp"
 #include "throw_assert.hpp"
 #include "Exception.hpp"
+#include "FixedPool.hpp"
+#include "config.hpp"
 
 namespace npge {
 
@@ -23,6 +28,45 @@ AlignmentRow::AlignmentRow(Fragment* fragment):
     }
 }
 
+#ifdef NPGE_POOLS
+// never deleted, since rows may outlive static objects
+static FixedPool* rows_pool(size_t size) {
+    static FixedPool* compact = new FixedPool(sizeof(CompactAlignmentRow));
+    static FixedPool* map = new FixedPool(sizeof(MapAlignmentRow));
+    static FixedPool* gap = new FixedPool(sizeof(GapAlignmentRow));
+    if (size == sizeof(CompactAlignmentRow)) {
+        return compact;
+    } else if (size == sizeof(MapAlignmentRow)) {
+        return map;
+    } else if (size == sizeof(GapAlignmentRow)) {
+        return gap;
+    } else {
+        return 0;
+    }
+}
+#endif
+
+void* AlignmentRow::operator new(size_t size) {
+#ifdef NPGE_POOLS
+    FixedPool* pool = rows_pool(size);
+    if (pool) {
+        return pool->allocate();
+    }
+#endif
+    return ::operator new(size);
+}
+
+void AlignmentRow::operator delete(void* ptr, size_t size) {
+#ifdef NPGE_POOLS
+    FixedPool* pool = rows_pool(size);
+    if (pool) {
+        pool->deallocate(ptr);
+        return;
+    }
+#endif
+    ::operator delete(ptr);
+}
+
 AlignmentRow::~AlignmentRow() {
     if (fragment_) {
         Fragment* f = fragment_;
@@ -32,6 +76,7 @@ AlignmentRow::~AlignmentRow() {
 }
 
 void AlignmentRow::clear() {
+    drop_block_matrix();
     clear_impl();
 }
 
@@ -43,11 +88,33 @@ int AlignmentRow::map_to_fragment(int align_pos) const {
     return map_to_fragment_impl(align_pos);
 }
 
+void AlignmentRow::fragment_positions(int start, int stop,
+                                      int* positions) const {
+    int begin = std::max(start, 0);
+    int end = std::min(stop, length());
+    if (begin >= end) {
+        std::fill(positions, positions + (stop - start), -1);
+        return;
+    }
+    std::fill(positions, positions + (begin - start), -1);
+    fragment_positions_impl(begin, end, positions + (begin - start));
+    std::fill(positions + (end - start), positions + (stop - start), -1);
+}
+
+void AlignmentRow::fragment_positions_impl(int start, int stop,
+        int* positions) const {
+    for (int align_pos = start; align_pos < stop; align_pos++) {
+        positions[align_pos - start] = map_to_fragment(align_pos);
+    }
+}
+
 void AlignmentRow::bind(int fragment_pos, int align_pos) {
+    drop_block_matrix();
     bind_impl(fragment_pos, align_pos);
 }
 
 void AlignmentRow::grow(const std::string& alignment_string) {
+    drop_block_matrix();
     grow_impl(alignment_string);
 }
 
@@ -114,6 +181,7 @@ int AlignmentRow::nearest_in_fragment_impl(
 
 void AlignmentRow::assign(const AlignmentRow& other,
                           int start, int stop) {
+    drop_block_matrix();
     assign_impl(other, start, stop);
 }
 
@@ -134,6 +202,8 @@ void AlignmentRow::assign_impl(const AlignmentRow& other,
 AlignmentRow* AlignmentRow::new_row(RowType type) {
     if (type == COMPACT_ROW) {
         return new CompactAlignmentRow;
+    } else if (type == GAP_ROW) {
+        return new GapAlignmentRow;
     } else {
         // default = MAP_ROW
         return new MapAlignmentRow;
@@ -153,6 +223,10 @@ AlignmentRow* AlignmentRow::clone() const {
 AlignmentRow* AlignmentRow::slice(int start, int stop) const {
     ASSERT_LT(stop, length());
     ASSERT_LT(start, length());
+    return slice_impl(start, stop);
+}
+
+AlignmentRow* AlignmentRow::slice_impl(int start, int stop) const {
     int min = std::min(start, stop);
     int max = std::max(start, stop);
     int ori = (min == start) ? 1 : -1;
@@ -170,6 +244,63 @@ AlignmentRow* AlignmentRow::slice(int start, int stop) const {
     return new_row;
 }
 
+void AlignmentRow::bitsets(std::vector<CAR_Bitset>& bitsets) const {
+    bitsets_impl(bitsets);
+}
+
+void AlignmentRow::set_bitsets(const std::vector<CAR_Bitset>& bitsets,
+                               int length) {
+    drop_block_matrix();
+    set_bitsets_impl(bitsets, length);
+}
+
+bool AlignmentRow::share(const AlignmentRow& other) {
+    if (&other == this || other.length() != length()) {
+        return false;
+    }
+    return share_impl(other);
+}
+
+bool AlignmentRow::share_impl(const AlignmentRow& /* other */) {
+    return false;
+}
+
+void AlignmentRow::drop_block_matrix() const {
+    Block* block = fragment_ ? fragment_->block() : 0;
+    if (block) {
+        block->drop_matrix();
+    }
+}
+
+void AlignmentRow::bitsets_impl(std::vector<CAR_Bitset>& bitsets) const {
+    size_t first = bitsets.size();
+    for (int align_pos = 0; align_pos < length(); align_pos++) {
+        if (map_to_fragment(align_pos) != -1) {
+            size_t index = first + align_pos / BITS_IN_CHUNK;
+            if (index >= bitsets.size()) {
+                bitsets.resize(index + 1, 0);
+            }
+            bitsets[index] |= CAR_Bitset(1) << (align_pos % BITS_IN_CHUNK);
+        }
+    }
+}
+
+void AlignmentRow::set_bitsets_impl(const std::vector<CAR_Bitset>& bitsets,
+                                    int length) {
+    clear();
+    int fragment_pos = 0;
+    for (int i = 0; i < bitsets.size(); i++) {
+        CAR_Bitset bitset = bitsets[i];
+        for (int j = 0; j < BITS_IN_CHUNK; j++) {
+            if ((bitset >> j) & 0x01) {
+                bind(fragment_pos, i * BITS_IN_CHUNK + j);
+                fragment_pos += 1;
+            }
+        }
+    }
+    set_length(length);
+}
+
 MapAlignmentRow::MapAlignmentRow(const std::string& alignment_string,
                                  Fragment* fragment):
     AlignmentRow(fragment) {
@@ -217,10 +348,62 @@ int MapAlignmentRow::map_to_fragment_impl(
     }
 }
 
+void MapAlignmentRow::fragment_positions_impl(int start, int stop,
+        int* positions) const {
+    std::fill(positions, positions + (stop - start), -1);
+    Pos2Pos::const_iterator it = alignment_to_fragment_.lower_bound(start);
+    for (; it != alignment_to_fragment_.end() && it->first < stop; ++it) {
+        positions[it->first - start] = it->second;
+    }
+}
+
 RowType MapAlignmentRow::type_impl() const {
     return MAP_ROW;
 }
 
+// number of set bits in each byte
+#define NPGE_B2(n) n, n + 1, n + 1, n + 2
+#define NPGE_B4(n) NPGE_B2(n), NPGE_B2(n + 1), NPGE_B2(n + 1), NPGE_B2(n + 2)
+#define NPGE_B6(n) NPGE_B4(n), NPGE_B4(n + 1), NPGE_B4(n + 1), NPGE_B4(n + 2)
+static const unsigned char POPCOUNT_BYTES[256] = {
+    NPGE_B6(0), NPGE_B6(1), NPGE_B6(1), NPGE_B6(2)
+};
+#undef NPGE_B2
+#undef NPGE_B4
+#undef NPGE_B6
+
+static int popcount(CAR_Bitset bitset) {
+    int result = 0;
+    while (bitset) {
+        result += POPCOUNT_BYTES[bitset & 0xFF];
+        bitset >>= 8;
+    }
+    return result;
+}
+
+// position of n-th (0-based) set bit
+static int select_bit(CAR_Bitset bitset, int n) {
+    int shift = 0;
+    while (true) {
+        int in_byte = POPCOUNT_BYTES[(bitset >> shift) & 0xFF];
+        if (n < in_byte) {
+            break;
+        }
+        n -= in_byte;
+        shift += 8;
+    }
+    CAR_Bitset byte = (bitset >> shift) & 0xFF;
+    for (int i = 0; i < n; i++) {
+        byte &= byte - 1; // remove lowest bit
+    }
+    int pos = shift;
+    while (!(byte & 0x01)) {
+        byte >>= 1;
+        pos += 1;
+    }
+    return pos;
+}
+
 CompactAlignmentRow::CompactAlignmentRow(const std::string& alignment_string,
         Fragment* fragment):
     AlignmentRow(fragment) {
@@ -228,23 +411,43 @@ CompactAlignmentRow::CompactAlignmentRow(const std::string& alignment_string,
 }
 
 void CompactAlignmentRow::clear_impl() {
-    data_.clear();
+    pattern_.reset();
     set_length(0);
 }
 
 void CompactAlignmentRow::bind_impl(int /* fragment_pos */,
                                     int align_pos) {
-    Chunk& c = chunk(chunk_index(align_pos));
+    Pattern& p = mutable_pattern();
+    int index = chunk_index(align_pos);
+    Chunk& c = chunk(index);
     int internal_pos = pos_in_chunk(align_pos);
-    c.set(internal_pos);
+    if (c.get(internal_pos)) {
+        return;
+    }
+    bool last = (index == p.data_.size() - 1) &&
+                ((c.bitset >> internal_pos) == 0);
+    if (last) {
+        // new letter is appended
+        int fragment_pos = c.pos_in_fragment + popcount(c.bitset);
+        if (fragment_pos % BITS_IN_CHUNK == 0) {
+            p.select_.push_back(index);
+        }
+        c.set(internal_pos);
+    } else {
+        c.set(internal_pos);
+        for (int i = index + 1; i < p.data_.size(); i++) {
+            p.data_[i].pos_in_fragment += 1;
+        }
+        build_select();
+    }
 }
 
-static struct ChunkCompare {
+struct ChunkCompare {
     typedef CompactAlignmentRow::Chunk Chunk;
-    bool operator()(const Chunk& c1, int pos) const {
-        return c1.pos_in_fragment > pos;
+    bool operator()(int pos, const Chunk& c) const {
+        return pos < c.pos_in_fragment;
     }
-} cc;
+};
 
 int CompactAlignmentRow::map_to_alignment_impl(
     int fragment_pos) const {
@@ -254,17 +457,27 @@ int CompactAlignmentRow::map_to_alignment_impl(
     if (fragment() && fragment_pos >= fragment()->length()) {
         return -1;
     }
-    Data::const_reverse_iterator it = std::lower_bound(data_.rbegin(),
-                                      data_.rend(), fragment_pos, cc);
-    if (it == data_.rend()) {
+    const Pattern& p = pattern();
+    int sample = fragment_pos / BITS_IN_CHUNK;
+    if (sample >= p.select_.size()) {
+        return -1;
+    }
+    // chunk with the letter is between this sample and next one
+    Data::const_iterator begin = p.data_.begin() + p.select_[sample];
+    Data::const_iterator end = (sample + 1 < p.select_.size()) ?
+                               p.data_.begin() + p.select_[sample + 1] + 1 :
+                               p.data_.end();
+    Data::const_iterator it = std::upper_bound(begin, end,
+                              fragment_pos, ChunkCompare());
+    ASSERT_TRUE(it != begin);
+    const Chunk& c = *(it - 1);
+    int internal_pos = fragment_pos - c.pos_in_fragment;
+    ASSERT_LTE(0, internal_pos);
+    if (internal_pos >= c.size()) {
+        // after last letter
         return -1;
-    } else {
-        const Chunk& c = *it;
-        int internal_pos = fragment_pos - c.pos_in_fragment;
-        ASSERT_LTE(0, internal_pos);
-        ASSERT_LT(internal_pos, BITS_IN_CHUNK);
-        return to_align_pos(&c) + c.map_to_alignment(internal_pos);
     }
+    return to_align_pos(&c) + c.map_to_alignment(internal_pos);
 }
 
 int CompactAlignmentRow::map_to_fragment_impl(
@@ -273,46 +486,104 @@ int CompactAlignmentRow::map_to_fragment_impl(
         return -1;
     }
     int index = chunk_index(align_pos);
-    if (index >= data_.size()) {
+    const Pattern& p = pattern();
+    if (index >= p.data_.size()) {
         return -1;
     }
     int internal_pos = pos_in_chunk(align_pos);
-    const Chunk& chunk = data_[chunk_index(align_pos)];
+    const Chunk& chunk = p.data_[index];
     int shift = chunk.map_to_fragment(internal_pos);
     return shift == -1 ? -1 : chunk.pos_in_fragment + shift;
 }
 
+void CompactAlignmentRow::fragment_positions_impl(int start, int stop,
+        int* positions) const {
+    const Pattern& p = pattern();
+    int fragment_pos = rank(start);
+    int data_stop = std::min(stop, int(p.data_.size()) * BITS_IN_CHUNK);
+    for (int align_pos = start; align_pos < data_stop; align_pos++) {
+        const Chunk& c = p.data_[chunk_index(align_pos)];
+        if (c.get(pos_in_chunk(align_pos))) {
+            *positions = fragment_pos;
+            fragment_pos += 1;
+        } else {
+            *positions = -1;
+        }
+        positions += 1;
+    }
+    for (int align_pos = data_stop; align_pos < stop; align_pos++) {
+        *positions = -1;
+        positions += 1;
+    }
+}
+
+int CompactAlignmentRow::nearest_in_fragment_impl(int align_pos) const {
+    int result = map_to_fragment(align_pos);
+    if (result != -1) {
+        return result;
+    }
+    // letters before and after align_pos
+    int before = rank(align_pos);
+    int prev_pos = (before > 0) ? map_to_alignment(before - 1) : -1;
+    int next_pos = (before < letters()) ? map_to_alignment(before) : -1;
+    int prev_distance = (prev_pos == -1) ? -1 : align_pos - prev_pos;
+    int next_distance = (next_pos == -1) ? -1 : next_pos - align_pos;
+    // same as AlignmentRow::nearest_in_fragment_impl: previous
+    // letter is preferred, distance is at most length()
+    if (prev_distance != -1 && prev_distance <= length() &&
+            (next_distance == -1 || prev_distance <= next_distance)) {
+        return before - 1;
+    }
+    if (next_distance != -1 && next_distance <= length()) {
+        return before;
+    }
+    return -1;
+}
+
 RowType CompactAlignmentRow::type_impl() const {
     return COMPACT_ROW;
 }
 
+void CompactAlignmentRow::bitsets_impl(
+    std::vector<CAR_Bitset>& bitsets) const {
+    const Pattern& p = pattern();
+    int size = p.data_.size();
+    while (size > 0 && p.data_[size - 1].bitset == 0) {
+        size -= 1;
+    }
+    for (int i = 0; i < size; i++) {
+        bitsets.push_back(p.data_[i].bitset);
+    }
+}
+
+void CompactAlignmentRow::set_bitsets_impl(
+    const std::vector<CAR_Bitset>& bitsets, int length) {
+    clear();
+    Pattern& p = mutable_pattern();
+    p.data_.resize(bitsets.size());
+    Index pos_in_fragment = 0;
+    for (int i = 0; i < bitsets.size(); i++) {
+        Chunk& c = p.data_[i];
+        c.bitset = bitsets[i];
+        c.pos_in_fragment = pos_in_fragment;
+        pos_in_fragment += popcount(c.bitset);
+    }
+    build_select();
+    set_length(length);
+}
+
 CompactAlignmentRow::Chunk::Chunk():
     pos_in_fragment(0), bitset(0) {
 }
 
 int CompactAlignmentRow::Chunk::size() const {
-    int s = 0;
-    for (int i = 0; i < BITS_IN_CHUNK; i++) {
-        if (get(i)) {
-            s += 1;
-        }
-    }
-    return s;
+    return popcount(bitset);
 }
 
 int CompactAlignmentRow::Chunk::map_to_alignment(int fragment_pos) const {
     ASSERT_LT(fragment_pos, BITS_IN_CHUNK);
-    int fragment = 0;
-    for (int i = 0; i < BITS_IN_CHUNK; i++) {
-        if (get(i)) {
-            if (fragment == fragment_pos) {
-                return i;
-            }
-            fragment += 1;
-        }
-    }
-    ASSERT_EQ(fragment_pos, 0);
-    return 0;
+    ASSERT_LT(fragment_pos, size());
+    return select_bit(bitset, fragment_pos);
 }
 
 int CompactAlignmentRow::Chunk::map_to_fragment(int align_pos) const {
@@ -320,13 +591,9 @@ int CompactAlignmentRow::Chunk::map_to_fragment(int align_pos) const {
     if (!get(align_pos)) {
         return -1;
     }
-    int result = 0;
-    for (int i = 0; i <= align_pos; i++) {
-        if (get(i)) {
-            result += 1;
-        }
-    }
-    return result - 1;
+    // letters before align_pos
+    Bitset mask = (Bitset(1) << align_pos) - 1;
+    return popcount(bitset & mask);
 }
 
 bool CompactAlignmentRow::Chunk::get(int align_pos) const {
@@ -346,23 +613,425 @@ int CompactAlignmentRow::pos_in_chunk(int align_pos) {
 }
 
 CompactAlignmentRow::Chunk& CompactAlignmentRow::chunk(int index) {
-    if (index >= data_.size()) {
+    Pattern& p = mutable_pattern();
+    if (index >= p.data_.size()) {
         Chunk c;
-        if (!data_.empty()) {
-            const Chunk&  back = data_.back();
+        if (!p.data_.empty()) {
+            const Chunk&  back = p.data_.back();
             c.pos_in_fragment = back.pos_in_fragment + back.size();
         }
-        data_.resize(index + 1, c);
+        p.data_.resize(index + 1, c);
     }
-    return data_[index];
+    return p.data_[index];
 }
 
 int CompactAlignmentRow::to_align_pos(const Chunk* chunk) const {
+    const Pattern& p = pattern();
     return (reinterpret_cast<const char*>(chunk) -
-            reinterpret_cast<const char*>(&data_[0]))
+            reinterpret_cast<const char*>(&p.data_[0]))
            / sizeof(Chunk) * BITS_IN_CHUNK;
 }
 
+int CompactAlignmentRow::letters() const {
+    const Pattern& p = pattern();
+    if (p.data_.empty()) {
+        return 0;
+    }
+    const Chunk& back = p.data_.back();
+    return back.pos_in_fragment + back.size();
+}
+
+int CompactAlignmentRow::rank(int align_pos) const {
+    if (align_pos <= 0) {
+        return 0;
+    }
+    int index = chunk_index(align_pos);
+    const Pattern& p = pattern();
+    if (index >= p.data_.size()) {
+        return letters();
+    }
+    const Chunk& c = p.data_[index];
+    Bitset mask = (Bitset(1) << pos_in_chunk(align_pos)) - 1;
+    return c.pos_in_fragment + popcount(c.bitset & mask);
+}
+
+void CompactAlignmentRow::build_select() {
+    Pattern& p = mutable_pattern();
+    p.select_.clear();
+    int next_sample = 0;
+    for (int i = 0; i < p.data_.size(); i++) {
+        const Chunk& c = p.data_[i];
+        int end = c.pos_in_fragment + c.size();
+        while (next_sample < end) {
+            p.select_.push_back(i);
+            next_sample += BITS_IN_CHUNK;
+        }
+    }
+}
+
+void CompactAlignmentRow::assign_impl(const AlignmentRow& other,
+                                      int start, int stop) {
+    const CompactAlignmentRow* o;
+    o = dynamic_cast<const CompactAlignmentRow*>(&other);
+    if (o && start == 0 && (stop == -1 || stop == other.length() - 1)) {
+        // whole row: share pattern
+        pattern_ = o->pattern_;
+        set_length(o->length());
+    } else {
+        AlignmentRow::assign_impl(other, start, stop);
+    }
+}
+
+AlignmentRow* CompactAlignmentRow::slice_impl(int start, int stop) const {
+    if (start == 0 && stop == length() - 1) {
+        return clone();
+    } else {
+        return AlignmentRow::slice_impl(start, stop);
+    }
+}
+
+bool CompactAlignmentRow::share_impl(const AlignmentRow& other) {
+    const CompactAlignmentRow* o;
+    o = dynamic_cast<const CompactAlignmentRow*>(&other);
+    if (!o) {
+        return false;
+    }
+    if (o->pattern_ == pattern_) {
+        return true;
+    }
+    const Data& a = pattern().data_;
+    const Data& b = o->pattern().data_;
+    int size = std::min(a.size(), b.size());
+    for (int i = 0; i < size; i++) {
+        if (a[i].bitset != b[i].bitset) {
+            return false;
+        }
+    }
+    for (int i = size; i < a.size(); i++) {
+        if (a[i].bitset) {
+            return false;
+        }
+    }
+    for (int i = size; i < b.size(); i++) {
+        if (b[i].bitset) {
+            return false;
+        }
+    }
+    pattern_ = o->pattern_;
+    return true;
+}
+
+const CompactAlignmentRow::Pattern& CompactAlignmentRow::pattern() const {
+    if (pattern_) {
+        return *pattern_;
+    }
+    // never deleted, used by empty rows
+    static const Pattern* empty = new Pattern;
+    return *empty;
+}
+
+CompactAlignmentRow::Pattern& CompactAlignmentRow::mutable_pattern() {
+    if (!pattern_) {
+        pattern_ = boost::make_shared<Pattern>();
+    } else if (!pattern_.unique()) {
+        // copy on write
+        pattern_ = boost::make_shared<Pattern>(*pattern_);
+    }
+    return *pattern_;
+}
+
+GapAlignmentRow::GapAlignmentRow(const std::string& alignment_string,
+                                 Fragment* fragment):
+    AlignmentRow(fragment), end_(0), letters_(0) {
+    grow(alignment_string);
+}
+
+void GapAlignmentRow::clear_impl() {
+    gaps_.clear();
+    end_ = 0;
+    letters_ = 0;
+    set_length(0);
+}
+
+int GapAlignmentRow::total_gaps() const {
+    if (gaps_.empty()) {
+        return 0;
+    } else {
+        const Gap& last = gaps_.back();
+        return last.gaps_before + last.length;
+    }
+}
+
+int GapAlignmentRow::find_gap(int align_pos) const {
+    // last gap starting at or before align_pos
+    int low = 0, high = gaps_.size();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (gaps_[middle].align_pos <= align_pos) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low - 1;
+}
+
+void GapAlignmentRow::bind_impl(int /* fragment_pos */,
+                                int align_pos) {
+    if (align_pos >= end_) {
+        // usual case: letters are added from left to right
+        if (align_pos > end_) {
+            Gap gap;
+            gap.align_pos = end_;
+            gap.length = align_pos - end_;
+            gap.gaps_before = total_gaps();
+            gaps_.push_back(gap);
+        }
+        end_ = align_pos + 1;
+        letters_ += 1;
+        return;
+    }
+    int index = find_gap(align_pos);
+    if (index == -1) {
+        return;
+    }
+    Gap& gap = gaps_[index];
+    int left = align_pos - gap.align_pos;
+    int right = gap.align_pos + gap.length - align_pos - 1;
+    if (right < 0) {
+        // already a letter
+        return;
+    }
+    int next = index + 1;
+    if (left > 0 && right > 0) {
+        gap.length = left;
+        Gap right_gap;
+        right_gap.align_pos = align_pos + 1;
+        right_gap.length = right;
+        right_gap.gaps_before = gap.gaps_before + left;
+        gaps_.insert(gaps_.begin() + next, right_gap);
+        next += 1;
+    } else if (right > 0) {
+        gap.align_pos = align_pos + 1;
+        gap.length = right;
+    } else if (left > 0) {
+        gap.length = left;
+    } else {
+        gaps_.erase(gaps_.begin() + index);
+        next = index;
+    }
+    for (int i = next; i < gaps_.size(); i++) {
+        gaps_[i].gaps_before -= 1;
+    }
+    letters_ += 1;
+}
+
+int GapAlignmentRow::map_to_alignment_impl(
+    int fragment_pos) const {
+    if (fragment_pos >= length() || fragment_pos < 0) {
+        return -1;
+    }
+    if (fragment() && fragment_pos >= fragment()->length()) {
+        return -1;
+    }
+    if (fragment_pos >= letters_) {
+        return -1;
+    }
+    // last gap with less than fragment_pos + 1 letters before it
+    int low = 0, high = gaps_.size();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        const Gap& gap = gaps_[middle];
+        if (gap.align_pos - gap.gaps_before <= fragment_pos) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0) {
+        return fragment_pos;
+    } else {
+        const Gap& gap = gaps_[low - 1];
+        return fragment_pos + gap.gaps_before + gap.length;
+    }
+}
+
+int GapAlignmentRow::map_to_fragment_impl(int align_pos) const {
+    if (align_pos >= end_ || align_pos < 0) {
+        return -1;
+    }
+    int index = find_gap(align_pos);
+    if (index == -1) {
+        return align_pos;
+    }
+    const Gap& gap = gaps_[index];
+    if (align_pos < gap.align_pos + gap.length) {
+        return -1;
+    }
+    return align_pos - gap.gaps_before - gap.length;
+}
+
+void GapAlignmentRow::fragment_positions_impl(int start, int stop,
+        int* positions) const {
+    int letters_stop = std::min(stop, end_);
+    int index = find_gap(start);
+    int fragment_pos = start;
+    if (index != -1) {
+        const Gap& gap = gaps_[index];
+        fragment_pos -= gap.gaps_before + gap.length;
+        if (start < gap.align_pos + gap.length) {
+            // start is inside the gap
+            fragment_pos = gap.align_pos - gap.gaps_before;
+        }
+    }
+    int align_pos = start;
+    for (int i = std::max(index, 0); i < gaps_.size(); i++) {
+        const Gap& gap = gaps_[i];
+        if (gap.align_pos >= letters_stop) {
+            break;
+        }
+        for (; align_pos < gap.align_pos; align_pos++) {
+            positions[align_pos - start] = fragment_pos;
+            fragment_pos += 1;
+        }
+        int gap_stop = std::min(gap.align_pos + gap.length, letters_stop);
+        for (; align_pos < gap_stop; align_pos++) {
+            positions[align_pos - start] = -1;
+        }
+    }
+    for (; align_pos < letters_stop; align_pos++) {
+        positions[align_pos - start] = fragment_pos;
+        fragment_pos += 1;
+    }
+    for (; align_pos < stop; align_pos++) {
+        positions[align_pos - start] = -1;
+    }
+}
+
+int GapAlignmentRow::prev_letter(int align_pos) const {
+    if (align_pos < 0 || letters_ == 0) {
+        return -1;
+    }
+    align_pos = std::min(align_pos, end_ - 1);
+    int index = find_gap(align_pos);
+    if (index != -1) {
+        const Gap& gap = gaps_[index];
+        if (align_pos < gap.align_pos + gap.length) {
+            // -1 if the gap is leading
+            return gap.align_pos - 1;
+        }
+    }
+    return align_pos;
+}
+
+int GapAlignmentRow::next_letter(int align_pos) const {
+    align_pos = std::max(align_pos, 0);
+    if (align_pos >= end_) {
+        return -1;
+    }
+    int index = find_gap(align_pos);
+    if (index != -1) {
+        const Gap& gap = gaps_[index];
+        if (align_pos < gap.align_pos + gap.length) {
+            // gap is followed by a letter
+            return gap.align_pos + gap.length;
+        }
+    }
+    return align_pos;
+}
+
+int GapAlignmentRow::nearest_in_fragment_impl(int align_pos) const {
+    // same result as AlignmentRow::nearest_in_fragment_impl
+    int prev = prev_letter(align_pos);
+    int next = next_letter(align_pos);
+    int prev_distance = (prev == -1) ? -1 : align_pos - prev;
+    int next_distance = (next == -1) ? -1 : next - align_pos;
+    if (prev_distance > length()) {
+        prev_distance = -1;
+    }
+    if (next_distance > length()) {
+        next_distance = -1;
+    }
+    if (prev_distance != -1 &&
+            (next_distance == -1 || prev_distance <= next_distance)) {
+        return map_to_fragment(prev);
+    } else if (next_distance != -1) {
+        return map_to_fragment(next);
+    } else {
+        return -1;
+    }
+}
+
+void GapAlignmentRow::assign_impl(const AlignmentRow& other,
+                                  int start, int stop) {
+    const GapAlignmentRow* o = dynamic_cast<const GapAlignmentRow*>(&other);
+    if (o && start == 0 && stop == -1) {
+        gaps_ = o->gaps_;
+        end_ = o->end_;
+        letters_ = o->letters_;
+        set_length(o->length());
+    } else {
+        AlignmentRow::assign_impl(other, start, stop);
+    }
+}
+
+AlignmentRow* GapAlignmentRow::slice_impl(int start, int stop) const {
+    int min = std::min(start, stop);
+    int max = std::max(start, stop);
+    int ori = (min == start) ? 1 : -1;
+    int l = max - min + 1;
+    // gaps and trailing gaps, clipped to [min, max]
+    Intervals intervals;
+    for (int i = 0; i <= gaps_.size(); i++) {
+        int gap_start, gap_stop;
+        if (i < gaps_.size()) {
+            gap_start = gaps_[i].align_pos;
+            gap_stop = gap_start + gaps_[i].length;
+        } else {
+            gap_start = end_;
+            gap_stop = length();
+        }
+        gap_start = std::max(gap_start, min);
+        gap_stop = std::min(gap_stop, max + 1);
+        if (gap_start < gap_stop) {
+            int new_start = (ori == 1) ? (gap_start - min) :
+                            (max + 1 - gap_stop);
+            intervals.push_back(Interval(new_start, gap_stop - gap_start));
+        }
+    }
+    if (ori == -1) {
+        std::reverse(intervals.begin(), intervals.end());
+    }
+    GapAlignmentRow* result = new GapAlignmentRow;
+    result->set_gaps(intervals, l);
+    return result;
+}
+
+void GapAlignmentRow::set_gaps(const Intervals& intervals, int length) {
+    clear();
+    end_ = length;
+    int gaps = 0;
+    BOOST_FOREACH (const Interval& interval, intervals) {
+        if (interval.first + interval.second == length) {
+            // trailing gaps
+            end_ = interval.first;
+        } else {
+            Gap gap;
+            gap.align_pos = interval.first;
+            gap.length = interval.second;
+            gap.gaps_before = gaps;
+            gaps_.push_back(gap);
+            gaps += interval.second;
+        }
+    }
+    letters_ = end_ - gaps;
+    set_length(length);
+}
+
+RowType GapAlignmentRow::type_impl() const {
+    return GAP_ROW;
+}
+
 InversedRow::InversedRow(AlignmentRow* source):
     source_(0), fragment_length_(0) {
     set_source(source);
@@ -8,21 +8,35 @@
 #ifndef NPGE_ALIGNMENT_ROW_HPP_
 #define NPGE_ALIGNMENT_ROW_HPP_
 
+#include <new>
 #include <map>
 #include <vector>
 #include <string>
 #include <boost/utility.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include "global.hpp"
 
 namespace npge {
 
+typedef unsigned int CAR_Bitset;
+const int BITS_IN_CHUNK = sizeof(CAR_Bitset) * 8;
+
 class AlignmentRow : boost::noncopyable {
 public:
     AlignmentRow(Fragment* fragment = 0);
 
     virtual ~AlignmentRow();
 
+    /** Allocate memory for row.
+    If NPGE_POOLS is set, memory of CompactAlignmentRow,
+    MapAlignmentRow and GapAlignmentRow is taken from FixedPool.
+    */
+    static void* operator new(size_t size);
+
+    /** Free memory of row */
+    static void operator delete(void* ptr, size_t size);
+
     void clear();
 
     /** Grow alignment row with string representing a part of alignment.
@@ -39,11 +53,20 @@ public:
 
     int map_to_fragment(int align_pos) const;
 
+    /** Write positions in fragment of columns [start, stop).
+    Element i of positions corresponds to column start + i.
+    Gaps and columns outside of the row are written as -1.
+    Result is same as map_to_fragment() applied to each column,
+    but the row is walked once.
+    */
+    void fragment_positions(int start, int stop, int* positions) const;
+
     int length() const {
         return length_;
     }
 
     void set_length(int length) {
+        drop_block_matrix();
         length_ = length;
     }
 
@@ -64,6 +87,27 @@ public:
 
     RowType type() const;
 
+    /** Append bitsets of the row to the vector.
+    Bit i of element j is set if column j * BITS_IN_CHUNK + i
+    is occupied by a letter. Trailing gaps are not stored.
+    */
+    void bitsets(std::vector<CAR_Bitset>& bitsets) const;
+
+    /** Replace contents of the row with bitsets.
+    \see bitsets()
+    */
+    void set_bitsets(const std::vector<CAR_Bitset>& bitsets,
+                     int length);
+
+    /** Make this row use storage of equal row.
+    Return if storage is shared now.
+    Rows of same type can share storage (now only
+    CompactAlignmentRow). Shared storage is copied
+    before change of one of the rows.
+    \see Block::share_rows()
+    */
+    bool share(const AlignmentRow& other);
+
 protected:
     virtual void clear_impl() = 0;
     virtual RowType type_impl() const = 0;
@@ -78,11 +122,25 @@ protected:
 
     virtual int map_to_fragment_impl(int align_pos) const = 0;
 
+    /** Called with 0 <= start <= stop <= length() */
+    virtual void fragment_positions_impl(int start, int stop,
+                                         int* positions) const;
+
     virtual int nearest_in_fragment_impl(int align_pos) const;
 
     virtual void assign_impl(const AlignmentRow& other,
                              int start = 0, int stop = -1);
 
+    virtual AlignmentRow* slice_impl(int start, int stop) const;
+
+    virtual void bitsets_impl(std::vector<CAR_Bitset>& bitsets) const;
+
+    virtual void set_bitsets_impl(const std::vector<CAR_Bitset>& bitsets,
+                                  int length);
+
+    /** Default implementation returns false */
+    virtual bool share_impl(const AlignmentRow& other);
+
 private:
     int length_;
     Fragment* fragment_;
@@ -91,6 +149,9 @@ private:
         fragment_ = fragment;
     }
 
+    // see Block::matrix()
+    void drop_block_matrix() const;
+
     friend class Fragment;
 };
 
@@ -108,6 +169,9 @@ protected:
 
     int map_to_fragment_impl(int align_pos) const;
 
+    void fragment_positions_impl(int start, int stop,
+                                 int* positions) const;
+
     RowType type_impl() const;
 
 private:
@@ -117,9 +181,17 @@ private:
     Pos2Pos alignment_to_fragment_;
 };
 
-typedef unsigned int CAR_Bitset;
-const int BITS_IN_CHUNK = sizeof(CAR_Bitset) * 8;
+/** Row storing bitset of occupied columns.
+Each chunk of BITS_IN_CHUNK columns stores number of letters
+in previous chunks (rank), so map_to_fragment is O(1).
+Chunks containing each BITS_IN_CHUNK-th letter are sampled
+(select), so map_to_alignment looks through chunks between
+two samples only.
 
+Chunks and samples (pattern of gaps) are shared by copies
+of the row (clone(), assign() of whole row, share())
+and are copied when one of the rows changes.
+*/
 class CompactAlignmentRow : public AlignmentRow {
 public:
     CompactAlignmentRow(const std::string& alignment_string = "",
@@ -128,15 +200,35 @@ public:
 protected:
     void clear_impl();
 
-    // TODO Currently works only forward
+    /** Bind letter.
+    Binding in order of align_pos is O(1), otherwise
+    counters of following chunks are updated.
+    */
     void bind_impl(int fragment_pos, int align_pos);
 
     int map_to_alignment_impl(int fragment_pos) const;
 
     int map_to_fragment_impl(int align_pos) const;
 
+    void fragment_positions_impl(int start, int stop,
+                                 int* positions) const;
+
+    int nearest_in_fragment_impl(int align_pos) const;
+
     RowType type_impl() const;
 
+    void bitsets_impl(std::vector<CAR_Bitset>& bitsets) const;
+
+    void set_bitsets_impl(const std::vector<CAR_Bitset>& bitsets,
+                          int length);
+
+    void assign_impl(const AlignmentRow& other,
+                     int start = 0, int stop = -1);
+
+    AlignmentRow* slice_impl(int start, int stop) const;
+
+    bool share_impl(const AlignmentRow& other);
+
 private:
     typedef CAR_Bitset Bitset;
     typedef unsigned int Index;
@@ -154,17 +246,86 @@ private:
         void set(int align_pos); // TODO value = true|false
     };
     typedef std::vector<Chunk> Data;
+    typedef std::vector<Index> Samples;
+
+    struct Pattern {
+        Data data_;
+
+        // index of chunk with letter i * BITS_IN_CHUNK
+        Samples select_;
+    };
+
+    // 0 for empty row
+    boost::shared_ptr<Pattern> pattern_;
 
-    Data data_;
+    const Pattern& pattern() const;
+    Pattern& mutable_pattern();
 
     static int chunk_index(int align_pos);
     static int pos_in_chunk(int align_pos);
     Chunk& chunk(int index);
     int to_align_pos(const Chunk* chunk) const;
+    int letters() const;
+    int rank(int align_pos) const;
+    void build_select();
 
     friend struct ChunkCompare;
 };
 
+/** Row storing runs of gaps.
+Each run stores position in alignment, length and total length
+of previous runs, so positions are mapped by binary search
+(O(log g), where g is number of runs).
+Trailing gaps are not stored.
+Rows of blocks with few indels take little memory.
+*/
+class GapAlignmentRow : public AlignmentRow {
+public:
+    GapAlignmentRow(const std::string& alignment_string = "",
+                    Fragment* fragment = 0);
+
+protected:
+    void clear_impl();
+
+    void bind_impl(int fragment_pos, int align_pos);
+
+    int map_to_alignment_impl(int fragment_pos) const;
+
+    int map_to_fragment_impl(int align_pos) const;
+
+    void fragment_positions_impl(int start, int stop,
+                                 int* positions) const;
+
+    int nearest_in_fragment_impl(int align_pos) const;
+
+    void assign_impl(const AlignmentRow& other,
+                     int start = 0, int stop = -1);
+
+    AlignmentRow* slice_impl(int start, int stop) const;
+
+    RowType type_impl() const;
+
+private:
+    struct Gap {
+        int align_pos;
+        int length;
+        int gaps_before;
+    };
+    typedef std::vector<Gap> Gaps;
+    typedef std::pair<int, int> Interval; // start, length
+    typedef std::vector<Interval> Intervals;
+
+    Gaps gaps_;
+    int end_; // position after last letter
+    int letters_;
+
+    int total_gaps() const;
+    int find_gap(int align_pos) const;
+    int prev_letter(int align_pos) const;
+    int next_letter(int align_pos) const;
+    void set_gaps(const Intervals& intervals, int length);
+};
+
 /** Proxy class for inversed row.
 Read-only.
 */
@@ -8,14 +8,20 @@
 #include <cctype>
 #include <map>
 #include <set>
+#include <vector>
 #include <algorithm>
 #include "boost-xtime.hpp"
 #include <boost/foreach.hpp>
 #include <boost/lexical_cast.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/functional/hash.hpp>
 
 #include "Block.hpp"
 #include "Fragment.hpp"
 #include "AlignmentRow.hpp"
+#include "AlignmentMatrix.hpp"
 #include "block_stat.hpp"
 #include "block_hash.hpp"
 #include "rand_name.hpp"
@@ -23,19 +29,52 @@
 #include "convert_position.hpp"
 #include "throw_assert.hpp"
 #include "cast.hpp"
+#include "FixedPool.hpp"
+#include "config.hpp"
 
 namespace npge {
 
 const int BLOCK_RAND_NAME_SIZE = 8;
 
+// incremented by each renaming of a block
+static boost::detail::atomic_count names_generation_(0);
+
 Block::Block():
     name_(BLOCK_RAND_NAME_SIZE, '0'),
-    weak_(false) {
+    weak_(false), matrix_(0) {
 }
 
+// new block is not in any blockset, so names_generation_
+// is not changed by constructors
 Block::Block(const std::string& name):
-    weak_(false) {
-    set_name(name);
+    name_(name), weak_(false), matrix_(0) {
+}
+
+#ifdef NPGE_POOLS
+// never deleted, since blocks may outlive static objects
+static FixedPool& blocks_pool() {
+    static FixedPool* pool = new FixedPool(sizeof(Block));
+    return *pool;
+}
+#endif
+
+void* Block::operator new(size_t size) {
+#ifdef NPGE_POOLS
+    if (size == sizeof(Block)) {
+        return blocks_pool().allocate();
+    }
+#endif
+    return ::operator new(size);
+}
+
+void Block::operator delete(void* ptr, size_t size) {
+#ifdef NPGE_POOLS
+    if (size == sizeof(Block)) {
+        blocks_pool().deallocate(ptr);
+        return;
+    }
+#endif
+    ::operator delete(ptr);
 }
 
 Block::~Block() {
@@ -43,6 +82,7 @@ Block::~Block() {
 }
 
 void Block::insert(Fragment* fragment) {
+    drop_matrix();
     fragments_.push_back(fragment);
     if (!weak() || !fragment->block_raw_ptr()) {
         fragment->set_block(this);
@@ -52,6 +92,7 @@ void Block::insert(Fragment* fragment) {
 void Block::erase(Fragment* fragment) {
     Impl::iterator it = std::find(begin(), end(), fragment);
     ASSERT_TRUE(it != end());
+    drop_matrix();
     fragments_.erase(it);
     if (fragment->block_raw_ptr() == this) {
         fragment->set_block(0);
@@ -79,6 +120,7 @@ bool Block::has(Fragment* fragment) const {
 }
 
 void Block::clear() {
+    drop_matrix();
     BOOST_FOREACH (Fragment* fragment, *this) {
         if (!weak() && fragment->block_raw_ptr() == this) {
             fragment->set_block(0);
@@ -89,8 +131,11 @@ void Block::clear() {
 }
 
 void Block::swap(Block& other) {
+    drop_matrix();
+    other.drop_matrix();
     fragments_.swap(other.fragments_);
     name_.swap(other.name_);
+    ++names_generation_;
     std::swap(weak_, other.weak_);
     if (!this->weak()) {
         BOOST_FOREACH (Fragment* f, *this) {
@@ -144,13 +189,7 @@ Decimal Block::identity() const {
     return block_identity(al_stat);
 }
 
-char Block::consensus_char(pos_t pos, char gap) const {
-    int freq[LETTERS_NUMBER];
-    for (int i = 0; i < LETTERS_NUMBER; i++) {
-        freq[i] = 0;
-    }
-    bool _;
-    test_column(this, pos, _, _, _, freq);
+static char most_frequent(const int* freq, char gap) {
     int max_freq = 0;
     for (int letter = 0; letter < LETTERS_NUMBER; letter++) {
         if (freq[letter] > max_freq) {
@@ -165,6 +204,92 @@ char Block::consensus_char(pos_t pos, char gap) const {
     return gap;
 }
 
+typedef boost::mutex Mutex;
+typedef boost::mutex::scoped_lock Lock;
+
+const int MATRIX_MUTEXES = 64;
+
+// never deleted, since blocks may outlive static objects
+static Mutex& matrix_mutex(const Block* block) {
+    static Mutex* mutexes = new Mutex[MATRIX_MUTEXES];
+    size_t index = (size_t(block) / sizeof(Block)) % MATRIX_MUTEXES;
+    return mutexes[index];
+}
+
+// memory of cached matrices, protected by cache_mutex()
+static size_t matrix_cache_limit_ = 0;
+static size_t matrix_cache_size_ = 0;
+
+// number of cached matrices, read without locks
+static boost::detail::atomic_count cached_matrices_(0);
+
+static Mutex& cache_mutex() {
+    static Mutex* mutex = new Mutex;
+    return *mutex;
+}
+
+const AlignmentMatrix* Block::matrix() const {
+    ASSERT_FALSE(weak());
+    Lock lock(matrix_mutex(this));
+    if (!matrix_) {
+        size_t memory = AlignmentMatrix::memory(size(),
+                                                alignment_length());
+        {
+            Lock cache_lock(cache_mutex());
+            if (matrix_cache_limit_ == 0 ||
+                    matrix_cache_size_ + memory > matrix_cache_limit_) {
+                return 0;
+            }
+            matrix_cache_size_ += memory;
+        }
+        matrix_ = new AlignmentMatrix(this);
+        ++cached_matrices_;
+    }
+    return matrix_;
+}
+
+void Block::drop_matrix() const {
+    if (cached_matrices_ == 0) {
+        // changes of rows do not lock mutexes if nothing is cached
+        return;
+    }
+    Lock lock(matrix_mutex(this));
+    if (matrix_) {
+        --cached_matrices_;
+        {
+            Lock cache_lock(cache_mutex());
+            matrix_cache_size_ -= matrix_->memory();
+        }
+        delete matrix_;
+        matrix_ = 0;
+    }
+}
+
+void Block::set_matrix_cache_limit(size_t bytes) {
+    Lock cache_lock(cache_mutex());
+    matrix_cache_limit_ = bytes;
+}
+
+size_t Block::matrix_cache_limit() {
+    Lock cache_lock(cache_mutex());
+    return matrix_cache_limit_;
+}
+
+size_t Block::matrix_cache_size() {
+    Lock cache_lock(cache_mutex());
+    return matrix_cache_size_;
+}
+
+char Block::consensus_char(pos_t pos, char gap) const {
+    int freq[LETTERS_NUMBER];
+    for (int i = 0; i < LETTERS_NUMBER; i++) {
+        freq[i] = 0;
+    }
+    bool _;
+    test_column(this, pos, _, _, _, freq);
+    return most_frequent(freq, gap);
+}
+
 void Block::consensus(std::ostream& o, char gap) const {
     if (!empty() && !front()->row()) {
         Fragment* longest = front();
@@ -177,9 +302,17 @@ void Block::consensus(std::ostream& o, char gap) const {
         }
         longest->print_contents(o, /* gap */ '-', /* line */ 0);
     } else {
-        pos_t length = alignment_length();
+        AlignmentMatrix local;
+        const AlignmentMatrix* matrix = block_matrix(this, local);
+        pos_t length = matrix->columns();
         for (pos_t pos = 0; pos < length; pos++) {
-            o << consensus_char(pos, gap);
+            int freq[LETTERS_NUMBER];
+            for (int i = 0; i < LETTERS_NUMBER; i++) {
+                freq[i] = 0;
+            }
+            bool _;
+            matrix->test_column(pos, _, _, _, freq);
+            o << most_frequent(freq, gap);
         }
     }
 }
@@ -293,6 +426,38 @@ Block* Block::clone() const {
     return result;
 }
 
+int Block::share_rows() {
+    typedef boost::unordered_multimap<size_t, AlignmentRow*> Hash2Row;
+    typedef Hash2Row::const_iterator It;
+    Hash2Row hash2row;
+    std::vector<CAR_Bitset> bitsets;
+    int result = 0;
+    BOOST_FOREACH (Fragment* f, *this) {
+        AlignmentRow* row = f->row();
+        if (!row) {
+            continue;
+        }
+        bitsets.clear();
+        row->bitsets(bitsets);
+        size_t hash = boost::hash_range(bitsets.begin(), bitsets.end());
+        boost::hash_combine(hash, row->length());
+        std::pair<It, It> range = hash2row.equal_range(hash);
+        bool shared = false;
+        for (It it = range.first; it != range.second; ++it) {
+            if (row->share(*it->second)) {
+                shared = true;
+                break;
+            }
+        }
+        if (shared) {
+            result += 1;
+        } else {
+            hash2row.insert(std::make_pair(hash, row));
+        }
+    }
+    return result;
+}
+
 void Block::remove_alignment() {
     BOOST_FOREACH (Fragment* f, *this) {
         if (f->row()) {
@@ -314,6 +479,7 @@ void Block::merge(Block* other) {
     ASSERT_FALSE(other->weak());
     typedef std::map<Fragment, Fragment*> F2F;
     F2F f2f;
+    drop_matrix();
     std::vector<Fragment*> this_copy(begin(), end());
     BOOST_FOREACH (Fragment* f, this_copy) {
         if (f2f.find(*f) != f2f.end()) {
@@ -343,6 +509,7 @@ void Block::merge(Block* other) {
         }
     }
     other->fragments_.clear();
+    other->drop_matrix();
     BOOST_FOREACH (F2F::value_type& f_and_ptr, f2f) {
         Fragment* f = f_and_ptr.second;
         insert(f);
@@ -351,6 +518,11 @@ void Block::merge(Block* other) {
 
 void Block::set_name(const std::string& name) {
     name_ = name;
+    ++names_generation_;
+}
+
+long Block::names_generation() {
+    return names_generation_;
 }
 
 void Block::set_random_name() {
@@ -368,9 +540,11 @@ void Block::set_name_from_fragments() {
         name_[byte_index * 2 + 1] = NAME_ABC[byte & 0x0F];
     }
     name_[0] = 'b';
+    ++names_generation_;
 }
 
 void Block::set_weak(bool weak) {
+    drop_matrix();
     if (this->weak() && !weak) {
         BOOST_FOREACH (Fragment* fragment, *this) {
             ASSERT_TRUE(fragment->block());
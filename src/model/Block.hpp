@@ -59,6 +59,14 @@ public:
     */
     ~Block();
 
+    /** Allocate memory for block.
+    If NPGE_POOLS is set, memory is taken from FixedPool.
+    */
+    static void* operator new(size_t size);
+
+    /** Free memory of block */
+    static void operator delete(void* ptr, size_t size);
+
     /** Add fragment.
     If block is not weak or fragment is orphan,
     then fragment->block() is set to this block.
@@ -119,6 +127,38 @@ public:
     */
     Decimal identity() const;
 
+    /** Return cached matrix of letters of the block or 0.
+    The matrix is built on first call and kept until fragments
+    or alignment rows of the block change or drop_matrix()
+    is called, so the pointer is valid until then.
+    Can be called from several threads.
+    Returns 0 if the cache is disabled or the matrix does not
+    fit into the limit (see set_matrix_cache_limit()).
+    Weak blocks do not keep the matrix (changes of fragments
+    owned by other blocks are not tracked), so the matrix
+    must not be requested from weak blocks.
+    \see block_matrix()
+    */
+    const AlignmentMatrix* matrix() const;
+
+    /** Remove cached matrix.
+    Called by Fragment and AlignmentRow when they change
+    and by processors which only read blocks.
+    */
+    void drop_matrix() const;
+
+    /** Set maximum memory of cached matrices of all blocks (bytes).
+    Default value is 0, which disables the cache.
+    Matrices cached before are kept until dropped.
+    */
+    static void set_matrix_cache_limit(size_t bytes);
+
+    /** Return maximum memory of cached matrices of all blocks */
+    static size_t matrix_cache_limit();
+
+    /** Return memory of cached matrices of all blocks (bytes) */
+    static size_t matrix_cache_size();
+
     /** Return consensus letter for given position.
     For each column, the most frequent letter is written to consensus.
     If frequencies of several letters are equal, them some of them is written.
@@ -152,9 +192,18 @@ public:
     Block* slice(pos_t start, pos_t stop,
                  bool alignment = true) const;
 
-    /** Create copy of the block */
+    /** Create copy of the block.
+    Alignment rows of copies share storage with source rows
+    (see AlignmentRow::share()).
+    */
     Block* clone() const;
 
+    /** Make equal alignment rows of fragments share storage.
+    Return number of rows sharing storage with previous rows.
+    \see AlignmentRow::share()
+    */
+    int share_rows();
+
     /** Remove alignment rows of fragments */
     void remove_alignment();
 
@@ -179,6 +228,11 @@ public:
     /** Set block name */
     void set_name(const std::string& name);
 
+    /** Return number of renamings of blocks.
+    Is used by BlockSet to detect outdated index of names.
+    */
+    static long names_generation();
+
     /** Set random name */
     void set_random_name();
 
@@ -207,6 +261,7 @@ private:
     Impl fragments_;
     std::string name_;
     bool weak_;
+    mutable AlignmentMatrix* matrix_;
 };
 
 /** Streaming operator */
@@ -15,6 +15,8 @@
 #include <boost/tuple/tuple.hpp>
 #include <boost/tuple/tuple_comparison.hpp>
 #include <boost/thread/shared_mutex.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include "BlockSet.hpp"
 #include "read_block_set.hpp"
@@ -32,11 +34,68 @@ namespace npge {
 
 typedef std::map<std::string, SequencePtr> Name2Seq;
 typedef std::map<std::string, BSA> Name2BSA;
+typedef boost::unordered_map<const Block*, int> Block2Index;
+typedef boost::unordered_map<std::string, Block*> Name2Block;
+typedef boost::mutex Mutex;
+typedef boost::mutex::scoped_lock Lock;
+
+// value of names_generation_ if index of names was not built
+const long NO_NAMES = -1;
 
 struct BlockSet::I {
     BlockSet::Impl blocks_;
+    Block2Index indices_;
     std::set<SequencePtr> seqs_;
     Name2BSA bsas_;
+
+    // index of names, built by find_block()
+    Mutex names_mutex_;
+    Name2Block names_;
+    long names_generation_;
+    bool same_names_;
+
+    I():
+        names_generation_(NO_NAMES), same_names_(false) {
+    }
+
+    void reset_names() {
+        Name2Block().swap(names_);
+        names_generation_ = NO_NAMES;
+        same_names_ = false;
+    }
+
+    void add_name(Block* block) {
+        Block*& value = names_[block->name()];
+        if (value) {
+            same_names_ = true;
+        } else {
+            value = block;
+        }
+    }
+
+    void remove_name(Block* block) {
+        Name2Block::iterator it = names_.find(block->name());
+        if (it != names_.end() && it->second == block) {
+            if (same_names_) {
+                // other block with this name may exist
+                reset_names();
+            } else {
+                names_.erase(it);
+            }
+        }
+    }
+
+    /** Make index of names actual (under mutex) */
+    void update_names() {
+        long generation = Block::names_generation();
+        if (names_generation_ != generation) {
+            reset_names();
+            BOOST_FOREACH (Block* block, blocks_) {
+                add_name(block);
+            }
+            names_generation_ = generation;
+        }
+    }
 };
 
 BlockSet::BlockSet() {
@@ -72,9 +131,13 @@ std::string BlockSet::block_from_description(const std::string& description) {
 }
 
 void BlockSet::insert(Block* block) {
-    Impl& blocks = impl_->blocks_;
-    ASSERT_TRUE(blocks.find(block) == blocks.end());
-    blocks.insert(block);
+    bool added = impl_->indices_.insert(
+                     std::make_pair(block, size())).second;
+    ASSERT_TRUE(added);
+    impl_->blocks_.push_back(block);
+    if (impl_->names_generation_ != NO_NAMES) {
+        impl_->add_name(block);
+    }
 }
 
 void BlockSet::erase(Block* block) {
@@ -83,7 +146,22 @@ void BlockSet::erase(Block* block) {
 }
 
 void BlockSet::detach(Block* block) {
-    impl_->blocks_.erase(block);
+    Block2Index::iterator it = impl_->indices_.find(block);
+    if (it == impl_->indices_.end()) {
+        return;
+    }
+    int index = it->second;
+    impl_->indices_.erase(it);
+    Impl& blocks = impl_->blocks_;
+    Block* last = blocks.back();
+    if (last != block) {
+        blocks[index] = last;
+        impl_->indices_[last] = index;
+    }
+    blocks.pop_back();
+    if (impl_->names_generation_ != NO_NAMES) {
+        impl_->remove_name(block);
+    }
 }
 
 int BlockSet::size() const {
@@ -95,17 +173,25 @@ bool BlockSet::empty() const {
 }
 
 bool BlockSet::has(const Block* block) const {
-    Block* b = const_cast<Block*>(block);
-    return impl_->blocks_.find(b) != impl_->blocks_.end();
+    return impl_->indices_.find(block) != impl_->indices_.end();
 }
 
 Block* BlockSet::find_block(const std::string& name) const {
-    BOOST_FOREACH (Block* b, *this) {
-        if (b->name() == name) {
-            return b;
-        }
+    Lock lock(impl_->names_mutex_);
+    impl_->update_names();
+    Name2Block::const_iterator it = impl_->names_.find(name);
+    return (it == impl_->names_.end()) ? 0 : it->second;
+}
+
+Blocks BlockSet::find_blocks(const Strings& names) const {
+    Lock lock(impl_->names_mutex_);
+    impl_->update_names();
+    Blocks result;
+    BOOST_FOREACH (const std::string& name, names) {
+        Name2Block::const_iterator it = impl_->names_.find(name);
+        result.push_back((it == impl_->names_.end()) ? 0 : it->second);
     }
-    return 0;
+    return result;
 }
 
 void BlockSet::clear() {
@@ -119,6 +205,8 @@ void BlockSet::clear_blocks() {
         delete block;
     }
     impl_->blocks_.clear();
+    impl_->indices_.clear();
+    impl_->reset_names();
 }
 
 void BlockSet::clear_seqs() {
@@ -160,6 +248,9 @@ void BlockSet::clear_bsas() {
 
 void BlockSet::swap(BlockSet& other) {
     impl_->blocks_.swap(other.impl_->blocks_);
+    impl_->indices_.swap(other.impl_->indices_);
+    impl_->reset_names();
+    other.impl_->reset_names();
     impl_->seqs_.swap(other.impl_->seqs_);
     impl_->bsas_.swap(other.impl_->bsas_);
 }
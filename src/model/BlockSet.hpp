@@ -9,7 +9,6 @@
 #define NPGE_BLOCK_SET_HPP_
 
 #include <iosfwd>
-#include <set>
 #include <vector>
 #include <map>
 #include "boost-xtime.hpp"
@@ -21,13 +20,15 @@
 namespace npge {
 
 /** Container of blocks.
+Blocks are iterated in order of insertion; erasing a block
+moves the last block to its place.
 */
 class BlockSet : boost::noncopyable {
 public:
     /** Type of implementation container.
     Do not rely on ths type!
     */
-    typedef std::set < Block*, std::less<Block*> > Impl;
+    typedef std::vector<Block*> Impl;
 
     /** Iterator */
     typedef Impl::iterator iterator;
@@ -70,16 +71,19 @@ public:
 
     /** Add block.
     The same block can't be added twice.
+    Iterators are invalidated.
     */
     void insert(Block* block);
 
-    /** Remove fragment.
+    /** Remove block.
     The block is deleted.
+    Iterators are invalidated.
     */
     void erase(Block* block);
 
-    /** Remove fragment.
+    /** Remove block.
     The block is not deleted.
+    Iterators are invalidated.
     */
     void detach(Block* block);
 
@@ -92,9 +96,20 @@ public:
     /** Return if has the block */
     bool has(const Block* block) const;
 
-    /** Return a block of this name or 0 */
+    /** Return a block of this name or 0.
+    Index of names is built on first call and is updated
+    by insert() and erase(). Renaming of blocks (Block::set_name)
+    causes rebuilding of the index on next call.
+    This method is thread-safe.
+    */
     Block* find_block(const std::string& name) const;
 
+    /** Return blocks with these names.
+    Missing blocks are represented by 0.
+    \see find_block
+    */
+    Blocks find_blocks(const Strings& names) const;
+
     /** Remove all blocks and sequences.
     \see clear_blocks(), clear_seqs(), clear_bsas()
     */
@@ -6,6 +6,7 @@
  */
 
 #include <stdint.h>
+#include <vector>
 #include <sstream>
 #include <ostream>
 #include <algorithm>
@@ -19,6 +20,8 @@
 #include "convert_position.hpp"
 #include "throw_assert.hpp"
 #include "cast.hpp"
+#include "FixedPool.hpp"
+#include "config.hpp"
 
 namespace npge {
 
@@ -41,6 +44,33 @@ Fragment::Fragment(const Fragment& other):
     apply_coords(other);
 }
 
+#ifdef NPGE_POOLS
+// never deleted, since fragments may outlive static objects
+static FixedPool& fragments_pool() {
+    static FixedPool* pool = new FixedPool(sizeof(Fragment));
+    return *pool;
+}
+#endif
+
+void* Fragment::operator new(size_t size) {
+#ifdef NPGE_POOLS
+    if (size == sizeof(Fragment)) {
+        return fragments_pool().allocate();
+    }
+#endif
+    return ::operator new(size);
+}
+
+void Fragment::operator delete(void* ptr, size_t size) {
+#ifdef NPGE_POOLS
+    if (size == sizeof(Fragment)) {
+        fragments_pool().deallocate(ptr);
+        return;
+    }
+#endif
+    ::operator delete(ptr);
+}
+
 Fragment::~Fragment() {
     if (block_raw_ptr()) {
         Block* b = block_raw_ptr();
@@ -74,6 +104,7 @@ pos_t Fragment::alignment_length() const {
 
 void Fragment::set_ori(int ori, bool inverse_row) {
     ASSERT_TRUE(ori == 1 || ori == -1);
+    drop_block_matrix();
     if (inverse_row && ori == this->ori() * -1 && row()) {
         InversedRow* r = dynamic_cast<InversedRow*>(row());
         if (r) {
@@ -242,6 +273,46 @@ char Fragment::alignment_at(pos_t pos) const {
     return (pos >= 0 && pos < length()) ? raw_at(pos) : 0;
 }
 
+void Fragment::alignment_chars(pos_t start, pos_t stop, char* letters,
+                               pos_t* positions) const {
+    pos_t n = stop - start;
+    if (n <= 0) {
+        return;
+    }
+    std::vector<pos_t> tmp;
+    if (!positions) {
+        tmp.resize(n);
+        positions = &tmp[0];
+    }
+    if (row()) {
+        row()->fragment_positions(start, stop, positions);
+    } else {
+        for (pos_t i = 0; i < n; i++) {
+            positions[i] = start + i;
+        }
+    }
+    pos_t min_fp = length();
+    pos_t max_fp = -1;
+    for (pos_t i = 0; i < n; i++) {
+        pos_t fp = positions[i];
+        if (fp < 0 || fp >= length()) {
+            positions[i] = -1;
+        } else {
+            min_fp = std::min(min_fp, fp);
+            max_fp = std::max(max_fp, fp);
+        }
+    }
+    if (max_fp == -1) {
+        std::fill(letters, letters + n, '\0');
+        return;
+    }
+    std::string text = substr(min_fp, max_fp);
+    for (pos_t i = 0; i < n; i++) {
+        pos_t fp = positions[i];
+        letters[i] = (fp == -1) ? '\0' : text[fp - min_fp];
+    }
+}
+
 pos_t Fragment::common_positions(const Fragment& other) const {
     pos_t result = 0;
     if (seq() == other.seq()) {
@@ -307,6 +378,7 @@ Fragment& Fragment::operator=(const Fragment& other) {
 }
 
 AlignmentRow* Fragment::detach_row() {
+    drop_block_matrix();
     AlignmentRow* result = row_;
     if (row_) {
         row_->set_fragment(0);
@@ -316,6 +388,7 @@ AlignmentRow* Fragment::detach_row() {
 }
 
 void Fragment::set_row(AlignmentRow* row) {
+    drop_block_matrix();
     if (row_ && row_->fragment() && row != row_) {
         row_->set_fragment(0);
         delete row_;
@@ -346,17 +419,17 @@ void Fragment::print_contents(std::ostream& o, char gap, int line) const {
     if (row_ && gap) {
         pos_t row_length = row_->length();
         ASSERT_GTE(row_length, length());
+        std::vector<char> letters(row_length);
+        if (row_length) {
+            alignment_chars(0, row_length, &letters[0]);
+        }
         for (pos_t align_pos = 0; align_pos < row_length; align_pos++) {
             if (l >= line && line != 0) {
                 o << std::endl;
                 l = 0;
             }
-            pos_t fragment_pos = row_->map_to_fragment(align_pos);
-            if (fragment_pos == -1) {
-                o << gap;
-            } else {
-                o << raw_at(fragment_pos);
-            }
+            char c = letters[align_pos];
+            o << (c ? c : gap);
             l += 1;
         }
     } else {
@@ -385,6 +458,13 @@ Block* Fragment::block_raw_ptr() const {
     return (Block*)result;
 }
 
+void Fragment::drop_block_matrix() const {
+    Block* block = block_raw_ptr();
+    if (block) {
+        block->drop_matrix();
+    }
+}
+
 std::ostream& operator<<(std::ostream& o, const Fragment& f) {
     o << '>';
     f.print_header(o);
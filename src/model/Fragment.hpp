@@ -53,6 +53,14 @@ public:
     */
     ~Fragment();
 
+    /** Allocate memory for fragment.
+    If NPGE_POOLS is set, memory is taken from FixedPool.
+    */
+    static void* operator new(size_t size);
+
+    /** Free memory of fragment */
+    static void operator delete(void* ptr, size_t size);
+
     /** Get sequence */
     Sequence* seq() const {
         return seq_;
@@ -71,6 +79,7 @@ public:
     /** Set minimum position of sequence occupied by the fragment */
     void set_min_pos(pos_t min_pos) {
         min_pos_ = min_pos;
+        drop_block_matrix();
     }
 
     /** Get maximum position of sequence occupied by the fragment */
@@ -81,6 +90,7 @@ public:
     /** Set maximum position of sequence occupied by the fragment */
     void set_max_pos(pos_t max_pos) {
         max_pos_ = max_pos;
+        drop_block_matrix();
     }
 
     /** Get orientation (1 for forward, -1 for reverse) */
@@ -204,6 +214,17 @@ public:
     */
     char alignment_at(pos_t pos) const;
 
+    /** Write letters of columns [start, stop) of fragment row.
+    Element i of letters corresponds to column start + i.
+    Gaps and columns outside of the row are written as 0,
+    like alignment_at().
+    If positions != 0, positions in fragment are written
+    there (-1 for gaps).
+    The row is walked once and the sequence is read once.
+    */
+    void alignment_chars(pos_t start, pos_t stop, char* letters,
+                         pos_t* positions = 0) const;
+
     /** Return number of positions, occupied by both fragments */
     pos_t common_positions(const Fragment& other) const;
 
@@ -279,6 +300,9 @@ private:
 
     Block* block_raw_ptr() const;
 
+    // see Block::matrix()
+    void drop_block_matrix() const;
+
     friend class Block;
 };
 
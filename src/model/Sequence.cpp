@@ -8,6 +8,7 @@
 #include <cctype>
 #include <sstream>
 #include <vector>
+#include <map>
 #include <algorithm>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
@@ -16,6 +17,8 @@
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <boost/utility/binary.hpp>
+#include "boost-xtime.hpp"
+#include <boost/thread/mutex.hpp>
 
 #include "Sequence.hpp"
 #include "Block.hpp"
@@ -37,7 +40,8 @@
 namespace npge {
 
 Sequence::Sequence():
-    size_(0), block_(0) {
+    size_(0), genome_id_(0), chromosome_id_(0),
+    circular_(false), block_(0) {
 }
 
 SequencePtr Sequence::new_sequence(SequenceType seq_type) {
@@ -45,6 +49,10 @@ SequencePtr Sequence::new_sequence(SequenceType seq_type) {
         return boost::make_shared<InMemorySequence>();
     } else if (seq_type == COMPACT_LOW_N_SEQUENCE) {
         return boost::make_shared<CompactLowNSequence>();
+    } else if (seq_type == PACKED_SEQUENCE ||
+               seq_type == MAPPED_SEQUENCE) {
+        // MappedSequence is created by read_genome_index only
+        return boost::make_shared<PackedSequence>();
     } else {
         return boost::make_shared<CompactSequence>();
     }
@@ -178,6 +186,44 @@ void Sequence::to_atgcn(std::string& data) {
     data.resize(s - removed_count);
 }
 
+typedef boost::mutex Mutex;
+typedef boost::mutex::scoped_lock Lock;
+typedef std::map<std::string, int> Name2Id;
+
+/** Registry of genome or chromosome names */
+struct NameIds {
+    Mutex mutex_;
+    Name2Id ids_;
+
+    NameIds() {
+        // empty name
+        ids_[""] = 0;
+    }
+
+    int id(const std::string& name) {
+        Lock lock(mutex_);
+        Name2Id::iterator it = ids_.find(name);
+        if (it == ids_.end()) {
+            int id = ids_.size();
+            ids_[name] = id;
+            return id;
+        } else {
+            return it->second;
+        }
+    }
+};
+
+// never deleted, since sequences may outlive static objects
+static NameIds& genome_ids() {
+    static NameIds* ids = new NameIds;
+    return *ids;
+}
+
+static NameIds& chromosome_ids() {
+    static NameIds* ids = new NameIds;
+    return *ids;
+}
+
 void Sequence::set_name(const std::string& name) {
     if (name.find(' ') != std::string::npos) {
         throw Exception("Sequence name must not "
@@ -188,39 +234,24 @@ void Sequence::set_name(const std::string& name) {
                         "fragment name: " + name);
     }
     name_ = name;
+    parse_name();
 }
 
-std::string Sequence::genome() const {
+void Sequence::parse_name() {
     using namespace boost::algorithm;
     Strings parts;
     split(parts, name(), is_any_of("&"));
     if (parts.size() == 3 && (parts[2] == "c" || parts[2] == "l")) {
-        return parts[0];
+        genome_ = parts[0];
+        chromosome_ = parts[1];
+        circular_ = (parts[2] == "c");
     } else {
-        return "";
-    }
-}
-
-std::string Sequence::chromosome() const {
-    using namespace boost::algorithm;
-    Strings parts;
-    split(parts, name(), is_any_of("&"));
-    if (parts.size() == 3 && (parts[2] == "c" || parts[2] == "l")) {
-        return parts[1];
-    } else {
-        return "";
-    }
-}
-
-bool Sequence::circular() const {
-    using namespace boost::algorithm;
-    Strings parts;
-    split(parts, name(), is_any_of("&"));
-    if (parts.size() == 3 && (parts[2] == "c" || parts[2] == "l")) {
-        return parts[2] == "c";
-    } else {
-        return false;
+        genome_.clear();
+        chromosome_.clear();
+        circular_ = false;
     }
+    genome_id_ = genome_ids().id(genome_);
+    chromosome_id_ = chromosome_ids().id(chromosome_);
 }
 
 std::string Sequence::ac() const {
@@ -291,10 +322,63 @@ hash_t Sequence::hash_impl(pos_t index, pos_t length,
     ASSERT_LT(index + (length - 1) * ori, size());
     if (ori == 1) {
         typedef SChar<1> F;
-        return make_hash_base<F, 1>(F(index, this), length);
+        return make_hash_base<hash_t, F, 1>(F(index, this), length);
     } else {
         typedef SChar < -1 > F;
-        return make_hash_base < F, -1 > (F(index, this), length);
+        return make_hash_base < hash_t, F, -1 > (F(index, this),
+                length);
+    }
+}
+
+void Sequence::canonical_hashes(pos_t from, pos_t to, int k,
+                                hash_t* hashes,
+                                signed char* oris) const {
+    if (from >= to) {
+        return;
+    }
+    ASSERT_GTE(from, 0);
+    ASSERT_GTE(k, 1);
+    ASSERT_LTE(to + k - 1, size());
+    canonical_hashes_impl(from, to, k, hashes, oris);
+}
+
+static void write_canonical(hash_t dir, hash_t rev, bool has_n,
+                            hash_t& hash, signed char& ori) {
+    if (dir <= rev) {
+        hash = dir;
+        ori = has_n ? 0 : 1;
+    } else {
+        hash = rev;
+        ori = has_n ? 0 : -1;
+    }
+}
+
+void Sequence::canonical_hashes_impl(pos_t from, pos_t to, int k,
+                                     hash_t* hashes,
+                                     signed char* oris) const {
+    hash_t dir = hash_impl(from, k, 1);
+    hash_t rev = hash_impl(from + k - 1, k, -1);
+    int ns = 0;
+    for (pos_t i = from; i < from + k; i++) {
+        if (char_at_impl(i) == 'N') {
+            ns += 1;
+        }
+    }
+    pos_t n = to - from;
+    write_canonical(dir, rev, ns, hashes[0], oris[0]);
+    for (pos_t i = 1; i < n; i++) {
+        char remove_char = char_at_impl(from + i - 1);
+        char add_char = char_at_impl(from + i - 1 + k);
+        if (remove_char == 'N') {
+            ns -= 1;
+        }
+        if (add_char == 'N') {
+            ns += 1;
+        }
+        dir = reuse_hash(dir, k, remove_char, add_char, true);
+        rev = reuse_hash(rev, k, complement(remove_char),
+                         complement(add_char), false);
+        write_canonical(dir, rev, ns, hashes[i], oris[i]);
     }
 }
 
@@ -369,7 +453,11 @@ public:
     }
 
     void grow_sequence(const std::string& data) {
-        std::string line(data);
+        grow_sequence_view(data.c_str(), data.size());
+    }
+
+    void grow_sequence_view(const char* data, size_t size) {
+        std::string line(data, size);
         Sequence::to_atgcn(line);
         f_(line);
     }
@@ -595,6 +683,244 @@ size_t CompactLowNSequence::shift(size_t index) const {
     return 2 * (index % 4);
 }
 
+const int WORD_LETTERS = MAX_ANCHOR_SIZE;
+
+PackedSequence::PackedSequence():
+    data_(0), data_size_(0) {
+}
+
+PackedSequence::PackedSequence(const std::string& data):
+    data_(0), data_size_(0) {
+    read_from_string(data);
+}
+
+char PackedSequence::char_at_impl(pos_t index) const {
+    NRuns::const_iterator it = std::upper_bound(ns_.begin(),
+                               ns_.end(), NRun(index, MAX_POS));
+    if (it != ns_.begin()) {
+        --it;
+        if (index < it->second) {
+            return 'N';
+        }
+    }
+    hash_t word = data_[index / WORD_LETTERS];
+    size_t s = (word >> (POS_BITS * (index % WORD_LETTERS))) &
+               LAST_TWO_BITS;
+    return size_to_char(s);
+}
+
+void PackedSequence::read_from_file(std::istream& input) {
+    read_fasta(*this, input,
+               boost::bind(&PackedSequence::add_hunk, this, _1));
+}
+
+void PackedSequence::read_from_string(const std::string& data) {
+    std::string data_copy(data);
+    to_atgcn(data_copy);
+    add_hunk(data_copy);
+}
+
+void PackedSequence::map_from_string_impl(const std::string& data,
+        pos_t min_pos) {
+    reserve_words(min_pos + data.size());
+    remove_n_runs(min_pos, min_pos + data.size());
+    for (size_t i = 0; i < data.size(); i++) {
+        set_item(min_pos + i, data[i]);
+        if (data[i] == 'N') {
+            add_n_run(min_pos + i, min_pos + i + 1);
+        }
+    }
+}
+
+void PackedSequence::add_hunk(const std::string& hunk) {
+    if (hunk.empty()) {
+        return;
+    }
+    pos_t old_size = size();
+    pos_t new_size = old_size + hunk.size();
+    reserve_words(new_size);
+    for (size_t i = 0; i < hunk.size(); i++) {
+        set_item(old_size + i, hunk[i]);
+    }
+    size_t n_pos = hunk.find('N');
+    while (n_pos != std::string::npos) {
+        size_t n_end = hunk.find_first_not_of('N', n_pos);
+        if (n_end == std::string::npos) {
+            n_end = hunk.size();
+        }
+        add_n_run(old_size + n_pos, old_size + n_end);
+        n_pos = hunk.find('N', n_end);
+    }
+    set_size(new_size);
+}
+
+void PackedSequence::reserve_words(pos_t new_size) {
+    // one extra word to read k-mers crossing last word
+    size_t words = (new_size + WORD_LETTERS - 1) / WORD_LETTERS + 1;
+    if (words > words_.size()) {
+        words_.resize(words, 0);
+        set_words(&words_[0], words_.size());
+    }
+}
+
+void PackedSequence::set_words(const hash_t* words,
+                               size_t words_size) {
+    data_ = words;
+    data_size_ = words_size;
+}
+
+void PackedSequence::set_item(pos_t index, char value) {
+    hash_t& word = words_[index / WORD_LETTERS];
+    size_t shift = POS_BITS * (index % WORD_LETTERS);
+    word &= ~(LAST_TWO_BITS << shift);
+    hash_t s = char_to_size(value) & LAST_TWO_BITS;
+    word |= s << shift;
+}
+
+void PackedSequence::add_n_run(pos_t first, pos_t last) {
+    if (first >= last) {
+        return;
+    }
+    if (ns_.empty() || ns_.back().second < first) {
+        ns_.push_back(NRun(first, last));
+        return;
+    }
+    if (ns_.back().first <= first) {
+        ns_.back().second = std::max(ns_.back().second, last);
+        return;
+    }
+    // general case: merge all runs touching [first, last)
+    NRuns result;
+    result.reserve(ns_.size() + 1);
+    NRun added(first, last);
+    bool inserted = false;
+    BOOST_FOREACH (const NRun& run, ns_) {
+        if (run.second < added.first) {
+            result.push_back(run);
+        } else if (run.first > added.second) {
+            if (!inserted) {
+                result.push_back(added);
+                inserted = true;
+            }
+            result.push_back(run);
+        } else {
+            added.first = std::min(added.first, run.first);
+            added.second = std::max(added.second, run.second);
+        }
+    }
+    if (!inserted) {
+        result.push_back(added);
+    }
+    ns_.swap(result);
+}
+
+void PackedSequence::remove_n_runs(pos_t first, pos_t last) {
+    NRuns result;
+    result.reserve(ns_.size() + 1);
+    BOOST_FOREACH (const NRun& run, ns_) {
+        if (run.second <= first || run.first >= last) {
+            result.push_back(run);
+        } else {
+            if (run.first < first) {
+                result.push_back(NRun(run.first, first));
+            }
+            if (run.second > last) {
+                result.push_back(NRun(last, run.second));
+            }
+        }
+    }
+    ns_.swap(result);
+}
+
+struct NRunEndLess {
+    bool operator()(pos_t pos, const std::pair<pos_t, pos_t>& run) const {
+        return pos < run.second;
+    }
+};
+
+bool PackedSequence::has_n(pos_t first, pos_t last) const {
+    // first run ending after first
+    NRuns::const_iterator it = std::upper_bound(ns_.begin(),
+                               ns_.end(), first, NRunEndLess());
+    return it != ns_.end() && it->first < last;
+}
+
+hash_t PackedSequence::extract(pos_t index, int k) const {
+    size_t bit = size_t(index) * POS_BITS;
+    size_t w = bit / (sizeof(hash_t) * BYTE_BITS);
+    size_t offset = bit % (sizeof(hash_t) * BYTE_BITS);
+    hash_t result = data_[w] >> offset;
+    if (offset) {
+        result |= data_[w + 1] << (sizeof(hash_t) * BYTE_BITS - offset);
+    }
+    if (k < WORD_LETTERS) {
+        result &= (hash_t(1) << (POS_BITS * k)) - 1;
+    }
+    return result;
+}
+
+hash_t PackedSequence::hash_impl(pos_t index, pos_t length,
+                                 int ori) const {
+    pos_t min_pos = (ori == 1) ? index : (index - length + 1);
+    if (length > WORD_LETTERS || min_pos < 0 ||
+            min_pos + length > size() ||
+            has_n(min_pos, min_pos + length)) {
+        return Sequence::hash_impl(index, length, ori);
+    }
+    hash_t dir = extract(min_pos, length);
+    return (ori == 1) ? dir : complement_short_hash(dir, length);
+}
+
+void PackedSequence::canonical_hashes_impl(pos_t from, pos_t to,
+        int k, hash_t* hashes, signed char* oris) const {
+    if (k > WORD_LETTERS) {
+        Sequence::canonical_hashes_impl(from, to, k, hashes, oris);
+        return;
+    }
+    pos_t n = to - from;
+    // no data dependencies between iterations
+    for (pos_t i = 0; i < n; i++) {
+        hash_t dir = extract(from + i, k);
+        hash_t rev = complement_short_hash(dir, k);
+        bool direct = (dir <= rev);
+        hashes[i] = direct ? dir : rev;
+        oris[i] = direct ? 1 : -1;
+    }
+    // k-mers overlapping runs of N
+    NRuns::const_iterator it = std::upper_bound(ns_.begin(),
+                               ns_.end(), from, NRunEndLess());
+    for (; it != ns_.end() && it->first < to + k - 1; ++it) {
+        pos_t first = std::max(from, it->first - k + 1);
+        pos_t last = std::min(to, it->second);
+        for (pos_t p = first; p < last; p++) {
+            oris[p - from] = 0;
+        }
+    }
+}
+
+MappedSequence::MappedSequence(boost::shared_ptr<void> mapping,
+                               const hash_t* words,
+                               size_t words_size,
+                               pos_t size, const NRuns& ns):
+    mapping_(mapping) {
+    set_words(words, words_size);
+    set_size(size);
+    ns_ = ns;
+}
+
+void MappedSequence::read_from_string(const std::string&) {
+    throw Exception("Trying to modify MappedSequence");
+}
+
+void MappedSequence::map_from_string_impl(const std::string&,
+        pos_t) {
+    throw Exception("Trying to modify MappedSequence");
+}
+
+void MappedSequence::read_from_file(std::istream&) {
+    throw Exception("Trying to modify MappedSequence");
+}
+
 DummySequence::DummySequence(char letter, int size) {
     set_letter(letter);
     set_size(size);
@@ -90,21 +90,45 @@ public:
     /** Return name of genome, if can be deduced from name().
     Format: genome&chromosome&circular.
     Empty string is returned if name format is wrong.
+    Genome, chromosome and circularity are parsed by set_name().
     */
-    std::string genome() const;
+    const std::string& genome() const {
+        return genome_;
+    }
 
     /** Return name of chromosome, if can be deduced from name().
     Format: genome&chromosome&circular.
     Empty string is returned if name format is not accepted.
     */
-    std::string chromosome() const;
+    const std::string& chromosome() const {
+        return chromosome_;
+    }
 
     /** Return if the contig is circular (deduced from name).
     Format: genome&chromosome&circular.
     Circular = c (for circular) or l (for linear).
     Return linear if format is wrong.
     */
-    bool circular() const;
+    bool circular() const {
+        return circular_;
+    }
+
+    /** Return integer identifier of genome().
+    Sequences have same genome_id() if and only if they
+    have same genome(). Identifiers are small non-negative
+    numbers, shared by all sequences of the program.
+    Empty genome has identifier 0.
+    */
+    int genome_id() const {
+        return genome_id_;
+    }
+
+    /** Return integer identifier of chromosome().
+    \see genome_id()
+    */
+    int chromosome_id() const {
+        return chromosome_id_;
+    }
 
     /** Return accession number of the sequence.
     Accession number is set if description contains "ac=XXXX".
@@ -139,6 +163,23 @@ public:
     hash_t hash(pos_t index, pos_t length,
                 int ori) const;
 
+    /** Write canonical hashes of k-mers starting at [from, to).
+    For each k-mer, min(direct hash, reverse hash) is written
+    to hashes and the orientation of the minimum (1 or -1)
+    is written to oris. If direct hash == reverse hash, ori is 1.
+    K-mers containing 'N' have ori 0 and undefined hash.
+    Hashes are equal to Fragment::hash() of corresponding fragments.
+    \param from Start position of first k-mer.
+    \param to Start position of the k-mer after last one
+        (to + k - 1 <= size()).
+    \param k Length of k-mer.
+    \param hashes Output buffer of size (to - from).
+    \param oris Output buffer of size (to - from).
+    */
+    void canonical_hashes(pos_t from, pos_t to, int k,
+                          hash_t* hashes,
+                          signed char* oris) const;
+
 protected:
     virtual char char_at_impl(pos_t index) const = 0;
 
@@ -151,12 +192,24 @@ protected:
     virtual hash_t hash_impl(pos_t index, pos_t length,
                              int ori) const;
 
+    /** Default implementation uses rolling hash over char_at_impl */
+    virtual void canonical_hashes_impl(pos_t from, pos_t to, int k,
+                                       hash_t* hashes,
+                                       signed char* oris) const;
+
 private:
     pos_t size_;
     std::string name_;
     std::string description_;
+    std::string genome_;
+    std::string chromosome_;
+    int genome_id_;
+    int chromosome_id_;
+    bool circular_;
     const Block* block_;
 
+    void parse_name();
+
     friend class Fragment;
     template<int ori>
     friend class SChar;
@@ -252,6 +305,118 @@ private:
     size_t shift(size_t index) const;
 };
 
+/** Sequence storing 2 bits per letter in 64-bit words.
+Runs of 'N' are stored separately as sorted list of intervals.
+Hashes of k-mers (k <= MAX_ANCHOR_SIZE) are extracted
+from words directly, without per-letter calls.
+*/
+class PackedSequence : public Sequence {
+public:
+    /** Run of 'N' letters, [first, second) */
+    typedef std::pair<pos_t, pos_t> NRun;
+
+    /** Sorted list of runs of 'N' letters */
+    typedef std::vector<NRun> NRuns;
+
+    PackedSequence();
+
+    PackedSequence(const std::string& data);
+
+    void read_from_string(const std::string& data);
+
+    /** Return packed letters.
+    Letter i is stored in bits 2 * (i % 32) of word i / 32.
+    'N' is stored as 'A' and is listed in n_runs().
+    */
+    const hash_t* words() const {
+        return data_;
+    }
+
+    /** Return number of elements in words().
+    Includes one padding word after last letter.
+    */
+    size_t words_size() const {
+        return data_size_;
+    }
+
+    /** Return runs of 'N' letters */
+    const NRuns& n_runs() const {
+        return ns_;
+    }
+
+protected:
+    char char_at_impl(pos_t index) const;
+
+    void map_from_string_impl(const std::string& data,
+                              pos_t min_pos);
+
+    hash_t hash_impl(pos_t index, pos_t length,
+                     int ori) const;
+
+    void canonical_hashes_impl(pos_t from, pos_t to, int k,
+                               hash_t* hashes,
+                               signed char* oris) const;
+
+    /** Use external storage of letters (read-only) */
+    void set_words(const hash_t* words, size_t words_size);
+
+    NRuns ns_;
+
+private:
+    typedef std::vector<hash_t> Words;
+
+    Words words_;
+    const hash_t* data_;
+    size_t data_size_;
+
+    void read_from_file(std::istream& input);
+
+    void add_hunk(const std::string& hunk);
+
+    void reserve_words(pos_t new_size);
+
+    void set_item(pos_t index, char value);
+
+    void add_n_run(pos_t first, pos_t last);
+
+    void remove_n_runs(pos_t first, pos_t last);
+
+    bool has_n(pos_t first, pos_t last) const;
+
+    hash_t extract(pos_t index, int k) const;
+};
+
+/** PackedSequence reading letters from memory-mapped file.
+Letters are paged in by operating system on first access.
+Several processes reading one file share one copy of pages.
+Read-only.
+\see read_genome_index
+*/
+class MappedSequence : public PackedSequence {
+public:
+    /** Constructor.
+    \param mapping Object keeping memory mapping alive.
+    \param words Packed letters (see PackedSequence::words()).
+    \param words_size Number of elements in words.
+    \param size Number of letters.
+    \param ns Runs of 'N' letters.
+    */
+    MappedSequence(boost::shared_ptr<void> mapping,
+                   const hash_t* words, size_t words_size,
+                   pos_t size, const NRuns& ns);
+
+    void read_from_string(const std::string& data);
+
+protected:
+    void map_from_string_impl(const std::string& data,
+                              pos_t min_pos);
+
+private:
+    boost::shared_ptr<void> mapping_;
+
+    void read_from_file(std::istream& input);
+};
+
 /** Sequence returning the one letter for each position.
 This utility sequence can be used to use in place of long
 sequences without large memory allocations.
@@ -6,12 +6,13 @@
  */
 
 #include <climits>
+#include <algorithm>
 #include <vector>
 #include <set>
+#include <bitset>
 #include <string>
 #include <boost/cast.hpp>
 #include <boost/foreach.hpp>
-#include <boost/algorithm/string/join.hpp>
 
 #include "block_hash.hpp"
 #include "Sequence.hpp"
@@ -20,57 +21,56 @@
 #include "Block.hpp"
 #include "BlockSet.hpp"
 #include "thread_pool.hpp"
+#include "make_hash.hpp"
 #include "throw_assert.hpp"
 #include "cast.hpp"
 #include "global.hpp"
 
 namespace npge {
 
+// FNV-1a
+static hash_t name_hash(const std::string& name) {
+    hash_t result = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < name.size(); i++) {
+        result ^= hash_t((unsigned char)(name[i]));
+        result *= 0x100000001b3ULL;
+    }
+    return result;
+}
+
+static hash_t fragment_hash(hash_t seq_hash, const Fragment* f,
+                            int ori) {
+    hash_t result = mix_hash(seq_hash ^ hash_t(f->min_pos()));
+    hash_t max_and_ori = (hash_t(f->max_pos()) << 1) | (ori == 1);
+    return mix_hash(result ^ max_and_ori);
+}
+
 hash_t block_hash(const Block* block) {
-    Strings ids_dir, ids_inv;
-    BOOST_FOREACH (Fragment* f, *block) {
-        ids_dir.push_back(f->id());
-        f->inverse(/* inverse_row */ false);
-        ids_inv.push_back(f->id());
-        f->inverse(/* inverse_row */ false);
-    }
-    std::sort(ids_dir.begin(), ids_dir.end());
-    std::sort(ids_inv.begin(), ids_inv.end());
-    Strings& ids = (ids_dir < ids_inv) ? ids_dir : ids_inv;
-    std::string joint = boost::algorithm::join(ids, " ");
-    const int LOOP_SIZE = sizeof(hash_t) * 2;
-    // 2 = for * and for ^
-    int new_size = ((joint.size() + LOOP_SIZE - 1) / LOOP_SIZE)
-                   * LOOP_SIZE;
-    joint.resize(new_size, ' ');
-    const char* c = joint.c_str();
-    const hash_t* value = reinterpret_cast<const hash_t*>(c);
-    int loops = joint.size() / LOOP_SIZE;
-    hash_t a = 1;
-    for (int i = 0; i < loops; i++) {
-        a *= value[2 * i];
-        a ^= value[2 * i + 1];
-    }
-    return a;
-}
-
-class HashTask;
-class HashWorker;
-class HashGroup;
+    // sums do not depend on order of fragments
+    hash_t sum_dir = 0, sum_inv = 0;
+    BOOST_FOREACH (const Fragment* f, *block) {
+        hash_t seq_hash = f->seq() ? name_hash(f->seq()->name()) : 0;
+        sum_dir += fragment_hash(seq_hash, f, f->ori());
+        sum_inv += fragment_hash(seq_hash, f, -f->ori());
+    }
+    return mix_hash(std::min(sum_dir, sum_inv));
+}
+
+// number of blocks hashed by one task
+const int HASH_TASK_BLOCKS = 256;
 
 class HashGroup : public ReusingThreadGroup {
 public:
     HashGroup(const BlockSet& block_set):
-        it_(block_set.begin()),
-        end_(block_set.end()), hash_(0) {
+        block_set_(block_set), next_(0), hash_(0) {
     }
 
     ThreadTask* create_task_impl(ThreadWorker* worker);
 
     ThreadWorker* create_worker_impl();
 
-    BlockSet::const_iterator it_;
-    BlockSet::const_iterator end_;
+    const BlockSet& block_set_;
+    int next_;
 
     hash_t hash_;
 };
@@ -89,32 +89,45 @@ public:
     hash_t hash_;
 };
 
+static hash_t blocks_hash(BlockSet::const_iterator begin,
+                          BlockSet::const_iterator end) {
+    hash_t result = 0;
+    for (BlockSet::const_iterator it = begin; it != end; ++it) {
+        const Block* block = *it;
+        if (block->size() > 1) {
+            result ^= block_hash(block);
+        }
+    }
+    return result;
+}
+
 class HashTask : public ThreadTask {
 public:
-    HashTask(const Block* block, HashWorker* worker):
-        ThreadTask(worker), block_(block) {
+    HashTask(int begin, int end, HashWorker* worker):
+        ThreadTask(worker), begin_(begin), end_(end) {
     }
 
     void run_impl() {
         HashWorker* w = D_CAST<HashWorker*>(worker());
-        w->hash_ ^= block_hash(block_);
+        HashGroup* g = D_CAST<HashGroup*>(thread_group());
+        BlockSet::const_iterator begin = g->block_set_.begin();
+        w->hash_ ^= blocks_hash(begin + begin_, begin + end_);
     }
 
 private:
-    const Block* block_;
+    int begin_;
+    int end_;
 };
 
 ThreadTask* HashGroup::create_task_impl(ThreadWorker* worker) {
-    while (it_ != end_ && (*it_)->size() <= 1) {
-        it_++;
-    }
-    if (it_ == end_) {
+    int size = block_set_.size();
+    if (next_ >= size) {
         return 0;
     } else {
         HashWorker* w = D_CAST<HashWorker*>(worker);
-        HashTask* task = new HashTask(*it_, w);
-        it_++;
-        return task;
+        int begin = next_;
+        next_ = std::min(size, next_ + HASH_TASK_BLOCKS);
+        return new HashTask(begin, next_, w);
     }
 }
 
@@ -123,6 +136,9 @@ ThreadWorker* HashGroup::create_worker_impl() {
 }
 
 hash_t blockset_hash(const BlockSet& block_set, int workers) {
+    if (workers == 1 || block_set.size() <= HASH_TASK_BLOCKS) {
+        return blocks_hash(block_set.begin(), block_set.end());
+    }
     HashGroup hash_group((block_set));
     hash_group.set_workers(workers);
     hash_group.perform();
@@ -134,17 +150,48 @@ std::string block_id(const Block* block) {
            TO_S(block->alignment_length());
 }
 
-typedef std::set<std::string> StringSet;
+/** Set of genome ids (Sequence::genome_id()).
+Small ids are stored in bitset, so usual sets do not allocate memory.
+*/
+class GenomeIds {
+public:
+    GenomeIds():
+        size_(0) {
+    }
+
+    /** Add genome id, return false if it was already added */
+    bool insert(int id) {
+        if (id < SMALL_IDS) {
+            if (small_[id]) {
+                return false;
+            }
+            small_[id] = true;
+            size_ += 1;
+            return true;
+        } else {
+            bool result = large_.insert(id).second;
+            size_ += result;
+            return result;
+        }
+    }
+
+    /** Return number of genomes */
+    int size() const {
+        return size_;
+    }
+
+private:
+    static const int SMALL_IDS = 1024;
+    std::bitset<SMALL_IDS> small_;
+    std::set<int> large_;
+    int size_;
+};
 
 bool has_repeats(const Block* block) {
-    StringSet genomes;
+    GenomeIds genomes;
     BOOST_FOREACH (Fragment* f, *block) {
-        if (f->seq()) {
-            std::string genome = f->seq()->genome();
-            if (genomes.find(genome) != genomes.end()) {
-                return true;
-            }
-            genomes.insert(genome);
+        if (f->seq() && !genomes.insert(f->seq()->genome_id())) {
+            return true;
         }
     }
     return false;
@@ -155,9 +202,9 @@ bool is_exact_stem(const Block* block, int genomes) {
 }
 
 int genomes_number(const BlockSet& block_set) {
-    StringSet all_genomes;
+    GenomeIds all_genomes;
     BOOST_FOREACH (const SequencePtr& seq, block_set.seqs()) {
-        all_genomes.insert(seq->genome());
+        all_genomes.insert(seq->genome_id());
     }
     return all_genomes.size();
 }
@@ -13,15 +13,17 @@
 namespace npge {
 
 /** Return hash of block.
-Fragment::id() (i.e., sequence names, fragment positions and ori)
-affects hash value.
+Sequence names, fragment positions and ori affect hash value.
 Alignment and order of fragments does not.
+Inversed block has same hash.
+The hash is computed without memory allocation.
 */
 hash_t block_hash(const Block* block);
 
-/** Return hash of block.
+/** Return hash of blockset.
 Hashes of blocks of blockset are XOR'ed.
 Blocks of <=1 fragment are skipped.
+Blocks are hashed by groups in several threads.
 */
 hash_t blockset_hash(const BlockSet& block_set,
                      int workers = 1);
@@ -0,0 +1,367 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+#include <boost/foreach.hpp>
+
+#include "block_set_binary.hpp"
+#include "BlockSet.hpp"
+#include "Block.hpp"
+#include "Fragment.hpp"
+#include "Sequence.hpp"
+#include "AlignmentRow.hpp"
+#include "block_set_alignment.hpp"
+#include "Exception.hpp"
+#include "cast.hpp"
+
+namespace npge {
+
+// File layout (numbers are uint64_t, native byte order):
+//  - magic, byte order mark, version;
+//  - number of sequences, sequences: name, description,
+//    size, letters;
+//  - number of blocks, blocks: name, number of fragments,
+//    fragments: sequence index, min_pos, max_pos, ori,
+//    row length (NO_ROW if no row), number of bitsets,
+//    bitsets (CAR_Bitset);
+//  - number of bsas, bsas: name, number of rows,
+//    rows: sequence index, ori, length, fragment indices
+//    (NO_FRAGMENT for gap).
+// Strings are stored as length and characters.
+// Fragments are numbered in order of writing.
+
+static const char MAGIC[] = "\x89NPGEBSB";
+static const uint64_t BYTE_ORDER_MARK = 0x0102030405060708ULL;
+static const uint64_t VERSION = 1;
+static const uint64_t NO_ROW = ~uint64_t(0);
+static const uint64_t NO_FRAGMENT = ~uint64_t(0);
+
+bool is_block_set_binary(std::istream& input) {
+    return input.peek() == static_cast<unsigned char>(MAGIC[0]);
+}
+
+static void write_number(std::ostream& out, uint64_t number) {
+    out.write(reinterpret_cast<const char*>(&number),
+              sizeof(number));
+}
+
+static void write_string(std::ostream& out, const std::string& text) {
+    write_number(out, text.size());
+    out.write(text.c_str(), text.size());
+}
+
+typedef std::map<const Sequence*, uint64_t> Seq2Index;
+typedef std::map<const Fragment*, uint64_t> Fragment2Index;
+
+static void write_sequence(std::ostream& out, const Sequence& seq) {
+    write_string(out, seq.name());
+    write_string(out, seq.description());
+    write_number(out, seq.size());
+    std::string letters = seq.contents();
+    out.write(letters.c_str(), letters.size());
+}
+
+static void write_fragment(std::ostream& out, const Fragment& f,
+                           const Seq2Index& seq2index) {
+    Seq2Index::const_iterator it = seq2index.find(f.seq());
+    write_number(out, it->second);
+    write_number(out, f.min_pos());
+    write_number(out, f.max_pos());
+    write_number(out, f.ori());
+    const AlignmentRow* row = f.row();
+    if (row) {
+        write_number(out, row->length());
+        std::vector<CAR_Bitset> bitsets;
+        row->bitsets(bitsets);
+        write_number(out, bitsets.size());
+        if (!bitsets.empty()) {
+            out.write(reinterpret_cast<const char*>(&bitsets[0]),
+                      sizeof(CAR_Bitset) * bitsets.size());
+        }
+    } else {
+        write_number(out, NO_ROW);
+    }
+}
+
+void write_block_set_binary(const BlockSet& block_set,
+                            std::ostream& out) {
+    // sequences of blockset and of fragments
+    std::vector<const Sequence*> seqs;
+    Seq2Index seq2index;
+    BOOST_FOREACH (const SequencePtr& seq, block_set.seqs()) {
+        if (seq2index.find(seq.get()) == seq2index.end()) {
+            seq2index[seq.get()] = seqs.size();
+            seqs.push_back(seq.get());
+        }
+    }
+    BOOST_FOREACH (const Block* block, block_set) {
+        BOOST_FOREACH (const Fragment* f, *block) {
+            if (seq2index.find(f->seq()) == seq2index.end()) {
+                seq2index[f->seq()] = seqs.size();
+                seqs.push_back(f->seq());
+            }
+        }
+    }
+    out.write(MAGIC, sizeof(MAGIC) - 1);
+    write_number(out, BYTE_ORDER_MARK);
+    write_number(out, VERSION);
+    write_number(out, seqs.size());
+    BOOST_FOREACH (const Sequence* seq, seqs) {
+        write_sequence(out, *seq);
+    }
+    Fragment2Index fragment2index;
+    write_number(out, block_set.size());
+    BOOST_FOREACH (const Block* block, block_set) {
+        write_string(out, block->name());
+        write_number(out, block->size());
+        BOOST_FOREACH (const Fragment* f, *block) {
+            uint64_t index = fragment2index.size();
+            fragment2index[f] = index;
+            write_fragment(out, *f, seq2index);
+        }
+    }
+    Strings bsas = block_set.bsas();
+    write_number(out, bsas.size());
+    BOOST_FOREACH (const std::string& bsa_name, bsas) {
+        const BSA& bsa = block_set.bsa(bsa_name);
+        write_string(out, bsa_name);
+        write_number(out, bsa.size());
+        BOOST_FOREACH (const BSA::value_type& seq_and_row, bsa) {
+            const BSRow& row = seq_and_row.second;
+            Seq2Index::const_iterator it =
+                seq2index.find(seq_and_row.first);
+            if (it == seq2index.end()) {
+                throw Exception("Sequence of blockset alignment " +
+                                bsa_name + " is not in blockset");
+            }
+            write_number(out, it->second);
+            write_number(out, row.ori);
+            write_number(out, row.fragments.size());
+            BOOST_FOREACH (const Fragment* f, row.fragments) {
+                Fragment2Index::const_iterator it2 =
+                    fragment2index.find(f);
+                if (f && it2 == fragment2index.end()) {
+                    throw Exception("Fragment of blockset alignment " +
+                                    bsa_name + " is not in blockset");
+                }
+                write_number(out, f ? it2->second : NO_FRAGMENT);
+            }
+        }
+    }
+    if (!out) {
+        throw Exception("Error writing binary blockset");
+    }
+}
+
+static void broken() {
+    throw Exception("Broken binary blockset");
+}
+
+static uint64_t read_number(std::istream& input) {
+    uint64_t number;
+    if (!input.read(reinterpret_cast<char*>(&number), sizeof(number))) {
+        broken();
+    }
+    return number;
+}
+
+static void read_chars(std::istream& input, std::string& text,
+                       uint64_t size) {
+    const uint64_t BUFFER = 1024 * 1024;
+    text.clear();
+    while (size > 0) {
+        // do not allocate much memory for broken size
+        uint64_t chunk = std::min(size, BUFFER);
+        size_t old_size = text.size();
+        text.resize(old_size + chunk);
+        if (!input.read(&text[old_size], chunk)) {
+            broken();
+        }
+        size -= chunk;
+    }
+}
+
+static std::string read_string(std::istream& input) {
+    std::string text;
+    read_chars(input, text, read_number(input));
+    return text;
+}
+
+static int64_t read_signed(std::istream& input) {
+    return static_cast<int64_t>(read_number(input));
+}
+
+static int popcount(CAR_Bitset bitset) {
+    int result = 0;
+    while (bitset) {
+        bitset &= bitset - 1;
+        result += 1;
+    }
+    return result;
+}
+
+/** Return if bitsets of row match the fragment.
+Number of set bits must be equal to fragment length,
+no bit must be set at position >= row length.
+*/
+static bool valid_bitsets(const std::vector<CAR_Bitset>& bitsets,
+                          uint64_t length, uint64_t fragment_length) {
+    uint64_t letters = 0;
+    for (uint64_t i = 0; i < bitsets.size(); i++) {
+        CAR_Bitset bitset = bitsets[i];
+        uint64_t first_column = i * BITS_IN_CHUNK;
+        if (first_column + BITS_IN_CHUNK > length) {
+            // columns after the end of row
+            uint64_t valid = length - first_column;
+            bitset &= (CAR_Bitset(1) << valid) - 1;
+            if (bitset != bitsets[i]) {
+                return false;
+            }
+        }
+        letters += popcount(bitset);
+    }
+    return letters == fragment_length;
+}
+
+typedef std::map<std::string, SequencePtr> Name2Seq;
+
+static SequencePtr read_sequence(std::istream& input,
+                                 BlockSet& block_set,
+                                 const Name2Seq& name2seq,
+                                 SequenceType seq_type) {
+    std::string name = read_string(input);
+    std::string description = read_string(input);
+    uint64_t size = read_number(input);
+    Name2Seq::const_iterator it = name2seq.find(name);
+    if (it != name2seq.end() && it->second->size() == size) {
+        if (!input.ignore(size)) {
+            broken();
+        }
+        return it->second;
+    }
+    std::string letters;
+    read_chars(input, letters, size);
+    SequencePtr seq = Sequence::new_sequence(seq_type);
+    seq->read_from_string(letters);
+    seq->set_name(name);
+    seq->set_description(description);
+    block_set.add_sequence(seq);
+    return seq;
+}
+
+static Fragment* read_fragment(std::istream& input,
+                               const std::vector<SequencePtr>& seqs,
+                               RowType row_type) {
+    uint64_t seq_index = read_number(input);
+    int64_t min_pos = read_signed(input);
+    int64_t max_pos = read_signed(input);
+    int64_t ori = read_signed(input);
+    if (seq_index >= seqs.size()) {
+        broken();
+    }
+    const SequencePtr& seq = seqs[seq_index];
+    if (min_pos < 0 || min_pos > max_pos ||
+            max_pos >= int64_t(seq->size()) ||
+            (ori != 1 && ori != -1)) {
+        broken();
+    }
+    Fragment* f = new Fragment(seq.get(), min_pos, max_pos, ori);
+    uint64_t length = read_number(input);
+    if (length != NO_ROW) {
+        uint64_t bitsets_size = read_number(input);
+        if (bitsets_size > (length + BITS_IN_CHUNK - 1) / BITS_IN_CHUNK) {
+            delete f;
+            broken();
+        }
+        std::vector<CAR_Bitset> bitsets(bitsets_size);
+        if (bitsets_size &&
+                !input.read(reinterpret_cast<char*>(&bitsets[0]),
+                            sizeof(CAR_Bitset) * bitsets_size)) {
+            delete f;
+            broken();
+        }
+        if (!valid_bitsets(bitsets, length, max_pos - min_pos + 1)) {
+            delete f;
+            broken();
+        }
+        AlignmentRow* row = AlignmentRow::new_row(row_type);
+        row->set_bitsets(bitsets, length);
+        f->set_row(row);
+    }
+    return f;
+}
+
+void read_block_set_binary(BlockSet& block_set, std::istream& input,
+                           RowType row_type, SequenceType seq_type) {
+    std::string magic;
+    read_chars(input, magic, sizeof(MAGIC) - 1);
+    if (magic != MAGIC) {
+        throw Exception("Not a binary blockset");
+    }
+    if (read_number(input) != BYTE_ORDER_MARK) {
+        throw Exception("Wrong byte order of binary blockset");
+    }
+    uint64_t version = read_number(input);
+    if (version != VERSION) {
+        throw Exception("Unsupported version of binary blockset: " +
+                        TO_S(version));
+    }
+    Name2Seq name2seq;
+    BOOST_FOREACH (const SequencePtr& seq, block_set.seqs()) {
+        name2seq[seq->name()] = seq;
+    }
+    std::vector<SequencePtr> seqs;
+    uint64_t seqs_number = read_number(input);
+    for (uint64_t i = 0; i < seqs_number; i++) {
+        seqs.push_back(read_sequence(input, block_set,
+                                     name2seq, seq_type));
+    }
+    Fragments fragments;
+    uint64_t blocks_number = read_number(input);
+    for (uint64_t i = 0; i < blocks_number; i++) {
+        Block* block = new Block(read_string(input));
+        block_set.insert(block);
+        uint64_t block_size = read_number(input);
+        for (uint64_t j = 0; j < block_size; j++) {
+            Fragment* f = read_fragment(input, seqs, row_type);
+            block->insert(f);
+            fragments.push_back(f);
+        }
+        block->share_rows();
+    }
+    uint64_t bsas_number = read_number(input);
+    for (uint64_t i = 0; i < bsas_number; i++) {
+        BSA& bsa = block_set.bsa(read_string(input));
+        uint64_t rows_number = read_number(input);
+        for (uint64_t j = 0; j < rows_number; j++) {
+            uint64_t seq_index = read_number(input);
+            if (seq_index >= seqs.size()) {
+                broken();
+            }
+            BSRow& row = bsa[seqs[seq_index].get()];
+            row.ori = read_signed(input);
+            uint64_t length = read_number(input);
+            for (uint64_t k = 0; k < length; k++) {
+                uint64_t index = read_number(input);
+                if (index == NO_FRAGMENT) {
+                    row.fragments.push_back(0);
+                } else if (index < fragments.size()) {
+                    row.fragments.push_back(fragments[index]);
+                } else {
+                    broken();
+                }
+            }
+        }
+    }
+}
+
+}
+
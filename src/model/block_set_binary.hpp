@@ -0,0 +1,45 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_BLOCK_SET_BINARY_HPP_
+#define NPGE_BLOCK_SET_BINARY_HPP_
+
+#include <iosfwd>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Return if the stream contains binary blockset (bsb).
+Only the first byte is examined (peek), nothing is consumed.
+*/
+bool is_block_set_binary(std::istream& input);
+
+/** Write blockset in binary format (bsb).
+The file stores sequences (names, descriptions and letters),
+blocks (names, fragments as (sequence, min, max, ori)),
+alignment rows as bitsets (see AlignmentRow::bitsets())
+and blockset alignments.
+Numbers are stored in native byte order, so the file
+is not portable between machines of different endianness.
+*/
+void write_block_set_binary(const BlockSet& block_set,
+                            std::ostream& output);
+
+/** Read blockset in binary format (bsb) and add it to blockset.
+If the blockset already has a sequence with same name and size,
+it is used instead of sequence from the file.
+Letters of alignment rows are not checked.
+Throws Exception if the stream is not a valid binary blockset.
+*/
+void read_block_set_binary(BlockSet& block_set, std::istream& input,
+                           RowType row_type, SequenceType seq_type);
+
+}
+
+#endif
+
@@ -0,0 +1,504 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <set>
+#include <map>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <boost/foreach.hpp>
+
+#include "block_set_index.hpp"
+#include "read_block_set.hpp"
+#include "BlockSet.hpp"
+#include "Block.hpp"
+#include "Fragment.hpp"
+#include "Sequence.hpp"
+#include "key_value.hpp"
+#include "name_to_stream.hpp"
+#include "gzip_stream.hpp"
+#include "Exception.hpp"
+
+namespace npge {
+
+// File layout (numbers are uint64_t, native byte order):
+//  - magic, byte order mark;
+//  - number of sequences, sequences: name, begin, end
+//    (begin == end if sequence has no record);
+//  - number of blocks, blocks: name, number of ranges,
+//    ranges (begin, end), number of sequences,
+//    indices of sequences.
+// Strings are stored as length and characters.
+// Offsets are from the beginning of blockset file.
+
+static const char MAGIC[] = "NPGEBSI1";
+static const uint64_t BYTE_ORDER_MARK = 0x0102030405060708ULL;
+
+typedef std::pair<uint64_t, uint64_t> Range;
+typedef std::vector<Range> Ranges;
+
+struct IndexedSeq {
+    std::string name_;
+    Range range_;
+};
+
+struct IndexedBlock {
+    std::string name_;
+    Ranges ranges_;
+    std::vector<uint64_t> seqs_;
+};
+
+typedef std::vector<IndexedSeq> IndexedSeqs;
+typedef std::vector<IndexedBlock> IndexedBlocks;
+
+std::string block_set_index_name(const std::string& bs_file) {
+    return bs_file + ".bsi";
+}
+
+bool has_block_set_index(const std::string& bs_file) {
+    std::string index = block_set_index_name(bs_file);
+    return file_exists(bs_file) && file_exists(index) &&
+           is_newer(index, bs_file);
+}
+
+static void write_number(std::ostream& out, uint64_t number) {
+    out.write(reinterpret_cast<const char*>(&number),
+              sizeof(number));
+}
+
+static void write_string(std::ostream& out, const std::string& text) {
+    write_number(out, text.size());
+    out.write(text.c_str(), text.size());
+}
+
+// same as std::isspace in "C" locale
+static bool is_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/** Parse header line, return name and description */
+static void parse_header(const std::string& line, std::string& name,
+                         std::string& description) {
+    size_t e = line.size();
+    while (e > 1 && is_space(line[e - 1])) {
+        e -= 1;
+    }
+    size_t sp = 1;
+    while (sp < e && !is_space(line[sp])) {
+        sp += 1;
+    }
+    name.assign(line, 1, sp - 1);
+    while (sp < e && is_space(line[sp])) {
+        sp += 1;
+    }
+    description.assign(line, sp, e - sp);
+}
+
+class IndexBuilder {
+public:
+    IndexedSeqs seqs_;
+    IndexedBlocks blocks_;
+
+    IndexBuilder():
+        seq_(NONE), block_(NONE) {
+    }
+
+    void add_header(const std::string& line, uint64_t offset) {
+        finish(offset);
+        std::string name, description;
+        parse_header(line, name, description);
+        if (is_fragment_name(name)) {
+            std::string block_name = extract_value(description, "block");
+            std::map<std::string, uint64_t>::iterator it =
+                name2block_.find(block_name);
+            if (it == name2block_.end()) {
+                it = name2block_.insert(std::make_pair(block_name,
+                                        blocks_.size())).first;
+                blocks_.push_back(IndexedBlock());
+                blocks_.back().name_ = block_name;
+                block_seqs_.push_back(std::set<uint64_t>());
+            }
+            block_ = it->second;
+            uint64_t seq = seq_index(Fragment::seq_name_from_id(name));
+            if (block_seqs_[block_].insert(seq).second) {
+                blocks_[block_].seqs_.push_back(seq);
+            }
+        } else {
+            seq_ = seq_index(name);
+        }
+        begin_ = offset;
+    }
+
+    void finish(uint64_t offset) {
+        if (seq_ != NONE) {
+            seqs_[seq_].range_ = Range(begin_, offset);
+        } else if (block_ != NONE) {
+            Ranges& ranges = blocks_[block_].ranges_;
+            if (!ranges.empty() && ranges.back().second == begin_) {
+                ranges.back().second = offset;
+            } else {
+                ranges.push_back(Range(begin_, offset));
+            }
+        }
+        seq_ = NONE;
+        block_ = NONE;
+    }
+
+private:
+    static const uint64_t NONE = ~uint64_t(0);
+
+    std::map<std::string, uint64_t> name2seq_;
+    std::map<std::string, uint64_t> name2block_;
+    std::vector<std::set<uint64_t> > block_seqs_;
+    uint64_t seq_, block_; // current record
+    uint64_t begin_;
+
+    uint64_t seq_index(const std::string& name) {
+        std::map<std::string, uint64_t>::iterator it =
+            name2seq_.find(name);
+        if (it == name2seq_.end()) {
+            it = name2seq_.insert(std::make_pair(name,
+                                                 seqs_.size())).first;
+            IndexedSeq seq;
+            seq.name_ = name;
+            seq.range_ = Range(0, 0);
+            seqs_.push_back(seq);
+        }
+        return it->second;
+    }
+};
+
+void write_block_set_index(const std::string& bs_file) {
+    if (is_gzip_name(bs_file)) {
+        throw Exception("Index of compressed file " + bs_file +
+                        " is not supported");
+    }
+    std::ifstream input(bs_file.c_str(),
+                        std::ios_base::in | std::ios_base::binary);
+    if (!input.is_open()) {
+        throw Exception("Error opening file " + bs_file);
+    }
+    IndexBuilder builder;
+    uint64_t offset = 0;
+    std::string line;
+    while (std::getline(input, line)) {
+        if (!line.empty() && line[0] == '>') {
+            builder.add_header(line, offset);
+        }
+        offset += line.size();
+        if (!input.eof()) {
+            offset += 1; // '\n'
+        }
+    }
+    builder.finish(offset);
+    std::string index = block_set_index_name(bs_file);
+    std::ofstream out(index.c_str(),
+                      std::ios_base::out | std::ios_base::binary);
+    if (!out.is_open()) {
+        throw Exception("Error opening file " + index);
+    }
+    out.write(MAGIC, sizeof(MAGIC) - 1);
+    write_number(out, BYTE_ORDER_MARK);
+    write_number(out, builder.seqs_.size());
+    BOOST_FOREACH (const IndexedSeq& seq, builder.seqs_) {
+        write_string(out, seq.name_);
+        write_number(out, seq.range_.first);
+        write_number(out, seq.range_.second);
+    }
+    write_number(out, builder.blocks_.size());
+    BOOST_FOREACH (const IndexedBlock& block, builder.blocks_) {
+        write_string(out, block.name_);
+        write_number(out, block.ranges_.size());
+        BOOST_FOREACH (const Range& range, block.ranges_) {
+            write_number(out, range.first);
+            write_number(out, range.second);
+        }
+        write_number(out, block.seqs_.size());
+        BOOST_FOREACH (uint64_t seq, block.seqs_) {
+            write_number(out, seq);
+        }
+    }
+    if (!out) {
+        throw Exception("Error writing file " + index);
+    }
+}
+
+struct BlockSetIndex::Impl {
+    std::string bs_file_;
+    IndexedSeqs seqs_;
+    IndexedBlocks blocks_;
+    std::map<std::string, uint64_t> name2block_;
+    // blocks with fragments of each sequence without record
+    std::vector<std::vector<uint64_t> > seq_blocks_;
+    uint64_t file_size_;
+
+    void broken() const {
+        throw Exception("Broken blockset index of " + bs_file_);
+    }
+
+    uint64_t read_number(std::istream& input) const {
+        uint64_t number;
+        if (!input.read(reinterpret_cast<char*>(&number),
+                        sizeof(number))) {
+            broken();
+        }
+        return number;
+    }
+
+    std::string read_string(std::istream& input) const {
+        uint64_t size = read_number(input);
+        if (size > file_size_) {
+            broken();
+        }
+        std::string text(size, '\0');
+        if (size && !input.read(&text[0], size)) {
+            broken();
+        }
+        return text;
+    }
+
+    Range read_range(std::istream& input) const {
+        Range range;
+        range.first = read_number(input);
+        range.second = read_number(input);
+        if (range.first > range.second) {
+            broken();
+        }
+        return range;
+    }
+
+    void read(std::istream& input) {
+        std::string magic(sizeof(MAGIC) - 1, '\0');
+        if (!input.read(&magic[0], magic.size()) || magic != MAGIC) {
+            throw Exception("Not a blockset index of " + bs_file_);
+        }
+        if (read_number(input) != BYTE_ORDER_MARK) {
+            throw Exception("Wrong byte order of blockset index of " +
+                            bs_file_);
+        }
+        uint64_t seqs_number = read_number(input);
+        for (uint64_t i = 0; i < seqs_number; i++) {
+            IndexedSeq seq;
+            seq.name_ = read_string(input);
+            seq.range_ = read_range(input);
+            seqs_.push_back(seq);
+        }
+        uint64_t blocks_number = read_number(input);
+        for (uint64_t i = 0; i < blocks_number; i++) {
+            blocks_.push_back(IndexedBlock());
+            IndexedBlock& block = blocks_.back();
+            block.name_ = read_string(input);
+            uint64_t ranges_number = read_number(input);
+            for (uint64_t j = 0; j < ranges_number; j++) {
+                block.ranges_.push_back(read_range(input));
+            }
+            uint64_t block_seqs = read_number(input);
+            for (uint64_t j = 0; j < block_seqs; j++) {
+                uint64_t seq = read_number(input);
+                if (seq >= seqs_.size()) {
+                    broken();
+                }
+                block.seqs_.push_back(seq);
+            }
+            name2block_[block.name_] = i;
+        }
+        seq_blocks_.resize(seqs_.size());
+        for (uint64_t i = 0; i < blocks_.size(); i++) {
+            BOOST_FOREACH (uint64_t seq, blocks_[i].seqs_) {
+                if (!has_record(seq)) {
+                    seq_blocks_[seq].push_back(i);
+                }
+            }
+        }
+    }
+
+    bool has_record(uint64_t seq) const {
+        const Range& range = seqs_[seq].range_;
+        return range.first != range.second;
+    }
+
+    /** Append bytes of blockset file to text */
+    void append_range(std::istream& input, const Range& range,
+                      std::string& text) const {
+        if (range.first == range.second) {
+            return;
+        }
+        size_t old_size = text.size();
+        text.resize(old_size + (range.second - range.first));
+        input.clear();
+        input.seekg(range.first);
+        if (!input.read(&text[old_size], range.second - range.first)) {
+            throw Exception("Blockset file " + bs_file_ +
+                            " does not match its index");
+        }
+        if (text[text.size() - 1] != '\n') {
+            text += '\n';
+        }
+    }
+
+    void read_records(BlockSet& block_set, const std::string& text,
+                      RowType row_type, SequenceType seq_type) const {
+        std::istringstream records(text);
+        BlockSetFastaReader reader(block_set, records,
+                                   row_type, seq_type);
+        reader.run();
+    }
+
+    /** Add sequences without records to blockset.
+    A sequence is built from all its fragments in the file,
+    not only from fragments of blocks being read.
+    */
+    void build_sequences(BlockSet& block_set, std::istream& input,
+                         const std::set<uint64_t>& seqs,
+                         SequenceType seq_type) const {
+        std::set<uint64_t> blocks;
+        BOOST_FOREACH (uint64_t seq, seqs) {
+            blocks.insert(seq_blocks_[seq].begin(),
+                          seq_blocks_[seq].end());
+        }
+        std::string text;
+        BOOST_FOREACH (uint64_t block, blocks) {
+            BOOST_FOREACH (const Range& range, blocks_[block].ranges_) {
+                append_range(input, range, text);
+            }
+        }
+        BlockSet all_fragments;
+        read_records(all_fragments, text, COMPACT_ROW, seq_type);
+        std::map<std::string, SequencePtr> name2seq;
+        BOOST_FOREACH (const SequencePtr& seq, all_fragments.seqs()) {
+            name2seq[seq->name()] = seq;
+        }
+        BOOST_FOREACH (uint64_t seq, seqs) {
+            block_set.add_sequence(name2seq[seqs_[seq].name_]);
+        }
+    }
+};
+
+BlockSetIndex::BlockSetIndex(const std::string& bs_file):
+    impl_(new Impl) {
+    impl_->bs_file_ = bs_file;
+    std::string index = block_set_index_name(bs_file);
+    std::ifstream input(index.c_str(),
+                        std::ios_base::in | std::ios_base::binary);
+    if (!input.is_open()) {
+        delete impl_;
+        throw Exception("Error opening file " + index);
+    }
+    input.seekg(0, std::ios_base::end);
+    impl_->file_size_ = input.tellg();
+    input.seekg(0);
+    try {
+        impl_->read(input);
+    } catch (...) {
+        delete impl_;
+        throw;
+    }
+}
+
+BlockSetIndex::~BlockSetIndex() {
+    delete impl_;
+}
+
+Strings BlockSetIndex::block_names() const {
+    Strings result;
+    BOOST_FOREACH (const IndexedBlock& block, impl_->blocks_) {
+        result.push_back(block.name_);
+    }
+    return result;
+}
+
+bool BlockSetIndex::has_block(const std::string& name) const {
+    return impl_->name2block_.find(name) != impl_->name2block_.end();
+}
+
+typedef std::set<std::string> NamesSet;
+
+static NamesSet seq_names(const BlockSet& block_set) {
+    NamesSet result;
+    BOOST_FOREACH (const SequencePtr& seq, block_set.seqs()) {
+        result.insert(seq->name());
+    }
+    return result;
+}
+
+static void open_bs(std::ifstream& input,
+                    const std::string& bs_file) {
+    input.open(bs_file.c_str(),
+               std::ios_base::in | std::ios_base::binary);
+    if (!input.is_open()) {
+        throw Exception("Error opening file " + bs_file);
+    }
+}
+
+void BlockSetIndex::read_sequences(BlockSet& block_set,
+                                   SequenceType seq_type) const {
+    std::ifstream input;
+    open_bs(input, impl_->bs_file_);
+    NamesSet existing = seq_names(block_set);
+    std::string text;
+    BOOST_FOREACH (const IndexedSeq& seq, impl_->seqs_) {
+        if (existing.find(seq.name_) == existing.end()) {
+            impl_->append_range(input, seq.range_, text);
+        }
+    }
+    impl_->read_records(block_set, text, COMPACT_ROW, seq_type);
+}
+
+void BlockSetIndex::read_blocks(BlockSet& block_set,
+                                const Strings& names,
+                                RowType row_type,
+                                SequenceType seq_type) const {
+    NamesSet existing_blocks;
+    BOOST_FOREACH (const Block* block, block_set) {
+        existing_blocks.insert(block->name());
+    }
+    std::set<uint64_t> seqs;
+    Ranges ranges;
+    BOOST_FOREACH (const std::string& name, names) {
+        if (existing_blocks.find(name) != existing_blocks.end()) {
+            continue;
+        }
+        std::map<std::string, uint64_t>::const_iterator it =
+            impl_->name2block_.find(name);
+        if (it == impl_->name2block_.end()) {
+            throw Exception("Block " + name + " is not in index of " +
+                            impl_->bs_file_);
+        }
+        existing_blocks.insert(name);
+        const IndexedBlock& block = impl_->blocks_[it->second];
+        ranges.insert(ranges.end(), block.ranges_.begin(),
+                      block.ranges_.end());
+        seqs.insert(block.seqs_.begin(), block.seqs_.end());
+    }
+    std::ifstream input;
+    open_bs(input, impl_->bs_file_);
+    NamesSet existing_seqs = seq_names(block_set);
+    std::string text;
+    std::set<uint64_t> no_record;
+    // sequences must precede their fragments
+    BOOST_FOREACH (uint64_t seq_index, seqs) {
+        const IndexedSeq& seq = impl_->seqs_[seq_index];
+        if (existing_seqs.find(seq.name_) != existing_seqs.end()) {
+            continue;
+        }
+        if (impl_->has_record(seq_index)) {
+            impl_->append_range(input, seq.range_, text);
+        } else {
+            no_record.insert(seq_index);
+        }
+    }
+    if (!no_record.empty()) {
+        impl_->build_sequences(block_set, input, no_record, seq_type);
+    }
+    BOOST_FOREACH (const Range& range, ranges) {
+        impl_->append_range(input, range, text);
+    }
+    impl_->read_records(block_set, text, row_type, seq_type);
+}
+
+}
+
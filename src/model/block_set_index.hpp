@@ -0,0 +1,76 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_BLOCK_SET_INDEX_HPP_
+#define NPGE_BLOCK_SET_INDEX_HPP_
+
+#include <string>
+#include <boost/utility.hpp>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Return name of index file of blockset file */
+std::string block_set_index_name(const std::string& bs_file);
+
+/** Return if index of blockset file exists and is up to date */
+bool has_block_set_index(const std::string& bs_file);
+
+/** Write index of blockset file (fasta format).
+Compressed files (.gz) are not supported.
+Index stores byte ranges of records of each block and
+of each sequence, and names of sequences of each block.
+Numbers are stored in native byte order, so the file
+is not portable between machines of different endianness.
+*/
+void write_block_set_index(const std::string& bs_file);
+
+/** Random access to blocks of blockset file using its index */
+class BlockSetIndex : boost::noncopyable {
+public:
+    /** Constructor.
+    Reads index of blockset file.
+    Throws Exception if the index is not valid.
+    */
+    BlockSetIndex(const std::string& bs_file);
+
+    /** Destructor */
+    ~BlockSetIndex();
+
+    /** Return names of blocks in order of the file */
+    Strings block_names() const;
+
+    /** Return if the file has a block with this name */
+    bool has_block(const std::string& name) const;
+
+    /** Add all sequences of the file to blockset.
+    Sequences with names present in blockset are skipped.
+    */
+    void read_sequences(BlockSet& block_set,
+                        SequenceType seq_type) const;
+
+    /** Add blocks with these names and their sequences to blockset.
+    Blocks with names present in blockset are skipped.
+    Sequences with names present in blockset are reused.
+    If a sequence is not stored in the file (only its fragments),
+    it is built from all its fragments in the file, so later calls
+    can reuse it for other blocks.
+    Throws Exception if a block is not in the index.
+    */
+    void read_blocks(BlockSet& block_set, const Strings& names,
+                     RowType row_type, SequenceType seq_type) const;
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
+
+}
+
+#endif
+
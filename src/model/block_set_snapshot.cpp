@@ -0,0 +1,218 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <vector>
+#include <algorithm>
+#include <boost/foreach.hpp>
+#include <boost/unordered_map.hpp>
+#include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+
+#include "block_set_snapshot.hpp"
+#include "BlockSet.hpp"
+#include "Block.hpp"
+#include "Fragment.hpp"
+#include "AlignmentRow.hpp"
+#include "Sequence.hpp"
+#include "block_hash.hpp"
+
+namespace npge {
+
+// row length of fragment without row
+const int NO_ROW = -1;
+
+struct FragmentRecord {
+    const Sequence* seq_;
+    pos_t min_pos_;
+    pos_t max_pos_;
+    int ori_;
+    int row_length_;
+    int first_bitset_;
+    int bitsets_;
+};
+
+struct BlockRecord {
+    std::string name_;
+    int first_fragment_;
+    int fragments_;
+};
+
+typedef std::vector<CAR_Bitset> Bitsets;
+typedef boost::unordered_multimap<hash_t, int> Hash2Block;
+
+static bool fragment_less(const Fragment* a, const Fragment* b) {
+    typedef boost::tuple<const Sequence*, pos_t, pos_t, int> Tie;
+    return Tie(a->seq(), a->min_pos(), a->max_pos(), a->ori()) <
+           Tie(b->seq(), b->min_pos(), b->max_pos(), b->ori());
+}
+
+struct BlockSetSnapshot::Impl {
+    std::vector<SequencePtr> seqs_;
+    std::vector<BlockRecord> blocks_;
+    std::vector<FragmentRecord> fragments_;
+    Bitsets bitsets_;
+    Hash2Block hash2block_;
+
+    void add_block(const Block* block) {
+        BlockRecord b;
+        b.name_ = block->name();
+        b.first_fragment_ = fragments_.size();
+        b.fragments_ = block->size();
+        // fragments are sorted to compare blocks in linear time
+        Fragments fragments(block->begin(), block->end());
+        std::sort(fragments.begin(), fragments.end(), fragment_less);
+        Bitsets bitsets;
+        BOOST_FOREACH (const Fragment* f, fragments) {
+            FragmentRecord r;
+            r.seq_ = f->seq();
+            r.min_pos_ = f->min_pos();
+            r.max_pos_ = f->max_pos();
+            r.ori_ = f->ori();
+            r.first_bitset_ = bitsets_.size();
+            const AlignmentRow* row = f->row();
+            if (row) {
+                r.row_length_ = row->length();
+                bitsets.clear();
+                row->bitsets(bitsets);
+                bitsets_.insert(bitsets_.end(),
+                                bitsets.begin(), bitsets.end());
+            } else {
+                r.row_length_ = NO_ROW;
+            }
+            r.bitsets_ = bitsets_.size() - r.first_bitset_;
+            fragments_.push_back(r);
+        }
+        hash2block_.insert(std::make_pair(block_hash(block),
+                                          int(blocks_.size())));
+        blocks_.push_back(b);
+    }
+
+    bool equal(const BlockRecord& b, const Block* block) const {
+        if (b.fragments_ != block->size()) {
+            return false;
+        }
+        Fragments fragments(block->begin(), block->end());
+        std::sort(fragments.begin(), fragments.end(), fragment_less);
+        Bitsets bitsets;
+        for (int i = 0; i < b.fragments_; i++) {
+            const FragmentRecord& r = fragments_[b.first_fragment_ + i];
+            const Fragment* f = fragments[i];
+            if (r.seq_ != f->seq() || r.min_pos_ != f->min_pos() ||
+                    r.max_pos_ != f->max_pos() || r.ori_ != f->ori()) {
+                return false;
+            }
+            const AlignmentRow* row = f->row();
+            int row_length = row ? row->length() : NO_ROW;
+            if (r.row_length_ != row_length) {
+                return false;
+            }
+            if (row) {
+                bitsets.clear();
+                row->bitsets(bitsets);
+                if (bitsets.size() != r.bitsets_ ||
+                        !std::equal(bitsets.begin(), bitsets.end(),
+                                    bitsets_.begin() + r.first_bitset_)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    int find_block(const Block* block) const {
+        typedef Hash2Block::const_iterator It;
+        hash_t hash = block_hash(block);
+        std::pair<It, It> range = hash2block_.equal_range(hash);
+        for (It it = range.first; it != range.second; ++it) {
+            if (equal(blocks_[it->second], block)) {
+                return it->second;
+            }
+        }
+        return -1;
+    }
+
+    Block* make_block(const BlockRecord& b, RowType row_type) const {
+        Block* block = new Block(b.name_);
+        Bitsets bitsets;
+        for (int i = 0; i < b.fragments_; i++) {
+            const FragmentRecord& r = fragments_[b.first_fragment_ + i];
+            Fragment* f = new Fragment(const_cast<Sequence*>(r.seq_),
+                                       r.min_pos_, r.max_pos_, r.ori_);
+            if (r.row_length_ != NO_ROW) {
+                Bitsets::const_iterator begin = bitsets_.begin() +
+                                                r.first_bitset_;
+                bitsets.assign(begin, begin + r.bitsets_);
+                AlignmentRow* row = AlignmentRow::new_row(row_type);
+                row->set_bitsets(bitsets, r.row_length_);
+                f->set_row(row);
+            }
+            block->insert(f);
+        }
+        block->share_rows();
+        return block;
+    }
+};
+
+BlockSetSnapshot::BlockSetSnapshot():
+    impl_(new Impl) {
+}
+
+BlockSetSnapshot::~BlockSetSnapshot() {
+    delete impl_;
+}
+
+void BlockSetSnapshot::take(const BlockSet& block_set) {
+    clear();
+    impl_->seqs_ = block_set.seqs();
+    BOOST_FOREACH (const Block* block, block_set) {
+        impl_->add_block(block);
+    }
+}
+
+int BlockSetSnapshot::size() const {
+    return impl_->blocks_.size();
+}
+
+bool BlockSetSnapshot::has_block(const Block* block) const {
+    return impl_->find_block(block) != -1;
+}
+
+int BlockSetSnapshot::restore(BlockSet& target,
+                              BlockSet* unchanged,
+                              RowType row_type) const {
+    std::vector<bool> skip(impl_->blocks_.size(), false);
+    if (unchanged) {
+        BOOST_FOREACH (Block* block, *unchanged) {
+            int index = impl_->find_block(block);
+            if (index != -1 && !skip[index]) {
+                skip[index] = true;
+                block->set_name(impl_->blocks_[index].name_);
+            }
+        }
+    }
+    target.add_sequences(impl_->seqs_);
+    int added = 0;
+    for (int i = 0; i < impl_->blocks_.size(); i++) {
+        if (!skip[i]) {
+            const BlockRecord& b = impl_->blocks_[i];
+            target.insert(impl_->make_block(b, row_type));
+            added += 1;
+        }
+    }
+    return added;
+}
+
+void BlockSetSnapshot::clear() {
+    impl_->seqs_.clear();
+    std::vector<BlockRecord>().swap(impl_->blocks_);
+    std::vector<FragmentRecord>().swap(impl_->fragments_);
+    Bitsets().swap(impl_->bitsets_);
+    impl_->hash2block_.clear();
+}
+
+}
+
@@ -0,0 +1,70 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_BLOCK_SET_SNAPSHOT_HPP_
+#define NPGE_BLOCK_SET_SNAPSHOT_HPP_
+
+#include <boost/utility.hpp>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Frozen copy of blocks of blockset.
+Blocks are stored as plain records (sequence, positions, ori
+and bitsets of alignment row) instead of objects, so a snapshot
+takes much less memory than BlockSet::clone().
+Sequences are shared with the blockset.
+
+Blocks are created again by restore(). Blocks, which are still
+present (with same fragments and alignment) in other blockset,
+can be skipped, so only changed blocks are copied.
+*/
+class BlockSetSnapshot : boost::noncopyable {
+public:
+    /** Constructor (empty snapshot) */
+    BlockSetSnapshot();
+
+    /** Destructor */
+    ~BlockSetSnapshot();
+
+    /** Replace contents of snapshot with blocks of blockset.
+    Weak blocks are stored as usual blocks.
+    */
+    void take(const BlockSet& block_set);
+
+    /** Return number of blocks in snapshot */
+    int size() const;
+
+    /** Return if snapshot has a block with same fragments
+    and alignment as this block.
+    */
+    bool has_block(const Block* block) const;
+
+    /** Add sequences and copies of blocks to blockset.
+    \param target Blockset to which blocks are added.
+    \param unchanged If not 0, blocks, equal to blocks of this
+        blockset (same fragments and alignment), are not added;
+        instead, saved names are given to blocks of unchanged.
+    \param row_type Type of created alignment rows.
+    Return number of added blocks.
+    */
+    int restore(BlockSet& target, BlockSet* unchanged = 0,
+                RowType row_type = COMPACT_ROW) const;
+
+    /** Remove all blocks and sequences from snapshot */
+    void clear();
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
+
+}
+
+#endif
+
@@ -6,12 +6,15 @@
  */
 
 #include <set>
+#include <vector>
+#include <algorithm>
 #include <boost/foreach.hpp>
 
 #include "block_stat.hpp"
 #include "Block.hpp"
 #include "Fragment.hpp"
 #include "Sequence.hpp"
+#include "AlignmentMatrix.hpp"
 #include "BlockSet.hpp"
 #include "boundaries.hpp"
 #include "char_to_size.hpp"
@@ -108,15 +111,109 @@ Decimal AlignmentStat::gc() const {
 // TODO rename Boundaries to smth
 typedef Boundaries Integers;
 
+void decode_tile(std::vector<char>& letters, const Block* block,
+                 int start, int stop) {
+    int columns = stop - start;
+    letters.resize(block->size() * columns);
+    if (columns <= 0) {
+        return;
+    }
+    std::vector<pos_t> positions(columns);
+    char* row = letters.empty() ? 0 : &letters[0];
+    BOOST_FOREACH (const Fragment* f, *block) {
+        f->alignment_chars(start, stop, row, &positions[0]);
+        row += columns;
+    }
+}
+
+// column of tile: rows letters with step stride
+static void test_tile_column(const char* column, int rows, int stride,
+                             bool& ident, bool& gap, bool& pure_gap,
+                             int* atgc) {
+    char seen_letter = 0;
+    ident = true;
+    gap = false;
+    for (int i = 0; i < rows; i++) {
+        char c = column[i * stride];
+        if (c == 0) {
+            gap = true;
+        } else if (seen_letter == 0) {
+            seen_letter = c;
+        } else if (c != seen_letter) {
+            ident = false;
+        }
+        if (c != 0 && atgc) {
+            size_t letter_index = char_to_size(c);
+            if (letter_index < LETTERS_NUMBER) {
+                atgc[letter_index] += 1;
+            }
+        }
+    }
+    pure_gap = !bool(seen_letter);
+}
+
+/** Columns of block tested using cached matrix or tiles */
+class ColumnTester {
+public:
+    ColumnTester(const Block* block, int start, int stop):
+        block_(block), matrix_(block->matrix()),
+        rows_(block->size()), start_(start), stop_(stop),
+        tile_(start), tile_stop_(start) {
+    }
+
+    /** Test column, columns must be tested in increasing order */
+    void test(int pos, bool& ident, bool& gap, bool& pure_gap,
+              int* atgc) {
+        if (matrix_) {
+            matrix_->test_column(pos, ident, gap, pure_gap, atgc);
+            return;
+        }
+        if (pos >= tile_stop_) {
+            tile_ = pos - (pos - start_) % TILE_COLUMNS;
+            tile_stop_ = std::min(tile_ + TILE_COLUMNS, stop_ + 1);
+            decode_tile(letters_, block_, tile_, tile_stop_);
+        }
+        const char* column = rows_ ? &letters_[pos - tile_] : 0;
+        test_tile_column(column, rows_, tile_stop_ - tile_,
+                         ident, gap, pure_gap, atgc);
+    }
+
+private:
+    const Block* block_;
+    const AlignmentMatrix* matrix_;
+    int rows_;
+    int start_, stop_;
+    int tile_, tile_stop_;
+    std::vector<char> letters_;
+};
+
+void test_columns(const Block* block, std::vector<bool>& ident,
+                  std::vector<bool>& gap, int start, int stop) {
+    if (stop == -1) {
+        stop = block->alignment_length() - 1;
+    }
+    int length = std::max(stop - start + 1, 0);
+    ident.resize(length);
+    gap.resize(length);
+    ColumnTester tester(block, start, stop);
+    for (int pos = start; pos <= stop; pos++) {
+        bool i, g, pure_gap;
+        tester.test(pos, i, g, pure_gap, /* atgc */ 0);
+        ident[pos - start] = i;
+        gap[pos - start] = g;
+    }
+}
+
 void make_stat(AlignmentStat& stat, const Block* block, int start, int stop) {
     int alignment_length = block->alignment_length();
     if (stop == -1) {
         stop = alignment_length - 1;
     }
     stat.impl_->total_ = stop - start + 1;
+    ColumnTester tester(block, start, stop);
     for (int pos = start; pos <= stop; pos++) {
         bool ident, gap, pure_gap;
-        test_column(block, pos, ident, gap, pure_gap, stat.impl_->atgc_);
+        tester.test(pos, ident, gap, pure_gap, stat.impl_->atgc_);
         if (!pure_gap) {
             if (ident && !gap) {
                 stat.impl_->ident_nogap_ += 1;
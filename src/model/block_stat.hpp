@@ -8,6 +8,8 @@
 #ifndef NPGE_BLOCK_STAT_HPP_
 #define NPGE_BLOCK_STAT_HPP_
 
+#include <vector>
+
 #include "global.hpp"
 #include "Decimal.hpp"
 
@@ -76,6 +78,31 @@ start and stop affect gaps, ident and ATGC counters only.
 void make_stat(AlignmentStat& stat, const Block* block, int start = 0,
                int stop = -1);
 
+/** Number of columns in tile.
+Column algorithms decode this number of columns of all
+fragments at once (see decode_tile()).
+*/
+const int TILE_COLUMNS = 256;
+
+/** Decode letters of columns [start, stop) of all fragments.
+Rows are written one after another in order of fragments
+in block: letter of i-th fragment in column start + j is
+letters[i * (stop - start) + j]. Gaps are written as 0.
+This is faster than calling Fragment::alignment_at()
+for each cell (see Fragment::alignment_chars()).
+*/
+void decode_tile(std::vector<char>& letters, const Block* block,
+                 int start, int stop);
+
+/** Test columns [start, stop] of block.
+Results for column start + i are written to ident[i] and gap[i]
+(see test_column()). Value stop = -1 means last column.
+Columns are read from Block::matrix() if it is cached,
+otherwise tile by tile (see decode_tile()).
+*/
+void test_columns(const Block* block, std::vector<bool>& ident,
+                  std::vector<bool>& gap, int start = 0, int stop = -1);
+
 /** Return if the column is ident and has no gaps */
 bool is_ident_nogap(const Block* block, int column);
 
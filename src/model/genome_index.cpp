@@ -0,0 +1,263 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "genome_index.hpp"
+#include "Sequence.hpp"
+#include "name_to_stream.hpp"
+#include "Exception.hpp"
+#include "throw_assert.hpp"
+
+namespace npge {
+
+// File layout (all numbers are uint64_t, native byte order):
+//  - magic, byte order mark, number of sequences;
+//  - table of entries, ENTRY_FIELDS numbers per sequence;
+//  - data: words, runs of N (pairs), name + description.
+// All offsets are from the beginning of file and
+// are multiple of 8.
+
+static const char MAGIC[] = "NPGEGI01";
+static const uint64_t BYTE_ORDER_MARK = 0x0102030405060708ULL;
+static const int HEADER_FIELDS = 2;
+
+enum EntryField {
+    SEQ_SIZE,
+    WORDS_OFFSET,
+    WORDS_SIZE,
+    RUNS_OFFSET,
+    RUNS_SIZE,
+    TEXT_OFFSET,
+    NAME_LENGTH,
+    DESCRIPTION_LENGTH,
+    ENTRY_FIELDS
+};
+
+std::string genome_index_name(const std::string& fasta) {
+    return fasta + ".npgi";
+}
+
+bool has_genome_index(const std::string& fasta) {
+    std::string index = genome_index_name(fasta);
+    return file_exists(fasta) && file_exists(index) &&
+           is_newer(index, fasta);
+}
+
+static uint64_t aligned(uint64_t offset) {
+    return (offset + 7) / 8 * 8;
+}
+
+static void write_number(std::ostream& out, uint64_t number) {
+    out.write(reinterpret_cast<const char*>(&number),
+              sizeof(number));
+}
+
+static void write_padding(std::ostream& out, uint64_t& offset) {
+    uint64_t new_offset = aligned(offset);
+    for (; offset < new_offset; offset++) {
+        out.put('\0');
+    }
+}
+
+typedef boost::shared_ptr<PackedSequence> PackedPtr;
+
+static PackedPtr to_packed(const SequencePtr& seq) {
+    PackedPtr packed = boost::dynamic_pointer_cast<PackedSequence>(seq);
+    if (!packed) {
+        packed = boost::make_shared<PackedSequence>(seq->contents());
+    }
+    return packed;
+}
+
+void write_genome_index(const std::vector<SequencePtr>& seqs,
+                        const std::string& filename) {
+    std::vector<PackedPtr> packed;
+    BOOST_FOREACH (const SequencePtr& seq, seqs) {
+        packed.push_back(to_packed(seq));
+    }
+    // table
+    std::vector<uint64_t> table;
+    uint64_t offset = sizeof(MAGIC) - 1 +
+                      sizeof(uint64_t) * HEADER_FIELDS +
+                      sizeof(uint64_t) * ENTRY_FIELDS * seqs.size();
+    for (int i = 0; i < seqs.size(); i++) {
+        const PackedSequence& p = *packed[i];
+        const Sequence& s = *seqs[i];
+        uint64_t entry[ENTRY_FIELDS];
+        entry[SEQ_SIZE] = p.size();
+        entry[WORDS_OFFSET] = offset;
+        entry[WORDS_SIZE] = p.words_size();
+        offset += sizeof(hash_t) * p.words_size();
+        entry[RUNS_OFFSET] = offset;
+        entry[RUNS_SIZE] = p.n_runs().size();
+        offset += 2 * sizeof(uint64_t) * p.n_runs().size();
+        entry[TEXT_OFFSET] = offset;
+        entry[NAME_LENGTH] = s.name().size();
+        entry[DESCRIPTION_LENGTH] = s.description().size();
+        offset = aligned(offset + s.name().size() +
+                         s.description().size());
+        table.insert(table.end(), entry, entry + ENTRY_FIELDS);
+    }
+    // write; file is replaced only when written completely
+    std::string tmp = filename + ".tmp";
+    std::ofstream out(tmp.c_str(),
+                      std::ios_base::out | std::ios_base::binary);
+    if (!out.is_open()) {
+        throw Exception("Error opening file " + tmp);
+    }
+    out.write(MAGIC, sizeof(MAGIC) - 1);
+    write_number(out, BYTE_ORDER_MARK);
+    write_number(out, seqs.size());
+    BOOST_FOREACH (uint64_t number, table) {
+        write_number(out, number);
+    }
+    offset = 0;
+    for (int i = 0; i < seqs.size(); i++) {
+        const PackedSequence& p = *packed[i];
+        const Sequence& s = *seqs[i];
+        out.write(reinterpret_cast<const char*>(p.words()),
+                  sizeof(hash_t) * p.words_size());
+        BOOST_FOREACH (const PackedSequence::NRun& run, p.n_runs()) {
+            write_number(out, run.first);
+            write_number(out, run.second);
+        }
+        out << s.name() << s.description();
+        offset = s.name().size() + s.description().size();
+        write_padding(out, offset);
+    }
+    out.close();
+    if (!out) {
+        remove_file(tmp);
+        throw Exception("Error writing file " + filename);
+    }
+    rename_file(tmp, filename);
+}
+
+typedef boost::iostreams::mapped_file_source MappedFile;
+
+static void broken(const std::string& filename) {
+    throw Exception("Broken genome index " + filename);
+}
+
+static void check_range(const MappedFile& file, uint64_t offset,
+                        uint64_t size, const std::string& filename) {
+    if (offset > file.size() || size > file.size() - offset) {
+        broken(filename);
+    }
+}
+
+// size of array of count elements of element_size bytes
+static uint64_t array_size(const MappedFile& file, uint64_t count,
+                           uint64_t element_size,
+                           const std::string& filename) {
+    if (count > file.size() / element_size) {
+        broken(filename);
+    }
+    return count * element_size;
+}
+
+static void check_entry(const MappedFile& file, const uint64_t* entry,
+                        const std::string& filename) {
+    check_range(file, entry[WORDS_OFFSET],
+                array_size(file, entry[WORDS_SIZE], sizeof(hash_t),
+                           filename), filename);
+    check_range(file, entry[RUNS_OFFSET],
+                array_size(file, entry[RUNS_SIZE],
+                           2 * sizeof(uint64_t), filename), filename);
+    check_range(file, entry[TEXT_OFFSET],
+                array_size(file, entry[NAME_LENGTH], 1, filename),
+                filename);
+    check_range(file, entry[TEXT_OFFSET] + entry[NAME_LENGTH],
+                array_size(file, entry[DESCRIPTION_LENGTH], 1, filename),
+                filename);
+    // letters and padding word (PackedSequence::words_size()),
+    // empty sequence may have no words
+    const uint64_t WORD_LETTERS = sizeof(hash_t) * 4;
+    uint64_t seq_size = entry[SEQ_SIZE];
+    uint64_t words = 0;
+    if (seq_size > 0) {
+        words = seq_size / WORD_LETTERS +
+                (seq_size % WORD_LETTERS != 0) + 1;
+    }
+    if (seq_size > uint64_t(std::numeric_limits<pos_t>::max()) ||
+            entry[WORDS_SIZE] < words) {
+        broken(filename);
+    }
+}
+
+// runs of N must be sorted and lie in [0, seq_size]
+static void check_runs(const uint64_t* runs, uint64_t runs_size,
+                       uint64_t seq_size, const std::string& filename) {
+    uint64_t prev_end = 0;
+    for (uint64_t r = 0; r < runs_size; r++) {
+        uint64_t first = runs[2 * r], second = runs[2 * r + 1];
+        if (first < prev_end || first > second || second > seq_size) {
+            broken(filename);
+        }
+        prev_end = second;
+    }
+}
+
+std::vector<SequencePtr> read_genome_index(const std::string& filename) {
+    boost::shared_ptr<MappedFile> file;
+    try {
+        file = boost::make_shared<MappedFile>(filename);
+    } catch (...) {
+        throw Exception("Error opening file " + filename);
+    }
+    const char* data = file->data();
+    const uint64_t* numbers = reinterpret_cast<const uint64_t*>(
+                                  data + sizeof(MAGIC) - 1);
+    check_range(*file, 0, sizeof(MAGIC) - 1 +
+                sizeof(uint64_t) * HEADER_FIELDS, filename);
+    if (memcmp(data, MAGIC, sizeof(MAGIC) - 1) != 0) {
+        throw Exception("Not a genome index " + filename);
+    }
+    if (numbers[0] != BYTE_ORDER_MARK) {
+        throw Exception("Wrong byte order of genome index " +
+                        filename);
+    }
+    uint64_t seqs_number = numbers[1];
+    const uint64_t* table = numbers + HEADER_FIELDS;
+    check_range(*file, reinterpret_cast<const char*>(table) - data,
+                array_size(*file, seqs_number,
+                           sizeof(uint64_t) * ENTRY_FIELDS, filename),
+                filename);
+    std::vector<SequencePtr> result;
+    for (uint64_t i = 0; i < seqs_number; i++) {
+        const uint64_t* entry = table + i * ENTRY_FIELDS;
+        check_entry(*file, entry, filename);
+        const hash_t* words = reinterpret_cast<const hash_t*>(
+                                  data + entry[WORDS_OFFSET]);
+        const uint64_t* runs = reinterpret_cast<const uint64_t*>(
+                                   data + entry[RUNS_OFFSET]);
+        check_runs(runs, entry[RUNS_SIZE], entry[SEQ_SIZE], filename);
+        PackedSequence::NRuns ns;
+        for (uint64_t r = 0; r < entry[RUNS_SIZE]; r++) {
+            ns.push_back(PackedSequence::NRun(runs[2 * r],
+                                              runs[2 * r + 1]));
+        }
+        SequencePtr seq = boost::make_shared<MappedSequence>(
+                              file, words, entry[WORDS_SIZE],
+                              entry[SEQ_SIZE], ns);
+        const char* text = data + entry[TEXT_OFFSET];
+        seq->set_name(std::string(text, entry[NAME_LENGTH]));
+        seq->set_description(std::string(text + entry[NAME_LENGTH],
+                                         entry[DESCRIPTION_LENGTH]));
+        result.push_back(seq);
+    }
+    return result;
+}
+
+}
+
@@ -0,0 +1,47 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_GENOME_INDEX_HPP_
+#define NPGE_GENOME_INDEX_HPP_
+
+#include <string>
+#include <vector>
+
+#include "global.hpp"
+
+namespace npge {
+
+/** Return name of genome index file of fasta file */
+std::string genome_index_name(const std::string& fasta);
+
+/** Return if genome index of fasta file exists and is up to date.
+The index must be modified later than fasta file (see is_newer()).
+*/
+bool has_genome_index(const std::string& fasta);
+
+/** Write genome index file.
+Genome index stores names, descriptions and letters of
+sequences packed as in PackedSequence.
+Words are stored in native byte order, so the file
+is not portable between machines of different endianness.
+The index is written to a temporary file which then replaces
+the file, so existing mappings of old index stay valid.
+*/
+void write_genome_index(const std::vector<SequencePtr>& seqs,
+                        const std::string& filename);
+
+/** Read sequences from genome index file.
+Letters are not read; returned sequences are MappedSequence
+sharing one memory mapping of the file.
+Throws Exception if the file is not a valid genome index.
+*/
+std::vector<SequencePtr> read_genome_index(const std::string& filename);
+
+}
+
+#endif
+
@@ -360,7 +360,9 @@ static luabind::scope register_sequence() {
                value("ASIS_SEQUENCE", ASIS_SEQUENCE),
                value("COMPACT_SEQUENCE", COMPACT_SEQUENCE),
                value("COMPACT_LOW_N_SEQUENCE",
-                     COMPACT_LOW_N_SEQUENCE)
+                     COMPACT_LOW_N_SEQUENCE),
+               value("PACKED_SEQUENCE", PACKED_SEQUENCE),
+               value("MAPPED_SEQUENCE", MAPPED_SEQUENCE)
            ]
            .scope [
                def("new", &new_sequence0),
@@ -563,7 +565,8 @@ static luabind::scope register_alignment_row() {
            class_<AlignmentRow>("AlignmentRow")
            .enum_("Type") [
                value("MAP_ROW", MAP_ROW),
-               value("COMPACT_ROW", COMPACT_ROW)
+               value("COMPACT_ROW", COMPACT_ROW),
+               value("GAP_ROW", GAP_ROW)
            ]
            .scope [
                def("new", &AlignmentRow::new_row),
@@ -605,7 +608,11 @@ static luabind::scope register_block() {
                def("new", &new_block0),
                def("new", &new_block1),
                def("delete", &delete_block),
-               def("deleter", &get_block_deleter)
+               def("deleter", &get_block_deleter),
+               def("set_matrix_cache_limit",
+                   &Block::set_matrix_cache_limit),
+               def("matrix_cache_limit", &Block::matrix_cache_limit),
+               def("matrix_cache_size", &Block::matrix_cache_size)
            ]
            .def("insert", &Block::insert)
            .def("erase", &Block::erase)
@@ -7,8 +7,6 @@
 
 #include <algorithm>
 #include <boost/foreach.hpp>
-#include <boost/tuple/tuple.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 
@@ -56,6 +54,13 @@ typedef std::map<std::string, Block*> Name2Block;
 typedef std::map<BlockSet*, Name2Block> Bs2Name2Block;
 typedef std::map<std::string, SequencePtr> Name2Seq;
 
+// letters of fragments by (min_pos, max_pos), for sequences
+// which are built from fragments
+typedef std::pair<int, int> MinMax;
+typedef std::map<MinMax, std::string> TraceParts;
+typedef std::map<Sequence*, TraceParts> S2FV;
+typedef S2FV::value_type SItem;
+
 struct BSFRImpl {
     Name2BlockSet name2block_set_;
     Name2Seq name2seq_;
@@ -64,10 +69,14 @@ struct BSFRImpl {
     SequenceType seq_type_;
     int workers_;
     bool unknown_bs_allowed_;
+    size_t batch_size_;
+    Bs2Name2Block blocks_;
+    S2FV trace_;
 
     BSFRImpl():
         workers_(1),
-        unknown_bs_allowed_(true) {
+        unknown_bs_allowed_(true),
+        batch_size_(0) {
     }
 };
 
@@ -133,6 +142,14 @@ void BlockSetFastaReader::set_workers(int workers) {
     impl_->workers_ = workers;
 }
 
+size_t BlockSetFastaReader::batch_size() const {
+    return impl_->batch_size_;
+}
+
+void BlockSetFastaReader::set_batch_size(size_t batch_size) {
+    impl_->batch_size_ = batch_size;
+}
+
 // fasta reader
 
 struct FastaValue {
@@ -162,7 +179,19 @@ public:
         FastaReader(input),
         sequences_(sequences),
         fragments_(fragments),
-        v_(0) {
+        v_(0), size_(0) {
+    }
+
+    /** Read sequences until their size reaches batch_size.
+    Return false if the input is over.
+    */
+    bool read_batch(size_t batch_size) {
+        size_ = 0;
+        bool result = false;
+        while (size_ < batch_size && read_one_sequence()) {
+            result = true;
+        }
+        return result;
     }
 
     void new_sequence(const std::string& name,
@@ -177,10 +206,18 @@ public:
     void grow_sequence(const std::string& data) {
         ASSERT_TRUE(v_);
         v_->data_ += data;
+        size_ += data.size();
+    }
+
+    void grow_sequence_view(const char* data, size_t size) {
+        ASSERT_TRUE(v_);
+        v_->data_.append(data, size);
+        size_ += size;
     }
 
 private:
     FastaValue* v_;
+    size_t size_;
 };
 
 // find blocksets list by fasta description
@@ -338,6 +375,13 @@ static void add_sequences(const FastaMap& sequences,
         const std::string& name = item.first;
         const FastaValue& v = item.second;
         const SequencePtr& s = v.s_;
+        Name2Seq::const_iterator it = name2seq.find(name);
+        if (it != name2seq.end() &&
+                impl->trace_.find(it->second.get()) !=
+                impl->trace_.end()) {
+            throw Exception("Sequence " + name + " follows "
+                            "its fragments in a previous batch");
+        }
         BOOST_FOREACH (BlockSet* bs, v.bss_) {
             bs->add_sequence(s);
         }
@@ -428,6 +472,16 @@ public:
                 f->set_row(row);
             }
         }
+        if (s->size() > 0) {
+            // free the record
+            std::string().swap(v.data_);
+        } else {
+            // keep letters for SequenceTrace
+            Sequence::to_atgcn(v.data_);
+            if (f->ori() == -1) {
+                complement(v.data_);
+            }
+        }
     }
 
 private:
@@ -457,7 +511,7 @@ static Block* get_block(const std::string& name,
 
 static void add_blocks(FastaMap& fragments,
                        BSFRImpl* impl) {
-    Bs2Name2Block b2;
+    Bs2Name2Block& b2 = impl->blocks_;
     BOOST_FOREACH (FastaItem& item, fragments) {
         FastaValue& v = item.second;
         Fragment*& f = v.f_;
@@ -481,10 +535,6 @@ static void add_blocks(FastaMap& fragments,
 
 // sequences from fragments
 
-typedef std::vector<FastaValue*> FastaValues;
-typedef std::map<Sequence*, FastaValues> S2FV;
-typedef S2FV::value_type SItem;
-
 static void make_s2fv(S2FV& result,
                       FastaMap& fragments) {
     BOOST_FOREACH (FastaItem& item, fragments) {
@@ -494,7 +544,11 @@ static void make_s2fv(S2FV& result,
             Sequence* s = f->seq();
             ASSERT_TRUE(s);
             if (s->size() == 0) {
-                result[s].push_back(&v);
+                TraceParts& parts = result[s];
+                MinMax key(f->min_pos(), f->max_pos());
+                if (parts.find(key) == parts.end()) {
+                    parts[key].swap(v.data_);
+                }
             }
         }
     }
@@ -513,17 +567,6 @@ public:
     ThreadTask* create_task_impl(ThreadWorker* worker);
 };
 
-// FIXME DRY
-struct SimpleFragmentCmp {
-    bool operator()(FastaValue* x, FastaValue* y) {
-        Fragment* a = x->f_;
-        Fragment* b = y->f_;
-        typedef boost::tuple<int, int> Tie;
-        return Tie(a->min_pos(), a->max_pos()) <
-               Tie(b->min_pos(), b->max_pos());
-    }
-};
-
 class SequenceTrace : public ThreadTask {
 public:
     SequenceTrace(SItem* item, ThreadWorker* worker):
@@ -532,37 +575,32 @@ public:
 
     void run_impl() {
         Sequence* s = item_->first;
-        FastaValues& values = item_->second;
-        // sort
-        std::sort(values.begin(), values.end(),
-                  SimpleFragmentCmp());
-        // grow string
+        TraceParts& parts = item_->second;
+        // grow string, parts are sorted by (min_pos, max_pos)
         std::string data;
-        BOOST_FOREACH (FastaValue* v, values) {
-            Fragment* f = v->f_;
-            ASSERT_EQ(f->seq(), s);
-            if (f->max_pos() < data.size()) {
+        BOOST_FOREACH (TraceParts::value_type& part, parts) {
+            int min_pos = part.first.first;
+            int max_pos = part.first.second;
+            std::string& d = part.second;
+            if (max_pos < data.size()) {
+                std::string().swap(d);
                 continue;
             }
-            std::string& d = v->data_;
-            Sequence::to_atgcn(d);
-            if (f->ori() == -1) {
-                complement(d);
-            }
-            if (f->min_pos() > data.size()) {
+            if (min_pos > data.size()) {
                 // gap
-                int gap_length = f->min_pos() - data.size();
+                int gap_length = min_pos - data.size();
                 std::string gap(gap_length, 'N');
                 data += gap;
             }
-            const char* part = d.c_str();
-            if (f->min_pos() < data.size()) {
-                int overlap = data.size() - f->min_pos();
+            const char* part_begin = d.c_str();
+            if (min_pos < data.size()) {
+                int overlap = data.size() - min_pos;
                 ASSERT_LT(overlap, d.size());
-                part += overlap;
+                part_begin += overlap;
             }
-            data += part;
-            ASSERT_EQ(data.length(), f->max_pos() + 1);
+            data += part_begin;
+            ASSERT_EQ(data.length(), max_pos + 1);
+            std::string().swap(d);
         }
         // set sequence
         s->read_from_string(data);
@@ -584,39 +622,59 @@ ThreadTask* S2TG::create_task_impl(ThreadWorker* worker) {
 
 // main function
 
-void BlockSetFastaReader::run() {
-    FastaMap sequences, fragments;
-    BOOST_FOREACH (std::istream* input, impl_->inputs_) {
-        SimpleReader reader(*input, sequences, fragments);
-        reader.read_all_sequences();
-    }
+static void process_batch(FastaMap& sequences, FastaMap& fragments,
+                          BSFRImpl* impl) {
     {
-        BSTG bstg(sequences, impl_);
+        BSTG bstg(sequences, impl);
         bstg.perform();
     }
     {
-        BSTG bstg(fragments, impl_);
+        BSTG bstg(fragments, impl);
         bstg.perform();
     }
     {
-        STG stg(sequences, impl_);
+        STG stg(sequences, impl);
         stg.perform();
     }
-    add_sequences(sequences, impl_);
+    add_sequences(sequences, impl);
     sequences.clear();
-    add_sequences_from_fragments(fragments, impl_);
+    add_sequences_from_fragments(fragments, impl);
     {
-        FTG ftg(fragments, impl_);
+        FTG ftg(fragments, impl);
         ftg.perform();
     }
-    add_blocks(fragments, impl_);
-    S2FV s2fv;
-    make_s2fv(s2fv, fragments);
+    add_blocks(fragments, impl);
+    make_s2fv(impl->trace_, fragments);
+    fragments.clear();
+}
+
+void BlockSetFastaReader::run() {
+    FastaMap sequences, fragments;
+    BOOST_FOREACH (std::istream* input, impl_->inputs_) {
+        SimpleReader reader(*input, sequences, fragments);
+        reader.set_workers(impl_->workers_);
+        if (impl_->batch_size_ == 0) {
+            reader.read_all_sequences();
+        } else {
+            while (reader.read_batch(impl_->batch_size_)) {
+                process_batch(sequences, fragments, impl_);
+            }
+        }
+    }
+    process_batch(sequences, fragments, impl_);
     {
-        S2TG s2tg(s2fv, impl_);
+        S2TG s2tg(impl_->trace_, impl_);
         s2tg.perform();
     }
+    impl_->trace_.clear();
+    // equal rows of blocks share memory
+    BOOST_FOREACH (Bs2Name2Block::value_type& bs_blocks, impl_->blocks_) {
+        BOOST_FOREACH (Name2Block::value_type& name_block,
+                      bs_blocks.second) {
+            name_block.second->share_rows();
+        }
+    }
+    impl_->blocks_.clear();
 }
 
 }
-
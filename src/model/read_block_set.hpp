@@ -58,6 +58,22 @@ public:
     /** Set number of workers */
     void set_workers(int workers);
 
+    /** Return size of records (bytes) processed at once */
+    size_t batch_size() const;
+
+    /** Set size of records (bytes) processed at once.
+    If batch_size is 0 (default), all inputs are read first.
+    Otherwise sequences, fragments and rows are created
+    after each batch of records and the records are freed.
+    Letters of fragments of sequences which are built from
+    fragments are kept until the end (one copy per range),
+    so peak memory is about batch_size plus the size of
+    such sequences (times their coverage by distinct fragments).
+    In this mode a sequence must precede its fragments
+    unless they are in the same batch.
+    */
+    void set_batch_size(size_t batch_size);
+
     /** Run the reader */
     void run();
 
@@ -0,0 +1,180 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstdlib>
+#include <string>
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "AlignmentMatrix.hpp"
+#include "Block.hpp"
+#include "Fragment.hpp"
+#include "AlignmentRow.hpp"
+#include "Sequence.hpp"
+#include "block_stat.hpp"
+#include "char_to_size.hpp"
+
+// enables cache of matrices of blocks
+struct MatrixCache {
+    size_t old_limit_;
+
+    MatrixCache(size_t limit = 100000000):
+        old_limit_(npge::Block::matrix_cache_limit()) {
+        npge::Block::set_matrix_cache_limit(limit);
+    }
+
+    ~MatrixCache() {
+        npge::Block::set_matrix_cache_limit(old_limit_);
+    }
+};
+
+static void check_matrix(const npge::AlignmentMatrix* matrix,
+                         const npge::Block* block) {
+    using namespace npge;
+    BOOST_REQUIRE(matrix->rows() == block->size());
+    BOOST_REQUIRE(matrix->columns() == block->alignment_length());
+    for (int col = 0; col < matrix->columns(); col++) {
+        int row = 0;
+        BOOST_FOREACH (const Fragment* f, *block) {
+            BOOST_CHECK(matrix->at(row, col) == f->alignment_at(col));
+            row += 1;
+        }
+        bool ident1, gap1, pure_gap1, ident2, gap2, pure_gap2;
+        int atgc1[LETTERS_NUMBER] = {0, 0, 0, 0, 0};
+        int atgc2[LETTERS_NUMBER] = {0, 0, 0, 0, 0};
+        test_column(block, col, ident1, gap1, pure_gap1, atgc1);
+        matrix->test_column(col, ident2, gap2, pure_gap2, atgc2);
+        BOOST_CHECK(ident1 == ident2);
+        BOOST_CHECK(gap1 == gap2);
+        BOOST_CHECK(pure_gap1 == pure_gap2);
+        for (int i = 0; i < LETTERS_NUMBER; i++) {
+            BOOST_CHECK(atgc1[i] == atgc2[i]);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (AlignmentMatrix_random) {
+    using namespace npge;
+    MatrixCache cache;
+    std::srand(3);
+    for (int i = 0; i < 20; i++) {
+        int length = std::rand() % 50 + 1;
+        std::string text;
+        for (int j = 0; j < length; j++) {
+            text += "ATGCN"[std::rand() % (std::rand() % 2 ? 1 : 5)];
+        }
+        SequencePtr seq = boost::make_shared<InMemorySequence>(text);
+        Block block;
+        // several words per column
+        int rows = std::rand() % 20 + 1;
+        for (int r = 0; r < rows; r++) {
+            std::string row;
+            int pos = 0;
+            while (row.size() < length + 5) {
+                if (pos < length && std::rand() % 3) {
+                    row += text[pos];
+                    pos += 1;
+                } else {
+                    row += '-';
+                }
+            }
+            if (pos == 0) {
+                continue;
+            }
+            Fragment* f = new Fragment(seq, 0, pos - 1, 1);
+            new CompactAlignmentRow(row, f);
+            block.insert(f);
+        }
+        check_matrix(block.matrix(), &block);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (AlignmentMatrix_drop) {
+    using namespace npge;
+    MatrixCache cache;
+    SequencePtr seq = boost::make_shared<InMemorySequence>("ATGCATGC");
+    Block block;
+    Fragment* f1 = new Fragment(seq, 0, 3, 1);
+    new CompactAlignmentRow("AT-GC", f1);
+    block.insert(f1);
+    Fragment* f2 = new Fragment(seq, 4, 7, 1);
+    new CompactAlignmentRow("ATG-C", f2);
+    block.insert(f2);
+    const AlignmentMatrix* matrix = block.matrix();
+    BOOST_CHECK(block.matrix() == matrix);
+    check_matrix(matrix, &block);
+    // changes of rows
+    f2->set_row(new CompactAlignmentRow("AT-GC", f2));
+    check_matrix(block.matrix(), &block);
+    bool ident, gap, pure_gap;
+    block.matrix()->test_column(2, ident, gap, pure_gap, 0);
+    BOOST_CHECK(ident && gap && pure_gap);
+    f2->row()->clear();
+    f2->row()->grow("ATG-C");
+    check_matrix(block.matrix(), &block);
+    // changes of fragments
+    f1->inverse();
+    check_matrix(block.matrix(), &block);
+    f1->set_min_pos(1);
+    f1->set_row(0);
+    f2->set_row(0);
+    check_matrix(block.matrix(), &block);
+    // changes of block
+    Fragment* f3 = new Fragment(seq, 2, 5, -1);
+    block.insert(f3);
+    check_matrix(block.matrix(), &block);
+    block.erase(f1);
+    check_matrix(block.matrix(), &block);
+    block.clear();
+    BOOST_CHECK(block.matrix()->rows() == 0);
+}
+
+BOOST_AUTO_TEST_CASE (AlignmentMatrix_weak) {
+    using namespace npge;
+    MatrixCache cache;
+    SequencePtr seq = boost::make_shared<InMemorySequence>("ATGCATGC");
+    Block block;
+    Fragment* f1 = new Fragment(seq, 0, 3, 1);
+    block.insert(f1);
+    Block weak;
+    weak.set_weak(true);
+    weak.insert(f1);
+    AlignmentMatrix local;
+    const AlignmentMatrix* matrix = block_matrix(&weak, local);
+    BOOST_CHECK(matrix == &local);
+    check_matrix(matrix, &weak);
+    BOOST_CHECK(block_matrix(&block, local) == block.matrix());
+}
+
+BOOST_AUTO_TEST_CASE (AlignmentMatrix_cache_limit) {
+    using namespace npge;
+    SequencePtr seq = boost::make_shared<InMemorySequence>("ATGCATGC");
+    Block block;
+    Fragment* f1 = new Fragment(seq, 0, 3, 1);
+    new CompactAlignmentRow("AT-GC", f1);
+    block.insert(f1);
+    Fragment* f2 = new Fragment(seq, 4, 7, 1);
+    new CompactAlignmentRow("ATG-C", f2);
+    block.insert(f2);
+    size_t size = Block::matrix_cache_size();
+    // disabled cache
+    MatrixCache disabled(0);
+    BOOST_CHECK(block.matrix() == 0);
+    AlignmentMatrix local;
+    BOOST_CHECK(block_matrix(&block, local) == &local);
+    check_matrix(&local, &block);
+    // too small cache
+    MatrixCache small(AlignmentMatrix::memory(2, 5) - 1);
+    BOOST_CHECK(block.matrix() == 0);
+    MatrixCache enough(size + AlignmentMatrix::memory(2, 5));
+    const AlignmentMatrix* matrix = block.matrix();
+    BOOST_REQUIRE(matrix);
+    BOOST_CHECK(matrix->memory() == AlignmentMatrix::memory(2, 5));
+    BOOST_CHECK(Block::matrix_cache_size() == size + matrix->memory());
+    block.drop_matrix();
+    BOOST_CHECK(Block::matrix_cache_size() == size);
+}
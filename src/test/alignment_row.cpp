@@ -5,6 +5,8 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <cstdlib>
+#include <vector>
 #include <sstream>
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -174,3 +176,149 @@ BOOST_AUTO_TEST_CASE (AlignmentRow_InversedRow) {
     BOOST_CHECK(f->str() == "CAT-T");
 }
 
+
+static void check_same_rows(const npge::AlignmentRow* a,
+                            const npge::AlignmentRow* b) {
+    BOOST_REQUIRE(a->length() == b->length());
+    for (int pos = -2; pos < a->length() + 2; pos++) {
+        BOOST_CHECK(a->map_to_fragment(pos) == b->map_to_fragment(pos));
+        BOOST_CHECK(a->map_to_alignment(pos) == b->map_to_alignment(pos));
+        BOOST_CHECK(a->nearest_in_fragment(pos) ==
+                    b->nearest_in_fragment(pos));
+    }
+    int start = -2, stop = a->length() + 2;
+    std::vector<int> a_positions(stop - start), b_positions(stop - start);
+    a->fragment_positions(start, stop, &a_positions[0]);
+    b->fragment_positions(start, stop, &b_positions[0]);
+    for (int pos = start; pos < stop; pos++) {
+        BOOST_CHECK(a_positions[pos - start] == a->map_to_fragment(pos));
+        BOOST_CHECK(b_positions[pos - start] == b->map_to_fragment(pos));
+    }
+    if (a->length() >= 3) {
+        // part of row
+        int part_start = 1, part_stop = a->length() - 1;
+        b->fragment_positions(part_start, part_stop, &b_positions[0]);
+        for (int pos = part_start; pos < part_stop; pos++) {
+            BOOST_CHECK(b_positions[pos - part_start] ==
+                        a->map_to_fragment(pos));
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (GapAlignmentRow_random) {
+    using namespace npge;
+    std::srand(1);
+    for (int i = 0; i < 50; i++) {
+        std::string alignment;
+        int length = std::rand() % 40 + 1;
+        for (int j = 0; j < length; j++) {
+            alignment += (std::rand() % 3 == 0) ? '-' : 'A';
+        }
+        MapAlignmentRow map_row(alignment);
+        GapAlignmentRow gap_row(alignment);
+        BOOST_CHECK(gap_row.type() == GAP_ROW);
+        check_same_rows(&map_row, &gap_row);
+        boost::scoped_ptr<AlignmentRow> clone((gap_row.clone()));
+        check_same_rows(&map_row, clone.get());
+        int start = std::rand() % length;
+        int stop = std::rand() % length;
+        boost::scoped_ptr<AlignmentRow> map_slice((map_row.slice(start,
+                stop)));
+        boost::scoped_ptr<AlignmentRow> gap_slice((gap_row.slice(start,
+                stop)));
+        BOOST_CHECK(gap_slice->type() == GAP_ROW);
+        check_same_rows(map_slice.get(), gap_slice.get());
+    }
+}
+
+BOOST_AUTO_TEST_CASE (GapAlignmentRow_bind_backward) {
+    using namespace npge;
+    GapAlignmentRow row;
+    row.set_length(10);
+    row.bind(0, 9);
+    row.bind(0, 2);
+    row.bind(0, 5);
+    row.bind(0, 0);
+    row.bind(0, 5);
+    BOOST_CHECK(row.map_to_fragment(0) == 0);
+    BOOST_CHECK(row.map_to_fragment(1) == -1);
+    BOOST_CHECK(row.map_to_fragment(2) == 1);
+    BOOST_CHECK(row.map_to_fragment(5) == 2);
+    BOOST_CHECK(row.map_to_fragment(9) == 3);
+    BOOST_CHECK(row.map_to_alignment(3) == 9);
+    BOOST_CHECK(row.nearest_in_fragment(7) == 2);
+    BOOST_CHECK(row.nearest_in_fragment(8) == 3);
+}
+
+BOOST_AUTO_TEST_CASE (CompactAlignmentRow_random) {
+    using namespace npge;
+    std::srand(2);
+    for (int i = 0; i < 50; i++) {
+        // long runs of gaps produce chunks without letters
+        std::string alignment;
+        int runs = std::rand() % 20 + 1;
+        for (int j = 0; j < runs; j++) {
+            char c = (std::rand() % 2 == 0) ? '-' : 'A';
+            alignment += std::string(std::rand() % 70 + 1, c);
+        }
+        MapAlignmentRow map_row(alignment);
+        CompactAlignmentRow compact_row(alignment);
+        check_same_rows(&map_row, &compact_row);
+        std::vector<CAR_Bitset> bitsets;
+        compact_row.bitsets(bitsets);
+        CompactAlignmentRow copy;
+        copy.set_bitsets(bitsets, compact_row.length());
+        check_same_rows(&map_row, &copy);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (CompactAlignmentRow_bind_backward) {
+    using namespace npge;
+    CompactAlignmentRow row;
+    row.set_length(100);
+    row.bind(0, 99);
+    row.bind(0, 2);
+    row.bind(0, 40);
+    row.bind(0, 0);
+    row.bind(0, 40);
+    BOOST_CHECK(row.map_to_fragment(0) == 0);
+    BOOST_CHECK(row.map_to_fragment(1) == -1);
+    BOOST_CHECK(row.map_to_fragment(2) == 1);
+    BOOST_CHECK(row.map_to_fragment(40) == 2);
+    BOOST_CHECK(row.map_to_fragment(99) == 3);
+    BOOST_CHECK(row.map_to_alignment(2) == 40);
+    BOOST_CHECK(row.map_to_alignment(3) == 99);
+    BOOST_CHECK(row.map_to_alignment(4) == -1);
+    BOOST_CHECK(row.nearest_in_fragment(69) == 2);
+    BOOST_CHECK(row.nearest_in_fragment(70) == 3);
+}
+
+BOOST_AUTO_TEST_CASE (CompactAlignmentRow_share) {
+    using namespace npge;
+    CompactAlignmentRow row("AT-GC--A");
+    boost::scoped_ptr<AlignmentRow> copy(row.clone());
+    check_same_rows(&row, copy.get());
+    // change of copy does not affect source
+    copy->bind(3, 5);
+    BOOST_CHECK(copy->map_to_fragment(5) == 4);
+    BOOST_CHECK(row.map_to_fragment(5) == -1);
+    BOOST_CHECK(row.map_to_alignment(4) == 7);
+    copy->grow("AAA");
+    BOOST_CHECK(copy->length() == 11);
+    BOOST_CHECK(row.length() == 8);
+    // share equal rows
+    CompactAlignmentRow other("AT-GC--A");
+    BOOST_CHECK(other.share(row));
+    BOOST_CHECK(!other.share(other));
+    check_same_rows(&row, &other);
+    other.bind(6, 6);
+    BOOST_CHECK(other.map_to_fragment(6) == 4);
+    BOOST_CHECK(row.map_to_fragment(6) == -1);
+    // different rows
+    CompactAlignmentRow different("A-TGC--A");
+    BOOST_CHECK(!different.share(row));
+    CompactAlignmentRow longer("AT-GC--A-");
+    BOOST_CHECK(!longer.share(row));
+    MapAlignmentRow map_row("AT-GC--A");
+    BOOST_CHECK(!map_row.share(row));
+}
@@ -5,6 +5,8 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <set>
+
 #include <boost/test/unit_test.hpp>
 #include <boost/bind.hpp>
 #include <boost/foreach.hpp>
@@ -14,6 +16,9 @@
 #include "Block.hpp"
 #include "BlockSet.hpp"
 #include "AnchorFinder.hpp"
+#include "temp_file.hpp"
+#include "name_to_stream.hpp"
+#include "Exception.hpp"
 
 BOOST_AUTO_TEST_CASE (AnchorFinder_main) {
     using namespace npge;
@@ -31,6 +36,143 @@ BOOST_AUTO_TEST_CASE (AnchorFinder_main) {
     }
 }
 
+BOOST_AUTO_TEST_CASE (AnchorFinder_packed) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<PackedSequence>("tgGTCCGagCGGACggcc");
+    BlockSetPtr block_set = new_bs();
+    block_set->add_sequence(s1);
+    AnchorFinder anchor_finder;
+    anchor_finder.set_block_set(block_set);
+    anchor_finder.set_opt_value("anchor-size", 5);
+    anchor_finder.run();
+    BOOST_WARN(block_set->size() == 1);
+    if (block_set->size() == 1) {
+        Fragment* f = block_set->front()->front();
+        BOOST_CHECK(f->str() == "GTCCG" || f->str() == "CGGAC");
+    }
+}
+
+BOOST_AUTO_TEST_CASE (AnchorFinder_wide) {
+    using namespace npge;
+    std::string repeat("GTCCGAGCGGACGGCCTGATCCTCGATTAACAGTTTGGCCTGTTCC");
+    std::string s = "tg" + repeat + "ac" + repeat + "gc";
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(s);
+    BlockSetPtr block_set = new_bs();
+    block_set->add_sequence(s1);
+    AnchorFinder anchor_finder;
+    anchor_finder.set_block_set(block_set);
+    anchor_finder.set_opt_value("anchor-size", 40);
+    anchor_finder.set_opt_value("anchor-similar", false);
+    anchor_finder.run();
+    BOOST_CHECK(block_set->size() == repeat.size() - 40 + 1);
+    BOOST_FOREACH (Block* block, *block_set) {
+        BOOST_CHECK(block->size() == 2);
+        BOOST_CHECK(block->alignment_length() == 40);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (AnchorFinder_minimizer) {
+    using namespace npge;
+    std::string repeat("GTCCGAGCGGACGGCCTGATCCTCGATTAACAGTTTGGCCTGTTCC");
+    std::string s = "tg" + repeat + "ac" + repeat + "gc";
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(s);
+    BlockSetPtr block_set = new_bs();
+    block_set->add_sequence(s1);
+    AnchorFinder anchor_finder;
+    anchor_finder.set_block_set(block_set);
+    anchor_finder.set_opt_value("anchor-size", 11);
+    anchor_finder.set_opt_value("anchor-similar", false);
+    anchor_finder.set_opt_value("anchor-sampling", std::string("minimizer"));
+    anchor_finder.set_opt_value("anchor-window", 5);
+    anchor_finder.run();
+    BOOST_CHECK(block_set->size() >= 1);
+    BOOST_CHECK(block_set->size() < repeat.size() - 11 + 1);
+    BOOST_FOREACH (Block* block, *block_set) {
+        BOOST_CHECK(block->size() == 2);
+        BOOST_CHECK(block->alignment_length() == 11);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (AnchorFinder_exact_count) {
+    using namespace npge;
+    std::string r3("GTCCGAGCGGACGGCCTGATCC");
+    std::string r2("TCGATTAACAGTTTGGCCTGTT");
+    std::string s = "tg" + r3 + "aa" + r3 + "gt" + r3 + "cg" +
+                    r2 + "ta" + r2 + "ag";
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(s);
+    BlockSetPtr block_set = new_bs();
+    block_set->add_sequence(s1);
+    AnchorFinder anchor_finder;
+    anchor_finder.set_block_set(block_set);
+    anchor_finder.set_opt_value("anchor-size", 11);
+    anchor_finder.set_opt_value("anchor-exact-count", true);
+    anchor_finder.run();
+    BOOST_CHECK(block_set->size() == 2);
+    std::set<int> sizes;
+    BOOST_FOREACH (Block* block, *block_set) {
+        sizes.insert(block->size());
+    }
+    BOOST_CHECK(sizes.count(2) && sizes.count(3));
+    BlockSetPtr block_set2 = new_bs();
+    block_set2->add_sequence(s1);
+    AnchorFinder anchor_finder2;
+    anchor_finder2.set_block_set(block_set2);
+    anchor_finder2.set_opt_value("anchor-size", 11);
+    anchor_finder2.set_opt_value("anchor-exact-count", true);
+    anchor_finder2.set_opt_value("anchor-max-count", 2);
+    anchor_finder2.run();
+    BOOST_CHECK(block_set2->size() == 1);
+    BOOST_FOREACH (Block* block, *block_set2) {
+        BOOST_CHECK(block->size() == 2);
+    }
+    anchor_finder2.set_opt_value("anchor-max-count", 0);
+    anchor_finder2.set_opt_value("anchor-min-count", 3);
+    anchor_finder2.run();
+    BOOST_CHECK(block_set2->size() == 2);
+    BOOST_FOREACH (Block* block, *block_set2) {
+        BOOST_CHECK(block->size() == 2 || block->size() == 3);
+    }
+}
+
+BOOST_AUTO_TEST_CASE (AnchorFinder_used_file) {
+    using namespace npge;
+    std::string used_file = temp_file();
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tgGTCCGagCGGACggcc");
+    BlockSetPtr block_set = new_bs();
+    block_set->add_sequence(s1);
+    AnchorFinder anchor_finder;
+    anchor_finder.set_block_set(block_set);
+    anchor_finder.set_opt_value("anchor-size", 5);
+    anchor_finder.set_opt_value("anchor-used-file", used_file);
+    anchor_finder.run();
+    BOOST_REQUIRE(block_set->size() == 1);
+    block_set->clear_blocks();
+    // resumed pipeline
+    AnchorFinder anchor_finder2;
+    anchor_finder2.set_block_set(block_set);
+    anchor_finder2.set_opt_value("anchor-size", 5);
+    anchor_finder2.set_opt_value("anchor-used-file", used_file);
+    anchor_finder2.run();
+    BOOST_CHECK(block_set->size() == 0);
+    BOOST_CHECK(!file_exists(used_file + ".tmp"));
+    // other anchor size
+    AnchorFinder anchor_finder3;
+    anchor_finder3.set_block_set(block_set);
+    anchor_finder3.set_opt_value("anchor-size", 6);
+    anchor_finder3.set_opt_value("anchor-used-file", used_file);
+    BOOST_CHECK_THROW(anchor_finder3.run(), Exception);
+    // other sequences
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("ATGCATGC");
+    s2->set_name("s2");
+    block_set->add_sequence(s2);
+    AnchorFinder anchor_finder4;
+    anchor_finder4.set_block_set(block_set);
+    anchor_finder4.set_opt_value("anchor-size", 5);
+    anchor_finder4.set_opt_value("anchor-used-file", used_file);
+    BOOST_CHECK_THROW(anchor_finder4.run(), Exception);
+    remove_file(used_file);
+}
+
 BOOST_AUTO_TEST_CASE (AnchorFinder_n_negative) {
     using namespace npge;
     SequencePtr s1 = boost::make_shared<InMemorySequence>("tgGTNCGagCGNACggcc");
@@ -17,6 +17,7 @@
 #include "Fragment.hpp"
 #include "AlignmentRow.hpp"
 #include "Block.hpp"
+#include "BlockSet.hpp"
 #include "Joiner.hpp"
 #include "block_stat.hpp"
 #include "char_to_size.hpp"
@@ -625,3 +626,116 @@ BOOST_AUTO_TEST_CASE (Block_hash) {
     BOOST_CHECK(block_hash(b1.get()) == block_hash(b2.get()));
 }
 
+
+BOOST_AUTO_TEST_CASE (Block_hash_fragments) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("GaGaGaGaG");
+    s1->set_name("s1");
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("GaGaGaGaG");
+    s2->set_name("s2");
+    Block b1, b2, b3, b4;
+    b1.insert(new Fragment(s1, 0, 4, 1));
+    b1.insert(new Fragment(s2, 2, 6, -1));
+    b2.insert(new Fragment(s2, 2, 6, -1));
+    b2.insert(new Fragment(s1, 0, 4, 1));
+    BOOST_CHECK(block_hash(&b1) == block_hash(&b2));
+    b3.insert(new Fragment(s1, 0, 4, 1));
+    b3.insert(new Fragment(s2, 2, 6, 1));
+    BOOST_CHECK(block_hash(&b1) != block_hash(&b3));
+    b4.insert(new Fragment(s1, 0, 4, 1));
+    b4.insert(new Fragment(s1, 2, 6, -1));
+    BOOST_CHECK(block_hash(&b1) != block_hash(&b4));
+    BOOST_CHECK(b1.front()->ori() == 1);
+}
+
+BOOST_AUTO_TEST_CASE (Block_blockset_hash) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("GaGaGaGaG");
+    s1->set_name("s1");
+    BlockSet bs;
+    for (int i = 0; i < 1000; i++) {
+        Block* block = new Block;
+        block->insert(new Fragment(s1, i, i + 1, 1));
+        block->insert(new Fragment(s1, i + 2, i + 3, -1));
+        bs.insert(block);
+    }
+    hash_t hash = blockset_hash(bs);
+    BOOST_CHECK(blockset_hash(bs, 4) == hash);
+    Block* single = new Block;
+    single->insert(new Fragment(s1, 0, 1, 1));
+    bs.insert(single);
+    BOOST_CHECK(blockset_hash(bs, 4) == hash);
+    bs.erase(bs.front());
+    BOOST_CHECK(blockset_hash(bs, 4) != hash);
+}
+
+BOOST_AUTO_TEST_CASE (Block_test_columns) {
+    using namespace npge;
+    // long enough to be split into several tiles
+    std::string text;
+    for (int i = 0; i < 300; i++) {
+        text += "ACGT"[(i * 7 + i / 5) % 4];
+    }
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(text);
+    Block block;
+    Fragment* f1 = new Fragment(s1, 0, 299, 1);
+    new CompactAlignmentRow(text, f1);
+    block.insert(f1);
+    std::string text2 = text;
+    text2[100] = (text[100] == 'A') ? 'C' : 'A';
+    text2[280] = (text[280] == 'A') ? 'C' : 'A';
+    SequencePtr s2 = boost::make_shared<InMemorySequence>(text2);
+    Fragment* f2 = new Fragment(s2, 10, 299, 1);
+    new CompactAlignmentRow(std::string(10, '-') + text2.substr(10), f2);
+    block.insert(f2);
+    int length = block.alignment_length();
+    BOOST_REQUIRE(length == 300);
+    std::vector<bool> ident, gap;
+    test_columns(&block, ident, gap);
+    BOOST_REQUIRE(ident.size() == length);
+    for (int col = 0; col < length; col++) {
+        bool i, g;
+        test_column(&block, col, i, g);
+        BOOST_CHECK(ident[col] == i);
+        BOOST_CHECK(gap[col] == g);
+    }
+    test_columns(&block, ident, gap, 5, 260);
+    BOOST_REQUIRE(ident.size() == 256);
+    BOOST_CHECK(gap[0]);
+    BOOST_CHECK(!gap[5]);
+    BOOST_CHECK(!ident[95]);
+    BOOST_CHECK(ident[96]);
+    std::string consensus = block.consensus_string();
+    for (int col = 0; col < length; col++) {
+        BOOST_CHECK(consensus[col] == block.consensus_char(col));
+    }
+}
+
+BOOST_AUTO_TEST_CASE (Block_share_rows) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("ATGCATGCATG");
+    Block block;
+    Fragment* f1 = new Fragment(s1, 0, 2, 1);
+    new CompactAlignmentRow("AT-G", f1);
+    Fragment* f2 = new Fragment(s1, 4, 6, 1);
+    new CompactAlignmentRow("AT-G", f2);
+    Fragment* f3 = new Fragment(s1, 7, 9, -1);
+    new CompactAlignmentRow("A-TG", f3);
+    Fragment* f4 = new Fragment(s1, 8, 10, 1);
+    new CompactAlignmentRow("AT-G", f4);
+    block.insert(f1);
+    block.insert(f2);
+    block.insert(f3);
+    block.insert(f4);
+    BOOST_CHECK(block.share_rows() == 2);
+    BOOST_CHECK(block.share_rows() == 2);
+    BOOST_CHECK(block.consensus_string() == "ATTG");
+    // change of shared row does not affect other rows
+    f2->row()->bind(1, 2);
+    BOOST_CHECK(f2->row()->map_to_fragment(2) == 2);
+    BOOST_CHECK(f1->row()->map_to_fragment(2) == -1);
+    BOOST_CHECK(f4->row()->map_to_fragment(2) == -1);
+    BOOST_CHECK(f4->alignment_at(3) == 'G');
+    boost::scoped_ptr<Block> copy(block.clone());
+    BOOST_CHECK(copy->consensus_string() == block.consensus_string());
+}
@@ -62,3 +62,65 @@ BOOST_AUTO_TEST_CASE (BlockSet_filter) {
     BOOST_CHECK(block_set->size() == 1);
 }
 
+
+BOOST_AUTO_TEST_CASE (BlockSet_find_block) {
+    using namespace npge;
+    BlockSetPtr block_set = new_bs();
+    Block* b1 = new Block("b1");
+    Block* b2 = new Block("b2");
+    Block* b3 = new Block("b3");
+    block_set->insert(b1);
+    block_set->insert(b2);
+    BOOST_CHECK(block_set->find_block("b1") == b1);
+    BOOST_CHECK(block_set->find_block("b2") == b2);
+    BOOST_CHECK(block_set->find_block("b3") == 0);
+    block_set->insert(b3);
+    BOOST_CHECK(block_set->find_block("b3") == b3);
+    block_set->detach(b1);
+    BOOST_CHECK(block_set->find_block("b1") == 0);
+    BOOST_CHECK(!block_set->has(b1));
+    BOOST_CHECK(block_set->has(b3));
+    BOOST_CHECK(block_set->size() == 2);
+    b2->set_name("renamed");
+    BOOST_CHECK(block_set->find_block("b2") == 0);
+    BOOST_CHECK(block_set->find_block("renamed") == b2);
+    Strings names;
+    names.push_back("b3");
+    names.push_back("b1");
+    names.push_back("renamed");
+    Blocks blocks = block_set->find_blocks(names);
+    BOOST_REQUIRE(blocks.size() == 3);
+    BOOST_CHECK(blocks[0] == b3);
+    BOOST_CHECK(blocks[1] == 0);
+    BOOST_CHECK(blocks[2] == b2);
+    // same names
+    b1->set_name("b3");
+    block_set->insert(b1);
+    block_set->erase(b3);
+    BOOST_CHECK(block_set->find_block("b3") == b1);
+    BlockSetPtr other = new_bs();
+    other->swap(*block_set);
+    BOOST_CHECK(block_set->find_block("b3") == 0);
+    BOOST_CHECK(other->find_block("b3") == b1);
+    other->clear_blocks();
+    BOOST_CHECK(other->find_block("b3") == 0);
+    BOOST_CHECK(other->empty());
+}
+
+BOOST_AUTO_TEST_CASE (BlockSet_order) {
+    using namespace npge;
+    BlockSetPtr block_set = new_bs();
+    Blocks blocks;
+    for (int i = 0; i < 5; i++) {
+        Block* block = new Block;
+        blocks.push_back(block);
+        block_set->insert(block);
+    }
+    BOOST_CHECK(Blocks(block_set->begin(), block_set->end()) == blocks);
+    block_set->erase(blocks[1]);
+    BOOST_REQUIRE(block_set->size() == 4);
+    BOOST_CHECK(*(block_set->begin() + 1) == blocks[4]);
+    BOOST_FOREACH (Block* block, *block_set) {
+        BOOST_CHECK(block_set->has(block));
+    }
+}
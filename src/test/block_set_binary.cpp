@@ -0,0 +1,174 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+
+#include "block_set_binary.hpp"
+#include "BlockSet.hpp"
+#include "Block.hpp"
+#include "Fragment.hpp"
+#include "Sequence.hpp"
+#include "AlignmentRow.hpp"
+#include "block_set_alignment.hpp"
+#include "Exception.hpp"
+
+BOOST_AUTO_TEST_CASE (block_set_binary_main) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tGGtccgagcgGAcggcc");
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("tGGtccgaggcgGAcggcc");
+    s1->set_name("s1");
+    s2->set_name("s2");
+    s2->set_description("second");
+    BlockSet bs;
+    bs.add_sequence(s1);
+    bs.add_sequence(s2);
+    Block* b1 = new Block("b1");
+    Fragment* f11 = new Fragment(s1, 1, 9, 1);
+    Fragment* f12 = new Fragment(s2, 1, 9, -1);
+    new CompactAlignmentRow("GGTCCGAG-C", f11);
+    new CompactAlignmentRow("CCTCGGA-CC", f12);
+    b1->insert(f11);
+    b1->insert(f12);
+    bs.insert(b1);
+    Block* b2 = new Block("b2");
+    Fragment* f21 = new Fragment(s1, 10, 12);
+    b2->insert(f21);
+    bs.insert(b2);
+    BSA& bsa = bs.bsa("test");
+    bsa[s1.get()].ori = 1;
+    bsa[s1.get()].fragments.push_back(f11);
+    bsa[s1.get()].fragments.push_back(f21);
+    bsa[s2.get()].ori = -1;
+    bsa[s2.get()].fragments.push_back(f12);
+    bsa[s2.get()].fragments.push_back(0);
+    std::stringstream ss;
+    write_block_set_binary(bs, ss);
+    BOOST_REQUIRE(is_block_set_binary(ss));
+    BlockSet copy;
+    read_block_set_binary(copy, ss, COMPACT_ROW, COMPACT_SEQUENCE);
+    BOOST_REQUIRE(copy.seqs().size() == 2);
+    BOOST_REQUIRE(copy.size() == 2);
+    BOOST_CHECK(copy == bs);
+    Block* c1 = copy.find_block("b1");
+    BOOST_REQUIRE(c1);
+    BOOST_CHECK(c1->alignment_length() == 10);
+    BOOST_CHECK(c1->consensus_string() == b1->consensus_string());
+    BOOST_FOREACH (Fragment* f, *c1) {
+        BOOST_REQUIRE(f->row());
+        if (f->seq()->name() == "s1") {
+            BOOST_CHECK(f->str('-') == "GGTCCGAG-C");
+            BOOST_CHECK(f->row()->map_to_fragment(9) == 8);
+        } else {
+            BOOST_CHECK(f->seq()->description() == "second");
+            BOOST_CHECK(f->str('-') == "CCTCGGA-CC");
+        }
+    }
+    Block* c2 = copy.find_block("b2");
+    BOOST_REQUIRE(c2 && c2->front());
+    BOOST_CHECK(c2->front()->row() == 0);
+    BOOST_REQUIRE(copy.has_bsa("test"));
+    const BSA& bsa_copy = copy.bsa("test");
+    BOOST_REQUIRE(bsa_copy.size() == 2);
+    BOOST_FOREACH (const BSA::value_type& seq_and_row, bsa_copy) {
+        const BSRow& row = seq_and_row.second;
+        BOOST_REQUIRE(row.fragments.size() == 2);
+        if (seq_and_row.first->name() == "s1") {
+            BOOST_CHECK(row.ori == 1);
+            BOOST_CHECK(row.fragments[0]->block() == c1);
+            BOOST_CHECK(row.fragments[1]->block() == c2);
+        } else {
+            BOOST_CHECK(row.ori == -1);
+            BOOST_CHECK(row.fragments[0]->block() == c1);
+            BOOST_CHECK(row.fragments[1] == 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (block_set_binary_existing_seqs) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tGGtccgagcgGAcggcc");
+    s1->set_name("s1");
+    BlockSet bs;
+    bs.add_sequence(s1);
+    Block* block = new Block("b");
+    block->insert(new Fragment(s1, 0, 5));
+    bs.insert(block);
+    std::stringstream ss;
+    write_block_set_binary(bs, ss);
+    BlockSet target;
+    target.add_sequence(s1);
+    read_block_set_binary(target, ss, COMPACT_ROW, COMPACT_SEQUENCE);
+    BOOST_REQUIRE(target.seqs().size() == 1);
+    BOOST_REQUIRE(target.size() == 1);
+    BOOST_CHECK(target.front()->front()->seq() == s1.get());
+}
+
+BOOST_AUTO_TEST_CASE (block_set_binary_broken) {
+    using namespace npge;
+    std::stringstream fasta(">s1\nAAA\n");
+    BOOST_CHECK(!is_block_set_binary(fasta));
+    BlockSet bs;
+    BOOST_CHECK_THROW(read_block_set_binary(bs, fasta, COMPACT_ROW,
+                                            COMPACT_SEQUENCE), Exception);
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tGGtccgagcg");
+    s1->set_name("s1");
+    BlockSet orig;
+    orig.add_sequence(s1);
+    orig.insert(new Block("b"));
+    orig.front()->insert(new Fragment(s1, 0, 5));
+    std::stringstream ss;
+    write_block_set_binary(orig, ss);
+    std::string data = ss.str();
+    std::stringstream truncated(data.substr(0, data.size() - 10));
+    BOOST_CHECK_THROW(read_block_set_binary(bs, truncated, COMPACT_ROW,
+                                            COMPACT_SEQUENCE), Exception);
+}
+
+
+BOOST_AUTO_TEST_CASE (block_set_binary_broken_row) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tGGtccgagcg");
+    s1->set_name("s1");
+    BlockSet orig;
+    orig.add_sequence(s1);
+    orig.insert(new Block("b"));
+    Fragment* f = new Fragment(s1, 0, 2);
+    new CompactAlignmentRow("TG-G", f);
+    orig.front()->insert(f);
+    std::stringstream ss;
+    write_block_set_binary(orig, ss);
+    std::string data = ss.str();
+    // row length, number of bitsets, bitset
+    uint64_t length = 4, bitsets_size = 1;
+    CAR_Bitset bitset = 11; // 1011
+    std::string row(reinterpret_cast<const char*>(&length),
+                    sizeof(length));
+    row.append(reinterpret_cast<const char*>(&bitsets_size),
+               sizeof(bitsets_size));
+    size_t pos = data.find(row);
+    BOOST_REQUIRE(pos != std::string::npos);
+    pos += row.size();
+    BOOST_REQUIRE(data.compare(pos, sizeof(bitset),
+                               reinterpret_cast<const char*>(&bitset),
+                               sizeof(bitset)) == 0);
+    CAR_Bitset broken[] = {15, 19}; // 1111, 10011
+    for (int i = 0; i < 2; i++) {
+        std::string copy = data;
+        copy.replace(pos, sizeof(bitset),
+                     reinterpret_cast<const char*>(&broken[i]),
+                     sizeof(bitset));
+        std::stringstream input(copy);
+        BlockSet bs;
+        BOOST_CHECK_THROW(read_block_set_binary(bs, input, COMPACT_ROW,
+                                                COMPACT_SEQUENCE),
+                          Exception);
+    }
+    BlockSet bs;
+    read_block_set_binary(bs, ss, COMPACT_ROW, COMPACT_SEQUENCE);
+    BOOST_CHECK(bs == orig);
+}
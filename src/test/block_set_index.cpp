@@ -0,0 +1,119 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <ctime>
+#include <fstream>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/filesystem.hpp>
+
+#include "block_set_index.hpp"
+#include "BlockSet.hpp"
+#include "Block.hpp"
+#include "Sequence.hpp"
+#include "name_to_stream.hpp"
+#include "temp_file.hpp"
+#include "Exception.hpp"
+
+BOOST_AUTO_TEST_CASE (block_set_index_main) {
+    using namespace npge;
+    std::string file = temp_file();
+    {
+        std::ofstream out(file.c_str());
+        out << ">s1\nACGTACGTTGCA\n"
+            << ">s2 second\nGGCCAATTGGCA\n"
+            << ">s1_0_5 block=b1\nACGTAC-\n"
+            << ">s2_0_5 block=b1\nGG-CCAA\n\n"
+            << ">s1_6_11 block=b2\nGTTGCA\n"
+            << ">s2_11_6 block=b2\nTGCCAA\n\n"
+            << ">s2_3_8 block=b3\nCAATTG\n\n"
+            << ">s3_0_3 block=b4\nACGT";
+    }
+    write_block_set_index(file);
+    // index written in the same second is not trusted
+    std::string index_file = block_set_index_name(file);
+    std::time_t bs_time = boost::filesystem::last_write_time(file);
+    boost::filesystem::last_write_time(index_file, bs_time);
+    BOOST_CHECK(!has_block_set_index(file));
+    boost::filesystem::last_write_time(index_file, bs_time + 1);
+    BOOST_CHECK(has_block_set_index(file));
+    BlockSetIndex index(file);
+    Strings names = index.block_names();
+    BOOST_REQUIRE(names.size() == 4);
+    BOOST_CHECK(names[0] == "b1" && names[3] == "b4");
+    BOOST_CHECK(index.has_block("b3"));
+    BOOST_CHECK(!index.has_block("b5"));
+    BlockSet bs;
+    index.read_blocks(bs, Strings(1, "b2"), COMPACT_ROW,
+                      COMPACT_SEQUENCE);
+    BOOST_REQUIRE(bs.size() == 1);
+    BOOST_REQUIRE(bs.seqs().size() == 2);
+    BOOST_CHECK(bs.front()->name() == "b2");
+    BOOST_CHECK(bs.front()->size() == 2);
+    BOOST_FOREACH (const SequencePtr& seq, bs.seqs()) {
+        BOOST_CHECK(seq->size() == 12);
+        if (seq->name() == "s2") {
+            BOOST_CHECK(seq->description() == "second");
+        }
+    }
+    Strings more;
+    more.push_back("b2");
+    more.push_back("b1");
+    more.push_back("b4");
+    index.read_blocks(bs, more, COMPACT_ROW, COMPACT_SEQUENCE);
+    BOOST_CHECK(bs.size() == 3);
+    BOOST_REQUIRE(bs.seqs().size() == 3);
+    BOOST_FOREACH (const SequencePtr& seq, bs.seqs()) {
+        if (seq->name() == "s3") {
+            BOOST_CHECK(seq->contents() == "ACGT");
+        }
+    }
+    BOOST_CHECK_THROW(index.read_blocks(bs, Strings(1, "b5"),
+                                        COMPACT_ROW, COMPACT_SEQUENCE),
+                      Exception);
+    BlockSet seqs_only;
+    index.read_sequences(seqs_only, COMPACT_SEQUENCE);
+    BOOST_CHECK(seqs_only.seqs().size() == 2);
+    BOOST_CHECK(seqs_only.empty());
+    remove_file(block_set_index_name(file));
+    remove_file(file);
+}
+
+BOOST_AUTO_TEST_CASE (block_set_index_fragments_only) {
+    using namespace npge;
+    std::string file = temp_file();
+    {
+        std::ofstream out(file.c_str());
+        out << ">s1_0_5 block=b1\nACGTAC\n"
+            << ">s2_0_5 block=b1\nGGCCAA\n\n"
+            << ">s1_6_11 block=b2\nGTTGCA\n"
+            << ">s2_11_6 block=b2\nTGCCAA\n\n";
+    }
+    write_block_set_index(file);
+    BlockSetIndex index(file);
+    BlockSet bs;
+    index.read_blocks(bs, Strings(1, "b1"), COMPACT_ROW,
+                      COMPACT_SEQUENCE);
+    BOOST_REQUIRE(bs.seqs().size() == 2);
+    BOOST_FOREACH (const SequencePtr& seq, bs.seqs()) {
+        BOOST_CHECK(seq->size() == 12);
+    }
+    // sequences built by first call are reused
+    index.read_blocks(bs, Strings(1, "b2"), COMPACT_ROW,
+                      COMPACT_SEQUENCE);
+    BOOST_CHECK(bs.size() == 2);
+    BOOST_REQUIRE(bs.seqs().size() == 2);
+    BOOST_FOREACH (const SequencePtr& seq, bs.seqs()) {
+        if (seq->name() == "s1") {
+            BOOST_CHECK(seq->contents() == "ACGTACGTTGCA");
+        } else {
+            BOOST_CHECK(seq->contents() == "GGCCAATTGGCA");
+        }
+    }
+    remove_file(block_set_index_name(file));
+    remove_file(file);
+}
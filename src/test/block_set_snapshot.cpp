@@ -0,0 +1,67 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+#include "block_set_snapshot.hpp"
+#include "BlockSet.hpp"
+#include "Block.hpp"
+#include "Fragment.hpp"
+#include "AlignmentRow.hpp"
+#include "Sequence.hpp"
+#include "block_hash.hpp"
+
+BOOST_AUTO_TEST_CASE (BlockSetSnapshot_main) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("ATGCATGCAT");
+    s1->set_name("s1");
+    BlockSetPtr bs = new_bs();
+    bs->add_sequence(s1);
+    Block* b1 = new Block("b1");
+    Fragment* f11 = new Fragment(s1, 0, 2, 1);
+    new CompactAlignmentRow("AT-G", f11);
+    Fragment* f12 = new Fragment(s1, 4, 7, -1);
+    new CompactAlignmentRow("GCAT", f12);
+    b1->insert(f11);
+    b1->insert(f12);
+    bs->insert(b1);
+    Block* b2 = new Block("b2");
+    b2->insert(new Fragment(s1, 8, 9, 1));
+    bs->insert(b2);
+    hash_t hash = blockset_hash(*bs);
+    BlockSetSnapshot snapshot;
+    snapshot.take(*bs);
+    BOOST_CHECK(snapshot.size() == 2);
+    BOOST_CHECK(snapshot.has_block(b1));
+    BOOST_CHECK(snapshot.has_block(b2));
+    // change alignment of b1
+    f11->set_row(new CompactAlignmentRow("A-TG", f11));
+    BOOST_CHECK(!snapshot.has_block(b1));
+    // restore to empty blockset
+    BlockSetPtr copy = new_bs();
+    BOOST_CHECK(snapshot.restore(*copy) == 2);
+    BOOST_CHECK(copy->seqs().size() == 1);
+    BOOST_CHECK(blockset_hash(*copy) == hash);
+    Block* c1 = copy->find_block("b1");
+    BOOST_REQUIRE(c1);
+    BOOST_CHECK(c1->size() == 2);
+    BOOST_CHECK(c1 != b1);
+    BOOST_CHECK(c1->alignment_length() == 4);
+    BOOST_CHECK(snapshot.has_block(c1));
+    // restore only changed blocks
+    b2->set_name("renamed");
+    BlockSetPtr changed = new_bs();
+    BOOST_CHECK(snapshot.restore(*changed, bs.get()) == 1);
+    BOOST_CHECK(changed->size() == 1);
+    BOOST_CHECK(changed->front()->name() == "b1");
+    BOOST_CHECK(b2->name() == "b2");
+    snapshot.clear();
+    BOOST_CHECK(snapshot.size() == 0);
+    BOOST_CHECK(!snapshot.has_block(b2));
+}
+
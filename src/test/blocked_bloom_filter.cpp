@@ -0,0 +1,67 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include "BlockedBloomFilter.hpp"
+#include "make_hash.hpp"
+
+BOOST_AUTO_TEST_CASE (BlockedBloomFilter_test) {
+    using namespace npge;
+    BlockedBloomFilter filter(1e6, 0.01);
+    BOOST_CHECK(filter.bits() == 16777216); // 2^24 >= 9585059
+    BOOST_CHECK(filter.hashes() == 12);
+    BOOST_CHECK(filter.true_bits() == 0);
+    filter.add(make_hash("ATGC", 4));
+    filter.add(make_hash("AAAA", 4));
+    BOOST_CHECK(filter.test(make_hash("ATGC", 4)));
+    BOOST_CHECK(filter.test(make_hash("AAAA", 4)));
+    BOOST_CHECK(filter.true_bits() <= 2 * filter.hashes());
+    BOOST_CHECK(filter.true_bits() > 0);
+    BOOST_WARN(!filter.test(make_hash("GGGG", 4)));
+    BOOST_WARN(!filter.test(make_hash("TTGC", 4)));
+}
+
+BOOST_AUTO_TEST_CASE (BlockedBloomFilter_small) {
+    using namespace npge;
+    BlockedBloomFilter filter;
+    filter.set_bits(50);
+    filter.set_hashes(5);
+    BOOST_REQUIRE(filter.bits() == BlockedBloomFilter::BLOCK_BITS);
+    BOOST_REQUIRE(filter.hashes() == 5);
+    BOOST_CHECK(filter.test_and_add(0) == false);
+    BOOST_CHECK(filter.test_and_add(0) == true);
+    BOOST_CHECK(filter.test(0));
+    filter.clear();
+    BOOST_CHECK(filter.bits() == 0);
+    BOOST_CHECK(filter.hashes() == 0);
+}
+
+BOOST_AUTO_TEST_CASE (BlockedBloomFilter_many) {
+    using namespace npge;
+    const int N = 10000;
+    BlockedBloomFilter filter(N, 0.01);
+    int found = 0;
+    for (hash_t i = 0; i < N; i++) {
+        if (filter.test_and_add(i * 4)) {
+            found += 1;
+        }
+    }
+    BOOST_WARN(found < N / 20);
+    for (hash_t i = 0; i < N; i++) {
+        BOOST_REQUIRE(filter.test(i * 4));
+        BOOST_REQUIRE(filter.test_and_add(i * 4));
+    }
+    int false_positives = 0;
+    for (hash_t i = 0; i < N; i++) {
+        if (filter.test(i * 4 + 1)) {
+            false_positives += 1;
+        }
+    }
+    BOOST_WARN(false_positives < N / 20);
+}
+
@@ -6,10 +6,17 @@
  */
 
 #include <sstream>
+#include <map>
 #include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
 
 #include "BlockSet.hpp"
 #include "Sequence.hpp"
+#include "read_block_set.hpp"
+#include "cast.hpp"
+#include "Exception.hpp"
+#include "gzip_stream.hpp"
 
 BOOST_AUTO_TEST_CASE (fasta_main) {
     using namespace npge;
@@ -52,3 +59,109 @@ BOOST_AUTO_TEST_CASE (fasta_words) {
     BOOST_CHECK(bs.seqs()[0]->description() == "a b\tc");
 }
 
+BOOST_AUTO_TEST_CASE (fasta_lines) {
+    using namespace npge;
+    std::stringstream ss("AC\n>a descr \r\nAT G\r\n\n  gc\t\n>b\n>c x\nTT");
+    BlockSet bs;
+    ss >> bs;
+    BOOST_REQUIRE(bs.seqs().size() == 3);
+    std::map<std::string, SequencePtr> seqs;
+    BOOST_FOREACH (const SequencePtr& seq, bs.seqs()) {
+        seqs[seq->name()] = seq;
+    }
+    BOOST_REQUIRE(seqs["a"] && seqs["b"] && seqs["c"]);
+    BOOST_CHECK(seqs["a"]->description() == "descr");
+    BOOST_CHECK(seqs["a"]->contents() == "ATGGC");
+    BOOST_CHECK(seqs["b"]->size() == 0);
+    BOOST_CHECK(seqs["c"]->description() == "x");
+    BOOST_CHECK(seqs["c"]->contents() == "TT");
+}
+
+BOOST_AUTO_TEST_CASE (fasta_one_by_one) {
+    using namespace npge;
+    std::stringstream ss(">a\nAAA\nTTT\n>b\nGGG\n");
+    InMemorySequence a(ss);
+    InMemorySequence b(ss);
+    BOOST_CHECK(a.name() == "a");
+    BOOST_CHECK(a.contents() == "AAATTT");
+    BOOST_CHECK(b.name() == "b");
+    BOOST_CHECK(b.contents() == "GGG");
+}
+
+BOOST_AUTO_TEST_CASE (fasta_parallel) {
+    using namespace npge;
+    std::string text;
+    for (int i = 0; i < 5000; i++) {
+        text += ">s" + TO_S(i) + " d" + TO_S(i) + "\n";
+        for (int j = 0; j < 10; j++) {
+            text += "ATGCATGCATGCATGCATGCATGCATGCATGC";
+            text += "ATGCATGCATGCATGCATGCATGCATGCATG\n";
+        }
+    }
+    std::stringstream ss(text);
+    BlockSet bs;
+    BlockSetFastaReader reader(bs, ss, COMPACT_ROW, COMPACT_SEQUENCE);
+    reader.set_workers(4);
+    reader.run();
+    BOOST_REQUIRE(bs.seqs().size() == 5000);
+    BOOST_FOREACH (const SequencePtr& seq, bs.seqs()) {
+        BOOST_REQUIRE(seq->size() == 630);
+        BOOST_REQUIRE(seq->description() == "d" + seq->name().substr(1));
+    }
+}
+
+
+BOOST_AUTO_TEST_CASE (fasta_truncated_gzip) {
+    using namespace npge;
+    std::string text;
+    for (int i = 0; i < 5000; i++) {
+        text += ">s" + TO_S(i) + "\n";
+        text += "ATGCATGCATGCATGCATGCATGCATGCATGC\n";
+    }
+    boost::shared_ptr<std::stringstream> gz(new std::stringstream);
+    {
+        boost::shared_ptr<std::ostream> out = gzip_ostream(gz, 1);
+        *out << text;
+    }
+    std::string data = gz->str();
+    std::string half = data.substr(0, data.size() / 2);
+    boost::shared_ptr<std::istream> in = gzip_istream(
+            boost::make_shared<std::istringstream>(half));
+    BlockSet bs;
+    BlockSetFastaReader reader(bs, *in, COMPACT_ROW, COMPACT_SEQUENCE);
+    BOOST_CHECK_THROW(reader.run(), Exception);
+}
+
+BOOST_AUTO_TEST_CASE (fasta_batches) {
+    using namespace npge;
+    std::string text = ">s1\nACGTACGTTGCA\n"
+                       ">s1_0_5 block=b1\nACGTAC-\n"
+                       ">s2_0_5 block=b1\nGG-CCAA\n"
+                       ">s1_6_11 block=b2\nGTTGCA\n"
+                       ">s2_11_6 block=b2\nTGCCAA\n"
+                       ">s2_3_8 block=b3\nCAATTG\n"
+                       ">s2_0_5 block=b4\nGGCCAA\n";
+    std::stringstream ss1(text);
+    BlockSet bs1;
+    BlockSetFastaReader reader1(bs1, ss1, COMPACT_ROW, COMPACT_SEQUENCE);
+    reader1.run();
+    std::stringstream ss2(text);
+    BlockSet bs2;
+    BlockSetFastaReader reader2(bs2, ss2, COMPACT_ROW, COMPACT_SEQUENCE);
+    reader2.set_batch_size(1);
+    reader2.run();
+    BOOST_REQUIRE(bs2.size() == 4);
+    BOOST_REQUIRE(bs2.seqs().size() == 2);
+    BOOST_CHECK(bs1 == bs2);
+    BOOST_FOREACH (const SequencePtr& seq, bs2.seqs()) {
+        if (seq->name() == "s2") {
+            BOOST_CHECK(seq->contents() == "GGCCAATTGGCA");
+        }
+    }
+    std::stringstream ss3(">s2_0_5 block=b1\nGGCCAA\n"
+                          ">s2\nGGCCAATTGGCA\n");
+    BlockSet bs3;
+    BlockSetFastaReader reader3(bs3, ss3, COMPACT_ROW, COMPACT_SEQUENCE);
+    reader3.set_batch_size(1);
+    BOOST_CHECK_THROW(reader3.run(), Exception);
+}
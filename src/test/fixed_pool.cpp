@@ -0,0 +1,86 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <set>
+#include <vector>
+#include <cstring>
+#include "boost-xtime.hpp"
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "FixedPool.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "AlignmentRow.hpp"
+
+BOOST_AUTO_TEST_CASE (FixedPool_main) {
+    using namespace npge;
+    FixedPool pool(20);
+    BOOST_CHECK(pool.size() >= 20);
+    BOOST_CHECK(pool.size() % sizeof(void*) == 0);
+    BOOST_CHECK(pool.reserved() == 0);
+    std::set<void*> pieces;
+    for (int i = 0; i < 5000; i++) {
+        void* ptr = pool.allocate();
+        BOOST_CHECK(size_t(ptr) % sizeof(void*) == 0);
+        std::memset(ptr, 0xab, 20);
+        BOOST_CHECK(pieces.insert(ptr).second);
+    }
+    size_t reserved = pool.reserved();
+    BOOST_CHECK(reserved >= 5000 * pool.size());
+    BOOST_FOREACH (void* ptr, pieces) {
+        pool.deallocate(ptr);
+    }
+    // freed pieces are reused
+    for (int i = 0; i < 5000; i++) {
+        pool.allocate();
+    }
+    BOOST_CHECK(pool.reserved() == reserved);
+}
+
+static void use_pool(npge::FixedPool* pool) {
+    std::vector<void*> pieces;
+    for (int round = 0; round < 10; round++) {
+        for (int i = 0; i < 1000; i++) {
+            void* ptr = pool->allocate();
+            std::memset(ptr, round, pool->size());
+            pieces.push_back(ptr);
+        }
+        for (int i = 0; i < pieces.size(); i++) {
+            pool->deallocate(pieces[i]);
+        }
+        pieces.clear();
+    }
+}
+
+BOOST_AUTO_TEST_CASE (FixedPool_threads) {
+    using namespace npge;
+    FixedPool pool(sizeof(Fragment));
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++) {
+        threads.create_thread(boost::bind(use_pool, &pool));
+    }
+    threads.join_all();
+    // pieces freed by threads are given back to the common list
+    size_t reserved = pool.reserved();
+    use_pool(&pool);
+    BOOST_CHECK(pool.reserved() == reserved);
+}
+
+BOOST_AUTO_TEST_CASE (FixedPool_objects) {
+    using namespace npge;
+    Block* block = new Block;
+    for (int i = 0; i < 100; i++) {
+        Fragment* f = new Fragment(0, i, i);
+        new CompactAlignmentRow("A", f);
+        block->insert(f);
+    }
+    BOOST_CHECK(block->size() == 100);
+    delete block;
+}
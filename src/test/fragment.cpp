@@ -187,6 +187,35 @@ BOOST_AUTO_TEST_CASE (Fragment_alignment_at) {
     BOOST_CHECK(f.alignment_at(8) == 0);
 }
 
+BOOST_AUTO_TEST_CASE (Fragment_alignment_chars) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("TGGTC");
+    Fragment f(s1, 0, 4);
+    char letters[10];
+    pos_t positions[10];
+    f.alignment_chars(-2, 8, letters, positions);
+    for (int i = 0; i < 10; i++) {
+        BOOST_CHECK(letters[i] == f.alignment_at(i - 2));
+    }
+    BOOST_CHECK(positions[0] == -1);
+    BOOST_CHECK(positions[2] == 0);
+    BOOST_CHECK(positions[6] == 4);
+    BOOST_CHECK(positions[7] == -1);
+    Fragment r(s1, 0, 4, -1);
+    r.set_row(new CompactAlignmentRow("GA--CCA"));
+    r.alignment_chars(0, 7, letters, positions);
+    for (int i = 0; i < 7; i++) {
+        BOOST_CHECK(letters[i] == r.alignment_at(i));
+    }
+    BOOST_CHECK(std::string(letters, 7) == std::string("GA\0\0CCA", 7));
+    BOOST_CHECK(positions[2] == -1);
+    BOOST_CHECK(positions[4] == 2);
+    // part of row
+    r.alignment_chars(3, 5, letters);
+    BOOST_CHECK(letters[0] == 0);
+    BOOST_CHECK(letters[1] == 'C');
+}
+
 BOOST_AUTO_TEST_CASE (Fragment_common_positions) {
     using namespace npge;
     SequencePtr s1 = boost::make_shared<InMemorySequence>("TGGTCCGAGATGCGGGCC");
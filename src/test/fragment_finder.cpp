@@ -0,0 +1,105 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <map>
+#include <set>
+#include <boost/test/unit_test.hpp>
+#include <boost/foreach.hpp>
+
+#include "FragmentFinder.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "name_to_stream.hpp"
+
+BOOST_AUTO_TEST_CASE (FragmentFinder_main) {
+    using namespace npge;
+    SequencePtr s1 = boost::make_shared<InMemorySequence>("tggtcCGAGATgcgggcc");
+    BlockSetPtr block_set = new_bs();
+    block_set->add_sequence(s1);
+    FragmentFinder finder;
+    finder.set_block_set(block_set);
+    finder.set_opt_value("pattern", std::string("ATCTCG"));
+    finder.run();
+    BOOST_REQUIRE(block_set->size() == 1);
+    Block* block = block_set->front();
+    BOOST_REQUIRE(block->size() == 1);
+    Fragment* f = block->front();
+    BOOST_CHECK(f->min_pos() == 5);
+    BOOST_CHECK(f->max_pos() == 10);
+    BOOST_CHECK(f->ori() == -1);
+}
+
+BOOST_AUTO_TEST_CASE (FragmentFinder_patterns) {
+    using namespace npge;
+    std::string long_pattern("GTCCGAGCGGACGGCCTGATCCTCGATTAACAGTTTGG");
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(
+                         "tggtcCGAGATgcgggcc" + long_pattern + "cgaga");
+    SequencePtr s2 = boost::make_shared<InMemorySequence>("ccgaganntcg");
+    BlockSetPtr block_set = new_bs();
+    block_set->add_sequence(s1);
+    block_set->add_sequence(s2);
+    set_sstream(":patterns");
+    *name_to_ostream(":patterns") << ">p1\nCGAGA\n"
+                                  << ">p2\n" << long_pattern << "\n"
+                                  << ">p3\nAGANNT\n"
+                                  << ">p4\nTTTTTTT\n";
+    FragmentFinder finder;
+    finder.set_block_set(block_set);
+    finder.set_opt_value("patterns", std::string(":patterns"));
+    finder.run();
+    remove_stream(":patterns");
+    BOOST_REQUIRE(block_set->size() == 3);
+    std::map<std::string, Block*> blocks;
+    BOOST_FOREACH (Block* block, *block_set) {
+        blocks[block->name()] = block;
+    }
+    Block* p1 = blocks["p1"];
+    Block* p2 = blocks["p2"];
+    Block* p3 = blocks["p3"];
+    BOOST_REQUIRE(p1 && p2 && p3);
+    BOOST_CHECK(p1->size() == 3);
+    BOOST_FOREACH (Fragment* f, *p1) {
+        BOOST_CHECK(f->str() == "CGAGA");
+    }
+    BOOST_REQUIRE(p2->size() == 1);
+    BOOST_CHECK(p2->front()->str() == long_pattern);
+    BOOST_REQUIRE(p3->size() == 1);
+    BOOST_CHECK(p3->front()->seq() == s2.get());
+    BOOST_CHECK(p3->front()->min_pos() == 3);
+}
+
+
+BOOST_AUTO_TEST_CASE (FragmentFinder_max_matches) {
+    using namespace npge;
+    BlockSetPtr block_set = new_bs();
+    for (int i = 0; i < 20; i++) {
+        std::string text = std::string(i + 1, 'A') + "CGAGA" +
+                           std::string(100, 'A');
+        block_set->add_sequence(boost::make_shared<InMemorySequence>(text));
+    }
+    set_sstream(":patterns");
+    *name_to_ostream(":patterns") << ">p1\nCGAGA\n";
+    FragmentFinder finder;
+    finder.set_block_set(block_set);
+    finder.set_opt_value("patterns", std::string(":patterns"));
+    finder.set_opt_value("max-matches", 3);
+    finder.set_opt_value("workers", 4);
+    finder.run();
+    remove_stream(":patterns");
+    BOOST_REQUIRE(block_set->size() == 1);
+    Block* block = block_set->front();
+    BOOST_REQUIRE(block->size() == 3);
+    // least matches are kept whatever worker found them
+    std::set<pos_t> min_pos;
+    BOOST_FOREACH (Fragment* f, *block) {
+        min_pos.insert(f->min_pos());
+    }
+    BOOST_CHECK(min_pos.size() == 3);
+    BOOST_CHECK(min_pos.count(1) && min_pos.count(2) && min_pos.count(3));
+}
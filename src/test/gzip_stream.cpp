@@ -0,0 +1,165 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <sstream>
+#include <fstream>
+#include <boost/test/unit_test.hpp>
+#include <boost/make_shared.hpp>
+#include "boost-xtime.hpp"
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+
+#include "gzip_stream.hpp"
+#include "name_to_stream.hpp"
+#include "temp_file.hpp"
+#include "thread_pool.hpp"
+#include "Exception.hpp"
+#include "cast.hpp"
+
+typedef boost::shared_ptr<std::istream> IPtr;
+typedef boost::shared_ptr<std::ostream> OPtr;
+
+BOOST_AUTO_TEST_CASE (gzip_stream_main) {
+    using namespace npge;
+    BOOST_CHECK(is_gzip_name("a.bs.gz"));
+    BOOST_CHECK(!is_gzip_name("a.bs"));
+    std::string text;
+    for (int i = 0; i < 100000; i++) {
+        text += ">s" + TO_S(i) + "\nATGCATGCATGCATGCATGCATGCATGCAT\n";
+    }
+    std::string file = temp_file() + ".gz";
+    {
+        OPtr out = name_to_ostream(file);
+        *out << text;
+    }
+    {
+        std::ifstream raw(file.c_str(), std::ios_base::binary);
+        BOOST_CHECK(raw.get() == 31);
+        BOOST_CHECK(raw.get() == 139);
+    }
+    {
+        IPtr in = name_to_istream(file);
+        std::stringstream result;
+        result << in->rdbuf();
+        BOOST_CHECK(result.str() == text);
+    }
+    remove_file(file);
+}
+
+BOOST_AUTO_TEST_CASE (gzip_stream_memory) {
+    using namespace npge;
+    boost::shared_ptr<std::stringstream> ss(new std::stringstream);
+    {
+        OPtr out = gzip_ostream(ss, 1);
+        *out << "first\n";
+    }
+    {
+        // second member
+        OPtr out = gzip_ostream(ss, 2);
+        *out << "second\n";
+    }
+    std::string data = ss->str();
+    {
+        IPtr in = gzip_istream(boost::make_shared<std::istringstream>(data));
+        std::string line1, line2, line3;
+        std::getline(*in, line1);
+        std::getline(*in, line2);
+        BOOST_CHECK(line1 == "first");
+        BOOST_CHECK(line2 == "second");
+        BOOST_CHECK(!std::getline(*in, line3));
+    }
+    {
+        std::string truncated = data.substr(0, 20);
+        IPtr in = gzip_istream(
+                      boost::make_shared<std::istringstream>(truncated));
+        std::string line;
+        BOOST_CHECK_THROW(std::getline(*in, line), Exception);
+    }
+}
+
+typedef boost::mutex::scoped_lock Lock;
+
+// occupies all threads of ThreadPool until release()
+class BusyPoolTG : public npge::ReusingThreadGroup {
+public:
+    boost::mutex mutex_;
+    boost::condition_variable condition_;
+    int tasks_;
+    int started_;
+    bool released_;
+
+    BusyPoolTG():
+        tasks_(0), started_(0), released_(false) {
+        set_workers(-1);
+    }
+
+    void wait_started() {
+        Lock lock(mutex_);
+        while (started_ < workers()) {
+            condition_.wait(lock);
+        }
+    }
+
+    void release() {
+        {
+            Lock lock(mutex_);
+            released_ = true;
+        }
+        condition_.notify_all();
+    }
+
+    npge::ThreadTask* create_task_impl(npge::ThreadWorker* worker);
+};
+
+class BusyTask : public npge::ThreadTask {
+public:
+    BusyTask(npge::ThreadWorker* worker):
+        npge::ThreadTask(worker) {
+    }
+
+    void run_impl() {
+        BusyPoolTG* tg = static_cast<BusyPoolTG*>(thread_group());
+        Lock lock(tg->mutex_);
+        tg->started_ += 1;
+        tg->condition_.notify_all();
+        while (!tg->released_) {
+            tg->condition_.wait(lock);
+        }
+    }
+};
+
+npge::ThreadTask* BusyPoolTG::create_task_impl(
+    npge::ThreadWorker* worker) {
+    if (tasks_ < workers()) {
+        tasks_ += 1;
+        return new BusyTask(worker);
+    } else {
+        return 0;
+    }
+}
+
+BOOST_AUTO_TEST_CASE (gzip_stream_busy_pool) {
+    using namespace npge;
+    BusyPoolTG busy;
+    boost::thread busy_thread(boost::bind(&BusyPoolTG::perform, &busy));
+    busy.wait_started();
+    // several blocks are compressed by several workers
+    std::string text(1000000, 'A');
+    boost::shared_ptr<std::stringstream> ss(new std::stringstream);
+    {
+        OPtr out = gzip_ostream(ss, 4);
+        *out << text;
+    }
+    busy.release();
+    busy_thread.join();
+    IPtr in = gzip_istream(boost::make_shared<std::istringstream>(ss->str()));
+    std::stringstream result;
+    result << in->rdbuf();
+    BOOST_CHECK(result.str() == text);
+}
@@ -6,9 +6,13 @@
  */
 
 #include <string>
+#include <set>
+#include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include "make_hash.hpp"
+#include "hash128.hpp"
+#include "SeqI.hpp"
 #include "complement.hpp"
 #include "Sequence.hpp"
 #include "Fragment.hpp"
@@ -73,3 +77,133 @@ BOOST_AUTO_TEST_CASE (hash_reuse_hash_full) {
     }
 }
 
+
+BOOST_AUTO_TEST_CASE (hash_canonical_hashes) {
+    using namespace npge;
+    std::string s("GATCCTCGATTAACAGTTTGGCCTGTTCCTATGTATGCCCTACTCCAAATGGT"
+                  "GCCAACTGGATCAATCCTCAGTGCCNNNGGAATCATGTCTTTATTTATGCTTT"
+                  "TCAGCTCTGCGAACTTAGGCTCAGCACAAGATTTAAGCGAGAAGCGAAAGCTG"
+                  "ACCGGCAGGGGGGGCACGGTTAATAACTAAGACTGTAGCGTGACAAACGGACN");
+    SequencePtr s1 = boost::make_shared<InMemorySequence>(s);
+    SequencePtr s2 = boost::make_shared<PackedSequence>(s);
+    for (int k = 1; k <= MAX_ANCHOR_SIZE; k++) {
+        int n = s.size() - k + 1;
+        std::vector<hash_t> h1(n), h2(n);
+        std::vector<signed char> o1(n), o2(n);
+        s1->canonical_hashes(0, n, k, &h1[0], &o1[0]);
+        s2->canonical_hashes(0, n, k, &h2[0], &o2[0]);
+        for (int i = 0; i < n; i++) {
+            BOOST_REQUIRE(o1[i] == o2[i]);
+            Fragment f(s1, i, i + k - 1);
+            if (o1[i] == 0) {
+                BOOST_CHECK(f.str().find('N') != std::string::npos);
+            } else {
+                BOOST_CHECK(h1[i] == h2[i]);
+                f.set_ori(o1[i]);
+                BOOST_CHECK(f.hash() == h1[i]);
+                f.inverse();
+                BOOST_CHECK(f.hash() >= h1[i]);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE (hash_wide) {
+    using namespace npge;
+    std::string s("GATCCTCGATTAACAGTTTGGCCTGTTCCTATGTATGCCCTACTCCAAATGGT"
+                  "GCCAACTGGATCAATCCTCAGTGCCNNNGGAATCATGTCTTTATTTATGCTTT"
+                  "TCAGCTCTGCGAACTTAGGCTCAGCACAAGATTTAAGCGAGAAGCGAAAGCTG");
+    SequencePtr seq = boost::make_shared<InMemorySequence>(s);
+    for (int k = 1; k <= MAX_ANCHOR_SIZE; k++) {
+        hash128_t wide = make_hash<hash128_t>(s.c_str(), k);
+        BOOST_CHECK(wide.lo_ == make_hash(s.c_str(), k));
+        BOOST_CHECK(wide.hi_ == 0);
+    }
+    for (int k = 1; k <= MAX_WIDE_ANCHOR_SIZE; k++) {
+        int n = s.size() - k + 1;
+        std::vector<hash128_t> hashes(n);
+        std::vector<signed char> oris(n);
+        canonical_hashes(seq.get(), 0, n, k, &hashes[0], &oris[0]);
+        std::vector<hash_t> short_hashes(n);
+        std::vector<signed char> short_oris(n);
+        if (k <= MAX_ANCHOR_SIZE) {
+            seq->canonical_hashes(0, n, k, &short_hashes[0],
+                                  &short_oris[0]);
+        }
+        for (int i = 0; i < n; i++) {
+            const char* start = s.c_str() + i;
+            hash128_t dir = make_hash<hash128_t>(start, k, 1);
+            hash128_t rev = make_hash<hash128_t>(start + k - 1, k, -1);
+            if (i > 0) {
+                hash128_t prev = make_hash<hash128_t>(start - 1, k, 1);
+                BOOST_CHECK(reuse_hash(prev, k, start[-1],
+                                       start[k - 1]) == dir);
+            }
+            if (oris[i] == 0) {
+                BOOST_CHECK(std::string(start, k).find('N') !=
+                            std::string::npos);
+            } else {
+                BOOST_CHECK(hashes[i] == std::min(dir, rev));
+                BOOST_CHECK(hashes[i] == (oris[i] == 1 ? dir : rev));
+            }
+            if (k <= MAX_ANCHOR_SIZE) {
+                BOOST_REQUIRE(oris[i] == short_oris[i]);
+                BOOST_CHECK(hashes[i].lo_ == short_hashes[i]);
+            }
+        }
+    }
+}
+
+struct KmerCollector {
+    std::vector<npge::pos_t> pos_;
+
+    void process(npge::hash_t hash, npge::pos_t pos, int ori) {
+        pos_.push_back(pos);
+    }
+};
+
+BOOST_AUTO_TEST_CASE (hash_minimizers) {
+    using namespace npge;
+    std::string r("GATCCTCGATTAACAGTTTGGCCTGTTCCTATGTATGCCCTACTCCAAATGGT");
+    std::string s = "GCCAACTGGATCAATCC" + r + "NNNGGAATCATGTC" + r;
+    SequencePtr seq = boost::make_shared<InMemorySequence>(s);
+    int k = 11, w = 5;
+    KmerCollector all;
+    for_each_kmer<hash_t>(seq.get(), k, 0, all);
+    BOOST_CHECK(all.pos_.size() == s.size() - k + 1);
+    KmerCollector m;
+    for_each_kmer<hash_t>(seq.get(), k, w, m);
+    BOOST_CHECK(m.pos_.size() < all.pos_.size() / 2);
+    // each window of w k-mers without N has a minimizer
+    for (int start = 0; start + w + k - 1 <= s.size(); start++) {
+        if (s.substr(start, w + k - 1).find('N') != std::string::npos) {
+            continue;
+        }
+        bool found = false;
+        BOOST_FOREACH (pos_t pos, m.pos_) {
+            if (pos >= start && pos < start + w) {
+                found = true;
+            }
+        }
+        BOOST_CHECK(found);
+    }
+    // both copies of the repeat have same minimizers
+    std::set<hash_t> copy1, copy2;
+    pos_t r1 = 17, r2 = 17 + r.size() + 14;
+    BOOST_FOREACH (pos_t pos, m.pos_) {
+        Fragment f(seq, pos, pos + k - 1);
+        if (pos >= r1 + w && pos + k + w <= r1 + r.size()) {
+            copy1.insert(f.hash());
+        }
+        if (pos >= r2 + w && pos + k + w <= r2 + r.size()) {
+            copy2.insert(f.hash());
+        }
+    }
+    BOOST_CHECK(!copy1.empty());
+    BOOST_CHECK(copy1 == copy2);
+    // short sequence
+    SequencePtr short_seq = boost::make_shared<InMemorySequence>("ATGCATGCAAT");
+    KmerCollector one;
+    for_each_kmer<hash_t>(short_seq.get(), 8, w, one);
+    BOOST_CHECK(one.pos_.size() == 1);
+}
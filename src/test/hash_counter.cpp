@@ -0,0 +1,59 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <map>
+#include <set>
+#include <boost/test/unit_test.hpp>
+
+#include "HashCounter.hpp"
+
+BOOST_AUTO_TEST_CASE (HashCounter_main) {
+    using namespace npge;
+    HashCounter<hash_t> c;
+    BOOST_CHECK(c.empty());
+    BOOST_CHECK(c.count(0) == 0);
+    c.add(0);
+    c.add(0);
+    c.add(EmptyHash<hash_t>::value());
+    BOOST_CHECK(c.count(0) == 2);
+    BOOST_CHECK(c.count(1) == 0);
+    BOOST_CHECK(c.count(EmptyHash<hash_t>::value()) == 1);
+    BOOST_CHECK(c.size() == 2);
+    std::vector<hash_t> twice;
+    c.elements(twice, 2, 2);
+    BOOST_REQUIRE(twice.size() == 1);
+    BOOST_CHECK(twice[0] == 0);
+    c.clear();
+    BOOST_CHECK(c.empty());
+    BOOST_CHECK(c.count(0) == 0);
+    BOOST_CHECK(c.count(EmptyHash<hash_t>::value()) == 0);
+}
+
+BOOST_AUTO_TEST_CASE (HashCounter_many) {
+    using namespace npge;
+    HashCounter<hash128_t> c;
+    std::map<hash128_t, int> expected;
+    for (int i = 0; i < 30000; i++) {
+        hash128_t h(i % 1000, i % 7);
+        c.add(h);
+        expected[h] += 1;
+    }
+    BOOST_CHECK(c.size() == expected.size());
+    std::set<hash128_t> frequent;
+    for (std::map<hash128_t, int>::const_iterator it = expected.begin();
+            it != expected.end(); ++it) {
+        BOOST_REQUIRE(c.count(it->first) == it->second);
+        if (it->second >= 5) {
+            frequent.insert(it->first);
+        }
+    }
+    BOOST_CHECK(c.count(hash128_t(1000, 1)) == 0);
+    std::vector<hash128_t> elements;
+    c.elements(elements, 5, HashCounter<hash128_t>::MAX_COUNT);
+    BOOST_CHECK(std::set<hash128_t>(elements.begin(), elements.end()) ==
+                frequent);
+}
@@ -0,0 +1,70 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <set>
+#include <sstream>
+#include <boost/test/unit_test.hpp>
+
+#include "HashSet.hpp"
+
+BOOST_AUTO_TEST_CASE (HashSet_main) {
+    using namespace npge;
+    HashSet<hash_t> s;
+    BOOST_CHECK(s.empty());
+    BOOST_CHECK(!s.has_elem(0));
+    BOOST_CHECK(s.insert(0));
+    BOOST_CHECK(!s.insert(0));
+    BOOST_CHECK(s.has_elem(0));
+    BOOST_CHECK(!s.has_elem(1));
+    BOOST_CHECK(s.insert(EmptyHash<hash_t>::value()));
+    BOOST_CHECK(s.has_elem(EmptyHash<hash_t>::value()));
+    BOOST_CHECK(s.size() == 2);
+    s.clear();
+    BOOST_CHECK(s.empty());
+    BOOST_CHECK(!s.has_elem(0));
+    BOOST_CHECK(!s.has_elem(EmptyHash<hash_t>::value()));
+}
+
+BOOST_AUTO_TEST_CASE (HashSet_many) {
+    using namespace npge;
+    HashSet<hash_t> s;
+    std::set<hash_t> expected;
+    for (int i = 0; i < 10000; i++) {
+        hash_t h = hash_t(i) * 12345;
+        BOOST_CHECK(s.insert(h) == expected.insert(h).second);
+    }
+    BOOST_CHECK(s.size() == expected.size());
+    for (int i = 0; i < 20000; i++) {
+        hash_t h = hash_t(i) * 12345;
+        BOOST_REQUIRE(s.has_elem(h) == (expected.count(h) == 1));
+    }
+    std::vector<hash_t> elements;
+    s.elements(elements);
+    BOOST_CHECK(std::set<hash_t>(elements.begin(), elements.end()) ==
+                expected);
+}
+
+BOOST_AUTO_TEST_CASE (HashSet_wide_read_write) {
+    using namespace npge;
+    HashSet<hash128_t> s;
+    for (int i = 0; i < 100; i++) {
+        s.insert(hash128_t(i, i * 7));
+    }
+    std::stringstream buffer;
+    s.write(buffer);
+    HashSet<hash128_t> s2;
+    s2.insert(hash128_t(1000, 1));
+    BOOST_REQUIRE(s2.read(buffer));
+    BOOST_CHECK(s2.size() == 101);
+    for (int i = 0; i < 100; i++) {
+        BOOST_CHECK(s2.has_elem(hash128_t(i, i * 7)));
+    }
+    BOOST_CHECK(s2.has_elem(hash128_t(1000, 1)));
+    BOOST_CHECK(!s2.has_elem(hash128_t(1, 1)));
+    std::stringstream broken("123");
+    BOOST_CHECK(!s2.read(broken));
+}
@@ -0,0 +1,98 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <sstream>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include "RawWrite.hpp"
+#include "AbstractOutput.hpp"
+#include "Exception.hpp"
+#include "Sequence.hpp"
+#include "Fragment.hpp"
+#include "Block.hpp"
+#include "BlockSet.hpp"
+#include "name_to_stream.hpp"
+#include "temp_file.hpp"
+#include "cast.hpp"
+
+static std::string write_blocks(npge::BlockSetPtr bs,
+                                const std::string& file,
+                                int workers) {
+    using namespace npge;
+    RawWrite writer;
+    writer.set_bs("target", bs);
+    writer.set_opt_value("file", file);
+    writer.set_opt_value("workers", workers);
+    writer.run();
+    boost::shared_ptr<std::istream> in = name_to_istream(file);
+    std::stringstream result;
+    result << in->rdbuf();
+    remove_file(file);
+    return result.str();
+}
+
+BOOST_AUTO_TEST_CASE (RawWrite_gzip_workers) {
+    using namespace npge;
+    std::string text;
+    for (int i = 0; i < 100; i++) {
+        text += "TGAGATGCGGGCCAGATCGATCGAT";
+    }
+    SequencePtr seq(new InMemorySequence(text));
+    seq->set_name("s");
+    BlockSetPtr bs = new_bs();
+    bs->add_sequence(seq);
+    // output is larger than several compressed blocks
+    for (int i = 0; i < 2000; i++) {
+        Block* b = new Block("b" + TO_S(i));
+        b->insert(new Fragment(seq, 0, seq->size() - 1, 1));
+        b->insert(new Fragment(seq, 0, seq->size() - 1, -1));
+        bs->insert(b);
+    }
+    std::string plain = write_blocks(bs, temp_file(), 1);
+    BOOST_CHECK(!plain.empty());
+    // block workers take all threads of ThreadPool
+    int workers = std::max(2, int(boost::thread::hardware_concurrency()));
+    std::string gz = write_blocks(bs, temp_file() + ".gz", workers);
+    BOOST_CHECK(gz == plain);
+}
+
+namespace npge {
+
+class FailingOutput : public AbstractOutput {
+protected:
+    void print_block(std::ostream& o, Block* block) const {
+        if (block->name() == "b10") {
+            throw Exception("bad block");
+        }
+        o << block->name() << "\n";
+    }
+};
+
+}
+
+BOOST_AUTO_TEST_CASE (AbstractOutput_failed_worker) {
+    using namespace npge;
+    SequencePtr seq(new InMemorySequence("TGAGATGCGGGCC"));
+    seq->set_name("s");
+    BlockSetPtr bs = new_bs();
+    bs->add_sequence(seq);
+    for (int i = 0; i < 1000; i++) {
+        Block* b = new Block("b" + TO_S(i));
+        b->insert(new Fragment(seq, 0, seq->size() - 1, 1));
+        bs->insert(b);
+    }
+    std::string file = temp_file();
+    FailingOutput output;
+    output.set_bs("target", bs);
+    output.set_opt_value("file", file);
+    output.set_opt_value("workers", 4);
+    // must not hang waiting for blocks of failed worker
+    BOOST_CHECK_THROW(output.run(), Exception);
+    remove_file(file);
+}
@@ -5,11 +5,16 @@
  * See the LICENSE file for terms of use.
  */
 
+#include <fstream>
 #include <boost/test/unit_test.hpp>
 
 #include "Sequence.hpp"
+#include "Exception.hpp"
 #include "Block.hpp"
 #include "Fragment.hpp"
+#include "genome_index.hpp"
+#include "name_to_stream.hpp"
+#include "temp_file.hpp"
 
 BOOST_AUTO_TEST_CASE (Sequence_main) {
     using namespace npge;
@@ -38,6 +43,94 @@ BOOST_AUTO_TEST_CASE (Sequence_n) {
     CompactLowNSequence compact_low_n(seq_str);
     BOOST_CHECK(compact_low_n.size() == seq_str.size());
     BOOST_CHECK(compact_low_n.contents() == seq_str);
+    PackedSequence packed(seq_str);
+    BOOST_CHECK(packed.size() == seq_str.size());
+    BOOST_CHECK(packed.contents() == seq_str);
+}
+
+BOOST_AUTO_TEST_CASE (Sequence_packed) {
+    using namespace npge;
+    std::string seq_str = "NNTGGTCNGAGATGCGGNNNGCCCGTAAGCTTACATACAGGN";
+    PackedSequence packed;
+    packed.push_back(seq_str.substr(0, 19));
+    packed.push_back(seq_str.substr(19));
+    BOOST_REQUIRE(packed.size() == seq_str.size());
+    BOOST_CHECK(packed.contents() == seq_str);
+    packed.map_from_string("ANNA", 5);
+    seq_str.replace(5, 4, "ANNA");
+    BOOST_CHECK(packed.contents() == seq_str);
+    packed.map_from_string("AC", 0);
+    seq_str.replace(0, 2, "AC");
+    BOOST_CHECK(packed.contents() == seq_str);
+}
+
+BOOST_AUTO_TEST_CASE (Sequence_genome_index) {
+    using namespace npge;
+    std::vector<SequencePtr> seqs;
+    seqs.push_back(boost::make_shared<InMemorySequence>(
+                       "NNTGGTCNGAGATGCGGNNNGCCCGTAAGCTTACATACAGGN"));
+    seqs.push_back(boost::make_shared<PackedSequence>("ATGC"));
+    seqs.push_back(boost::make_shared<PackedSequence>(""));
+    seqs[0]->set_name("a&chr1&c");
+    seqs[0]->set_description("ac=123");
+    seqs[1]->set_name("b&chr1&l");
+    seqs[2]->set_name("empty");
+    std::string index = temp_file();
+    write_genome_index(seqs, index);
+    std::vector<SequencePtr> mapped = read_genome_index(index);
+    BOOST_REQUIRE(mapped.size() == seqs.size());
+    for (int i = 0; i < seqs.size(); i++) {
+        BOOST_CHECK(mapped[i]->name() == seqs[i]->name());
+        BOOST_CHECK(mapped[i]->description() ==
+                    seqs[i]->description());
+        BOOST_CHECK(mapped[i]->contents() == seqs[i]->contents());
+    }
+    BOOST_CHECK(mapped[0]->ac() == "123");
+    BOOST_CHECK_THROW(mapped[1]->push_back("A"), Exception);
+    mapped.clear();
+    remove_file(index);
+}
+
+static void patch_number(const std::string& file, size_t offset,
+                         uint64_t number) {
+    std::fstream f(file.c_str(), std::ios_base::in |
+                   std::ios_base::out | std::ios_base::binary);
+    f.seekp(offset);
+    f.write(reinterpret_cast<const char*>(&number), sizeof(number));
+}
+
+static uint64_t read_number(const std::string& file, size_t offset) {
+    std::ifstream f(file.c_str(), std::ios_base::binary);
+    f.seekg(offset);
+    uint64_t number = 0;
+    f.read(reinterpret_cast<char*>(&number), sizeof(number));
+    return number;
+}
+
+BOOST_AUTO_TEST_CASE (Sequence_genome_index_broken) {
+    using namespace npge;
+    std::vector<SequencePtr> seqs;
+    seqs.push_back(boost::make_shared<PackedSequence>("ATGCNNA"));
+    seqs[0]->set_name("a");
+    // magic, byte order mark, number of sequences
+    const size_t ENTRY = 8 + 8 + 8;
+    const size_t WORDS_SIZE = ENTRY + 2 * 8;
+    const size_t RUNS_OFFSET = ENTRY + 3 * 8;
+    std::string index = temp_file();
+    write_genome_index(seqs, index);
+    BOOST_REQUIRE(read_number(index, WORDS_SIZE) == 2);
+    patch_number(index, WORDS_SIZE, 1); // no padding word
+    BOOST_CHECK_THROW(read_genome_index(index), Exception);
+    write_genome_index(seqs, index);
+    uint64_t runs = read_number(index, RUNS_OFFSET);
+    BOOST_REQUIRE(read_number(index, runs) == 4);
+    BOOST_REQUIRE(read_number(index, runs + 8) == 6);
+    patch_number(index, runs + 8, 8); // after end of sequence
+    BOOST_CHECK_THROW(read_genome_index(index), Exception);
+    write_genome_index(seqs, index);
+    BOOST_CHECK(read_genome_index(index)[0]->contents() == "ATGCNNA");
+    BOOST_CHECK(!file_exists(index + ".tmp"));
+    remove_file(index);
 }
 
 BOOST_AUTO_TEST_CASE (Sequence_first_ori) {
@@ -113,6 +206,25 @@ BOOST_AUTO_TEST_CASE (Sequence_genome_chromosome) {
     BOOST_CHECK(circular);
 }
 
+BOOST_AUTO_TEST_CASE (Sequence_genome_id) {
+    using namespace npge;
+    CompactSequence s1("ATG"), s2("ATG"), s3("ATG");
+    BOOST_CHECK(s1.genome_id() == 0);
+    BOOST_CHECK(s1.chromosome_id() == 0);
+    s1.set_name("abc&chr1&c");
+    s2.set_name("abc&chr2&l");
+    s3.set_name("def&chr1&c");
+    BOOST_CHECK(s1.genome_id() == s2.genome_id());
+    BOOST_CHECK(s1.genome_id() != s3.genome_id());
+    BOOST_CHECK(s1.chromosome_id() != s2.chromosome_id());
+    BOOST_CHECK(s1.chromosome_id() == s3.chromosome_id());
+    BOOST_CHECK(s1.genome_id() > 0);
+    BOOST_CHECK(!s2.circular());
+    s2.set_name("abc");
+    BOOST_CHECK(s2.genome_id() == 0);
+    BOOST_CHECK(s2.chromosome_id() == 0);
+}
+
 BOOST_AUTO_TEST_CASE (Sequence_consensus_of_block) {
     using namespace npge;
     SequencePtr s1 = boost::make_shared<CompactSequence>("CAGGACGG");
@@ -5,65 +5,315 @@
  * See the LICENSE file for terms of use.
  */
 
-#include <cctype>
-#include <streambuf>
-#include <algorithm>
-#include <boost/algorithm/string/trim.hpp>
+#include <cstring>
+#include <istream>
+#include <vector>
+#include <boost/foreach.hpp>
 
 #include "FastaReader.hpp"
+#include "thread_pool.hpp"
+#include "cast.hpp"
+#include "Exception.hpp"
 
 namespace npge {
 
+// initial size of block
+const size_t BLOCK_SIZE = 1024 * 1024;
+
+// initial size of block if workers() != 1
+const size_t PARALLEL_BLOCK_SIZE = 16 * BLOCK_SIZE;
+
+// blocks smaller than this are parsed in current thread
+const size_t MIN_PARALLEL_SIZE = BLOCK_SIZE;
+
+// same as std::isspace in "C" locale
+static bool is_space(char c) {
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+/** Line or several lines of input */
+struct FastaEvent {
+    enum Type {
+        HEADER, // begin_-end_ is name, descr_begin_-end_ is description
+        DATA, // begin_-end_ is data (compacted in place)
+        EMPTY_LINE
+    };
+
+    Type type_;
+    size_t line_; // offset of first line in block
+    size_t begin_, end_;
+    size_t descr_begin_, descr_end_;
+
+    FastaEvent(Type type, size_t line):
+        type_(type), line_(line),
+        begin_(line), end_(line),
+        descr_begin_(line), descr_end_(line) {
+    }
+};
+
+typedef std::vector<FastaEvent> FastaEvents;
+
+/** Parse complete lines of block[from, to) */
+static void parse_lines(char* block, size_t from, size_t to,
+                        FastaEvents& events) {
+    const size_t NO_DATA = size_t(-1);
+    size_t data = NO_DATA; // index of current DATA event
+    size_t pos = from;
+    while (pos < to) {
+        const void* nl = std::memchr(block + pos, '\n', to - pos);
+        size_t line_end = nl ? static_cast<const char*>(nl) - block : to;
+        size_t next = nl ? line_end + 1 : to;
+        size_t b = pos, e = line_end;
+        while (b < e && is_space(block[b])) {
+            b += 1;
+        }
+        while (e > b && is_space(block[e - 1])) {
+            e -= 1;
+        }
+        if (b == e) {
+            events.push_back(FastaEvent(FastaEvent::EMPTY_LINE, pos));
+            data = NO_DATA;
+        } else if (block[b] == '>') {
+            FastaEvent event(FastaEvent::HEADER, pos);
+            size_t sp = b + 1;
+            while (sp < e && !is_space(block[sp])) {
+                sp += 1;
+            }
+            event.begin_ = b + 1;
+            event.end_ = sp;
+            size_t dp = sp;
+            while (dp < e && is_space(block[dp])) {
+                dp += 1;
+            }
+            event.descr_begin_ = dp;
+            event.descr_end_ = e;
+            events.push_back(event);
+            data = NO_DATA;
+        } else {
+            if (data == NO_DATA) {
+                data = events.size();
+                events.push_back(FastaEvent(FastaEvent::DATA, pos));
+            }
+            // data of several lines is moved to the beginning
+            // of the first line, write position <= read position
+            size_t& write = events[data].end_;
+            for (size_t i = b; i < e; i++) {
+                char c = block[i];
+                if (!is_space(c)) {
+                    block[write] = c;
+                    write += 1;
+                }
+            }
+        }
+        pos = next;
+    }
+}
+
+class ParseTG : public ReusingThreadGroup {
+public:
+    char* block_;
+    std::vector<size_t> bounds_;
+    std::vector<FastaEvents> events_; // by chunk
+    int next_chunk_;
+
+    ParseTG(char* block, size_t size, int workers):
+        block_(block), next_chunk_(0) {
+        set_workers(workers);
+        int chunks = this->workers() * 4;
+        bounds_.push_back(0);
+        for (int i = 1; i < chunks; i++) {
+            size_t target = size / chunks * i;
+            if (target <= bounds_.back()) {
+                continue;
+            }
+            const void* nl = std::memchr(block + target, '\n',
+                                         size - target);
+            if (!nl) {
+                break;
+            }
+            bounds_.push_back(static_cast<const char*>(nl) - block + 1);
+        }
+        if (bounds_.back() != size) {
+            bounds_.push_back(size);
+        }
+        events_.resize(bounds_.size() - 1);
+    }
+
+    ThreadTask* create_task_impl(ThreadWorker* worker);
+};
+
+class ParseTask : public ThreadTask {
+public:
+    int chunk_;
+
+    ParseTask(int chunk, ThreadWorker* worker):
+        ThreadTask(worker), chunk_(chunk) {
+    }
+
+    void run_impl() {
+        ParseTG* tg = D_CAST<ParseTG*>(thread_group());
+        parse_lines(tg->block_, tg->bounds_[chunk_],
+                    tg->bounds_[chunk_ + 1], tg->events_[chunk_]);
+    }
+};
+
+ThreadTask* ParseTG::create_task_impl(ThreadWorker* worker) {
+    if (next_chunk_ < events_.size()) {
+        int chunk = next_chunk_;
+        next_chunk_ += 1;
+        return new ParseTask(chunk, worker);
+    } else {
+        return 0;
+    }
+}
+
+struct FastaReader::Impl {
+    std::istream& input_;
+    bool found_empty_line_;
+    int workers_;
+
+    std::vector<char> block_;
+    size_t complete_; // size of complete lines in block_
+    size_t filled_; // size of data in block_
+    std::streamoff block_start_; // position of block_ in input_
+    bool eof_;
+
+    FastaEvents events_;
+    size_t next_event_;
+
+    Impl(std::istream& input):
+        input_(input), found_empty_line_(false), workers_(1),
+        complete_(0), filled_(0), eof_(false), next_event_(0) {
+        block_start_ = input_.tellg();
+    }
+
+    /** Read next block, return false if input is over */
+    bool read_block() {
+        // move incomplete line to beginning of block
+        size_t tail = filled_ - complete_;
+        if (tail) {
+            std::memmove(&block_[0], &block_[complete_], tail);
+        }
+        if (block_start_ != -1) {
+            block_start_ += complete_;
+        }
+        filled_ = tail;
+        complete_ = 0;
+        if (block_.empty()) {
+            block_.resize(workers_ == 1 ? BLOCK_SIZE : PARALLEL_BLOCK_SIZE);
+        }
+        while (!eof_) {
+            if (filled_ == block_.size()) {
+                // line is longer than block
+                block_.resize(block_.size() * 2);
+            }
+            input_.read(&block_[filled_], block_.size() - filled_);
+            filled_ += input_.gcount();
+            if (input_.bad()) {
+                throw Exception("Error reading FASTA input");
+            }
+            if (!input_) {
+                eof_ = true;
+                break;
+            }
+            for (size_t i = filled_; i > tail; i--) {
+                if (block_[i - 1] == '\n') {
+                    complete_ = i;
+                    break;
+                }
+            }
+            if (complete_) {
+                break;
+            }
+            tail = filled_;
+        }
+        if (eof_) {
+            complete_ = filled_;
+        }
+        return complete_ != 0;
+    }
+
+    void parse_block() {
+        events_.clear();
+        next_event_ = 0;
+        if (workers_ == 1 || complete_ < MIN_PARALLEL_SIZE) {
+            parse_lines(&block_[0], 0, complete_, events_);
+        } else {
+            ParseTG tg(&block_[0], complete_, workers_);
+            tg.perform();
+            BOOST_FOREACH (const FastaEvents& events, tg.events_) {
+                events_.insert(events_.end(), events.begin(),
+                               events.end());
+            }
+        }
+    }
+
+    /** Return next event or 0, do not move to next event */
+    const FastaEvent* peek() {
+        while (next_event_ == events_.size()) {
+            if (!read_block()) {
+                return 0;
+            }
+            parse_block();
+        }
+        return &events_[next_event_];
+    }
+
+    std::string str(size_t begin, size_t end) const {
+        return std::string(&block_[0] + begin, end - begin);
+    }
+
+    void return_unparsed() {
+        size_t offset;
+        if (next_event_ < events_.size()) {
+            offset = events_[next_event_].line_;
+        } else {
+            offset = complete_;
+        }
+        if (offset < filled_ && block_start_ != -1) {
+            input_.clear();
+            input_.seekg(block_start_ + offset);
+        }
+    }
+};
+
 FastaReader::FastaReader(std::istream& input):
-    input_(input), found_empty_line_(false) {
+    impl_(new Impl(input)) {
+}
+
+FastaReader::~FastaReader() {
+    impl_->return_unparsed();
+    delete impl_;
+    impl_ = 0;
 }
 
 bool FastaReader::read_one_sequence() {
     bool in_sequence = false;
-    std::streampos line_start = input_.tellg();
-    for (std::string line; std::getline(input_, line);) {
-        boost::algorithm::trim(line);
-        std::streamoff line_size = line.size();
-        if (line.empty()) {
+    while (const FastaEvent* event = impl_->peek()) {
+        if (event->type_ == FastaEvent::EMPTY_LINE) {
+            impl_->next_event_ += 1;
             empty_line_found(); // TODO test for this
-            found_empty_line_ = true;
-        } else if (line_size >= 1 && line[0] == '>') {
+            impl_->found_empty_line_ = true;
+        } else if (event->type_ == FastaEvent::HEADER) {
             if (!in_sequence) {
                 in_sequence = true;
-                std::string name;
-                std::string description;
-                if (line.size() >= 2) {
-                    size_t sp = std::string::npos;
-                    size_t s = line.size();
-                    for (size_t i = 0; i < s; i++) {
-                        if (isspace(line[i])) {
-                            sp = i;
-                            break;
-                        }
-                    }
-                    name = line.substr(1, sp - 1);
-                    if (sp != std::string::npos) {
-                        size_t dp = sp + 1;
-                        while (dp < s && isspace(line[dp])) {
-                            dp += 1;
-                        }
-                        if (dp < s) {
-                            description = line.substr(dp);
-                        }
-                    }
-                }
+                impl_->next_event_ += 1;
+                std::string name = impl_->str(event->begin_,
+                                              event->end_);
+                std::string description = impl_->str(event->descr_begin_,
+                                                     event->descr_end_);
                 new_sequence(name, description);
             } else {
-                // go to the beginning of current line
-                input_.seekg(line_start);
+                // leave the header for next call
                 return true;
             }
-        } else if (in_sequence) {
-            line.erase(std::remove_if(line.begin(), line.end(), isspace),
-                       line.end());
-            grow_sequence(line);
+        } else {
+            impl_->next_event_ += 1;
+            if (in_sequence) {
+                grow_sequence_view(&impl_->block_[0] + event->begin_,
+                                   event->end_ - event->begin_);
+            }
         }
-        line_start = input_.tellg();
     }
     return in_sequence;
 }
@@ -71,10 +321,10 @@ bool FastaReader::read_one_sequence() {
 bool FastaReader::read_until_empty_line() {
     bool result = false;
     while (true) {
-        found_empty_line_ = false;
+        impl_->found_empty_line_ = false;
         bool ok = read_one_sequence();
         result |= ok;
-        if (found_empty_line_ || !ok) {
+        if (impl_->found_empty_line_ || !ok) {
             break;
         }
     }
@@ -89,6 +339,18 @@ bool FastaReader::read_all_sequences() {
     return result;
 }
 
+int FastaReader::workers() const {
+    return impl_->workers_;
+}
+
+void FastaReader::set_workers(int workers) {
+    impl_->workers_ = workers;
+}
+
+void FastaReader::grow_sequence_view(const char* data, size_t size) {
+    grow_sequence(std::string(data, size));
+}
+
 void FastaReader::empty_line_found() {
 }
 
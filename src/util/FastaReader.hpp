@@ -15,27 +15,62 @@
 
 namespace npge {
 
+/** Reader of FASTA files.
+
+Input is read by large blocks. Lines are found with memchr,
+sequence data is compacted in place (whitespaces removed)
+and passed to grow_sequence_view() as pointers to the block.
+If workers() != 1, large blocks are split at line boundaries
+and parsed on the thread pool; callbacks are still called
+in order of the input, from the thread calling read_*().
+*/
 class FastaReader {
 public:
+    /** Constructor */
     FastaReader(std::istream& input);
 
+    /** Destructor.
+    Data read from the input, but not passed to callbacks
+    (e.g., next sequences after read_one_sequence()),
+    is returned to the input (seekg), so it can be
+    read by other readers.
+    */
+    virtual ~FastaReader();
+
     bool read_one_sequence();
 
     bool read_until_empty_line();
 
     bool read_all_sequences();
 
+    /** Return number of threads used to parse the input */
+    int workers() const;
+
+    /** Set number of threads used to parse the input.
+    Default is 1 (parse in current thread).
+    Value -1 means number of CPUs.
+    */
+    void set_workers(int workers);
+
 protected:
     virtual void new_sequence(const std::string& name,
                               const std::string& description) = 0;
 
     virtual void grow_sequence(const std::string& data) = 0;
 
+    /** Add data to current sequence.
+    The data is valid only during the call.
+    Default implementation calls grow_sequence().
+    Override it to avoid copying of data.
+    */
+    virtual void grow_sequence_view(const char* data, size_t size);
+
     virtual void empty_line_found();
 
 private:
-    std::istream& input_;
-    bool found_empty_line_;
+    struct Impl;
+
+    Impl* impl_;
 };
 
 }
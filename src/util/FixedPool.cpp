@@ -0,0 +1,162 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <new>
+#include "boost-xtime.hpp"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
+
+#include "FixedPool.hpp"
+
+namespace npge {
+
+typedef boost::mutex Mutex;
+typedef boost::mutex::scoped_lock Lock;
+
+// pieces in one chunk taken from the system
+const size_t CHUNK_PIECES = 1024;
+
+// pieces moved between thread's list and common list at once
+const size_t BATCH = 256;
+
+// alignment of pieces
+const size_t ALIGNMENT = 2 * sizeof(void*);
+
+struct Piece {
+    Piece* next_;
+};
+
+struct FreeList {
+    Piece* head_;
+    size_t size_;
+
+    FreeList():
+        head_(0), size_(0) {
+    }
+
+    void push(Piece* piece) {
+        piece->next_ = head_;
+        head_ = piece;
+        size_ += 1;
+    }
+
+    Piece* pop() {
+        Piece* piece = head_;
+        head_ = piece->next_;
+        size_ -= 1;
+        return piece;
+    }
+
+    /** Move up to n pieces to other list */
+    void move_to(FreeList& other, size_t n) {
+        for (size_t i = 0; i < n && head_; i++) {
+            other.push(pop());
+        }
+    }
+};
+
+struct FixedPool::Impl {
+    struct ThreadCache {
+        Impl* pool_;
+        FreeList free_;
+
+        ThreadCache(Impl* pool):
+            pool_(pool) {
+        }
+
+        ~ThreadCache() {
+            // called when thread exits
+            pool_->give_back(free_, free_.size_);
+        }
+    };
+
+    size_t size_;
+    Mutex mutex_;
+    FreeList common_;
+    size_t reserved_;
+    boost::thread_specific_ptr<ThreadCache> cache_;
+
+    Impl(size_t size):
+        reserved_(0) {
+        if (size < sizeof(Piece)) {
+            size = sizeof(Piece);
+        }
+        size_ = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /** Return list of free pieces of current thread */
+    FreeList& thread_list() {
+        ThreadCache* cache = cache_.get();
+        if (!cache) {
+            cache = new ThreadCache(this);
+            cache_.reset(cache);
+        }
+        return cache->free_;
+    }
+
+    /** Add BATCH free pieces to list (under mutex) */
+    void refill(FreeList& list) {
+        Lock lock(mutex_);
+        if (common_.size_ < BATCH) {
+            char* chunk = static_cast<char*>(
+                              ::operator new(size_ * CHUNK_PIECES));
+            reserved_ += size_ * CHUNK_PIECES;
+            // pieces of one chunk are given out together
+            for (size_t i = CHUNK_PIECES; i > 0; i--) {
+                common_.push(reinterpret_cast<Piece*>(
+                                 chunk + (i - 1) * size_));
+            }
+        }
+        common_.move_to(list, BATCH);
+    }
+
+    /** Move n pieces from list to common list (under mutex) */
+    void give_back(FreeList& list, size_t n) {
+        Lock lock(mutex_);
+        list.move_to(common_, n);
+    }
+};
+
+FixedPool::FixedPool(size_t size):
+    impl_(new Impl(size)) {
+}
+
+FixedPool::~FixedPool() {
+    // pieces of chunks may be in use, chunks are not freed
+    delete impl_;
+}
+
+size_t FixedPool::size() const {
+    return impl_->size_;
+}
+
+void* FixedPool::allocate() {
+    FreeList& list = impl_->thread_list();
+    if (!list.head_) {
+        impl_->refill(list);
+    }
+    return list.pop();
+}
+
+void FixedPool::deallocate(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    FreeList& list = impl_->thread_list();
+    list.push(static_cast<Piece*>(ptr));
+    if (list.size_ >= 2 * BATCH) {
+        impl_->give_back(list, BATCH);
+    }
+}
+
+size_t FixedPool::reserved() const {
+    Lock lock(impl_->mutex_);
+    return impl_->reserved_;
+}
+
+}
+
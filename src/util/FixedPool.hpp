@@ -0,0 +1,61 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_FIXED_POOL_HPP_
+#define NPGE_FIXED_POOL_HPP_
+
+#include <cstddef>
+#include <boost/utility.hpp>
+
+namespace npge {
+
+/** Pool of memory pieces of fixed size.
+Memory is taken from the system by large chunks,
+so objects allocated one after another are contiguous.
+Freed pieces are reused and are never returned to the system.
+
+Each thread keeps its own list of free pieces and exchanges
+them with the common list in batches, so most of allocations
+do not lock a mutex.
+
+This class is thread-safe.
+*/
+class FixedPool : boost::noncopyable {
+public:
+    /** Constructor.
+    \param size Size of a piece.
+    */
+    FixedPool(size_t size);
+
+    /** Destructor.
+    Memory of the pool is not freed (pieces may be in use),
+    so pools are usually created once and never deleted.
+    Other threads using the pool must be finished.
+    */
+    ~FixedPool();
+
+    /** Return size of a piece */
+    size_t size() const;
+
+    /** Allocate a piece */
+    void* allocate();
+
+    /** Return the piece to the pool */
+    void deallocate(void* ptr);
+
+    /** Return number of bytes taken from the system */
+    size_t reserved() const;
+
+private:
+    struct Impl;
+    Impl* impl_;
+};
+
+}
+
+#endif
+
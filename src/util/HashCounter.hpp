@@ -0,0 +1,157 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_HASH_COUNTER_HPP_
+#define NPGE_HASH_COUNTER_HPP_
+
+#include <vector>
+
+#include "global.hpp"
+#include "HashSet.hpp"
+
+namespace npge {
+
+/** Numbers of occurrences of hashes (open addressing, linear probing).
+Adding and lookup take O(1).
+Table size is a power of two, load factor is <= 1/2.
+Counts saturate at MAX_COUNT.
+\see HashSet
+*/
+template<typename H>
+class HashCounter {
+public:
+    /** Type of count */
+    typedef uint32_t Count;
+
+    /** Maximum count, larger counts are stored as this value */
+    static const Count MAX_COUNT = ~Count(0);
+
+    /** Constructor */
+    HashCounter():
+        size_(0), empty_count_(0) {
+    }
+
+    /** Return number of different hashes */
+    size_t size() const {
+        return size_;
+    }
+
+    /** Return if no hashes were added */
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    /** Remove all hashes */
+    void clear() {
+        std::vector<H>().swap(table_);
+        std::vector<Count>().swap(counts_);
+        size_ = 0;
+        empty_count_ = 0;
+    }
+
+    /** Return number of occurrences of the hash */
+    Count count(const H& hash) const {
+        if (hash == EmptyHash<H>::value()) {
+            return empty_count_;
+        }
+        if (table_.empty()) {
+            return 0;
+        }
+        size_t mask = table_.size() - 1;
+        for (size_t i = first_cell(hash); ; i = (i + 1) & mask) {
+            const H& cell = table_[i];
+            if (cell == hash) {
+                return counts_[i];
+            } else if (cell == EmptyHash<H>::value()) {
+                return 0;
+            }
+        }
+    }
+
+    /** Add one occurrence of the hash */
+    void add(const H& hash) {
+        if (hash == EmptyHash<H>::value()) {
+            if (empty_count_ == 0) {
+                size_ += 1;
+            }
+            increase(empty_count_);
+            return;
+        }
+        if ((size_ + 1) * 2 > table_.size()) {
+            rehash(table_.empty() ? MIN_CELLS : table_.size() * 2);
+        }
+        size_t i = find_cell(hash);
+        if (table_[i] == EmptyHash<H>::value()) {
+            table_[i] = hash;
+            size_ += 1;
+        }
+        increase(counts_[i]);
+    }
+
+    /** Append hashes with count in [min_count, max_count] (unordered) */
+    void elements(std::vector<H>& result,
+                  Count min_count, Count max_count) const {
+        if (empty_count_ && empty_count_ >= min_count &&
+                empty_count_ <= max_count) {
+            result.push_back(EmptyHash<H>::value());
+        }
+        for (size_t i = 0; i < table_.size(); i++) {
+            if (table_[i] != EmptyHash<H>::value() &&
+                    counts_[i] >= min_count && counts_[i] <= max_count) {
+                result.push_back(table_[i]);
+            }
+        }
+    }
+
+private:
+    std::vector<H> table_;
+    std::vector<Count> counts_;
+    size_t size_;
+    Count empty_count_;
+
+    static const size_t MIN_CELLS = 64;
+
+    static void increase(Count& count) {
+        if (count != MAX_COUNT) {
+            count += 1;
+        }
+    }
+
+    size_t first_cell(const H& hash) const {
+        return mix_hash(fold_hash(hash)) & (table_.size() - 1);
+    }
+
+    // cell of the hash or free cell
+    size_t find_cell(const H& hash) const {
+        size_t mask = table_.size() - 1;
+        for (size_t i = first_cell(hash); ; i = (i + 1) & mask) {
+            const H& cell = table_[i];
+            if (cell == hash || cell == EmptyHash<H>::value()) {
+                return i;
+            }
+        }
+    }
+
+    void rehash(size_t cells) {
+        std::vector<H> old_table(cells, EmptyHash<H>::value());
+        std::vector<Count> old_counts(cells, 0);
+        old_table.swap(table_);
+        old_counts.swap(counts_);
+        for (size_t i = 0; i < old_table.size(); i++) {
+            if (old_table[i] != EmptyHash<H>::value()) {
+                size_t j = find_cell(old_table[i]);
+                table_[j] = old_table[i];
+                counts_[j] = old_counts[i];
+            }
+        }
+    }
+};
+
+}
+
+#endif
+
@@ -0,0 +1,202 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_HASH_SET_HPP_
+#define NPGE_HASH_SET_HPP_
+
+#include <vector>
+#include <algorithm>
+#include <istream>
+#include <ostream>
+
+#include "global.hpp"
+#include "hash128.hpp"
+#include "make_hash.hpp"
+
+namespace npge {
+
+/** Value of free cell of HashSet */
+template<typename H>
+struct EmptyHash;
+
+template<>
+struct EmptyHash<hash_t> {
+    static hash_t value() {
+        return ~hash_t(0);
+    }
+};
+
+template<>
+struct EmptyHash<hash128_t> {
+    static hash128_t value() {
+        return hash128_t(~uint64_t(0), ~uint64_t(0));
+    }
+};
+
+/** Set of hashes (open addressing, linear probing).
+Membership test and insertion take O(1).
+Table size is a power of two, load factor is <= 1/2.
+Value EmptyHash<H>::value() (all bits set) marks free cells;
+it can be inserted too (it is stored separately).
+*/
+template<typename H>
+class HashSet {
+public:
+    /** Constructor */
+    HashSet():
+        size_(0), has_empty_(false) {
+    }
+
+    /** Return number of elements */
+    size_t size() const {
+        return size_;
+    }
+
+    /** Return if the set has no elements */
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    /** Remove all elements */
+    void clear() {
+        std::vector<H>().swap(table_);
+        size_ = 0;
+        has_empty_ = false;
+    }
+
+    /** Return if the set contains the element */
+    bool has_elem(const H& hash) const {
+        if (hash == EmptyHash<H>::value()) {
+            return has_empty_;
+        }
+        if (table_.empty()) {
+            return false;
+        }
+        size_t mask = table_.size() - 1;
+        for (size_t i = first_cell(hash); ; i = (i + 1) & mask) {
+            const H& cell = table_[i];
+            if (cell == hash) {
+                return true;
+            } else if (cell == EmptyHash<H>::value()) {
+                return false;
+            }
+        }
+    }
+
+    /** Add the element.
+    Return false if the element was already in the set.
+    */
+    bool insert(const H& hash) {
+        if (hash == EmptyHash<H>::value()) {
+            bool result = !has_empty_;
+            if (result) {
+                has_empty_ = true;
+                size_ += 1;
+            }
+            return result;
+        }
+        if ((size_ + 1) * 2 > table_.size()) {
+            rehash(table_.empty() ? MIN_CELLS : table_.size() * 2);
+        }
+        bool result = insert_to_table(hash);
+        if (result) {
+            size_ += 1;
+        }
+        return result;
+    }
+
+    /** Append all elements to the vector (unordered) */
+    void elements(std::vector<H>& result) const {
+        if (has_empty_) {
+            result.push_back(EmptyHash<H>::value());
+        }
+        for (size_t i = 0; i < table_.size(); i++) {
+            if (table_[i] != EmptyHash<H>::value()) {
+                result.push_back(table_[i]);
+            }
+        }
+    }
+
+    /** Write elements to binary stream.
+    Format: number of elements, elements (native byte order).
+    */
+    void write(std::ostream& out) const {
+        std::vector<H> hashes;
+        elements(hashes);
+        uint64_t n = hashes.size();
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+        if (n) {
+            out.write(reinterpret_cast<const char*>(&hashes[0]),
+                      sizeof(H) * n);
+        }
+    }
+
+    /** Add elements read from binary stream.
+    Return false on error.
+    \see write
+    */
+    bool read(std::istream& in) {
+        uint64_t n;
+        if (!in.read(reinterpret_cast<char*>(&n), sizeof(n))) {
+            return false;
+        }
+        const size_t BUFFER = 4096;
+        std::vector<H> hashes;
+        while (n > 0) {
+            size_t chunk = std::min(uint64_t(BUFFER), n);
+            hashes.resize(chunk);
+            if (!in.read(reinterpret_cast<char*>(&hashes[0]),
+                         sizeof(H) * chunk)) {
+                return false;
+            }
+            for (size_t i = 0; i < chunk; i++) {
+                insert(hashes[i]);
+            }
+            n -= chunk;
+        }
+        return true;
+    }
+
+private:
+    std::vector<H> table_;
+    size_t size_;
+    bool has_empty_;
+
+    static const size_t MIN_CELLS = 64;
+
+    size_t first_cell(const H& hash) const {
+        return mix_hash(fold_hash(hash)) & (table_.size() - 1);
+    }
+
+    bool insert_to_table(const H& hash) {
+        size_t mask = table_.size() - 1;
+        for (size_t i = first_cell(hash); ; i = (i + 1) & mask) {
+            H& cell = table_[i];
+            if (cell == hash) {
+                return false;
+            } else if (cell == EmptyHash<H>::value()) {
+                cell = hash;
+                return true;
+            }
+        }
+    }
+
+    void rehash(size_t cells) {
+        std::vector<H> old(cells, EmptyHash<H>::value());
+        old.swap(table_);
+        for (size_t i = 0; i < old.size(); i++) {
+            if (old[i] != EmptyHash<H>::value()) {
+                insert_to_table(old[i]);
+            }
+        }
+    }
+};
+
+}
+
+#endif
+
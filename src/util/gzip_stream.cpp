@@ -0,0 +1,413 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#include <cstring>
+#include <deque>
+#include <vector>
+#include <istream>
+#include <ostream>
+#include <streambuf>
+#include <zlib.h>
+#include "boost-xtime.hpp"
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/algorithm/string/predicate.hpp>
+
+#include "gzip_stream.hpp"
+#include "thread_group.hpp"
+#include "Exception.hpp"
+#include "cast.hpp"
+
+namespace npge {
+
+typedef boost::mutex Mutex;
+typedef boost::mutex::scoped_lock Lock;
+typedef boost::condition_variable Condition;
+
+bool is_gzip_name(const std::string& name) {
+    using namespace boost::algorithm;
+    return ends_with(name, ".gz");
+}
+
+// BGZF: gzip member with extra field "BC" storing size of member
+// minus 1. Size of member is at most 64 KiB.
+
+const size_t BGZF_INPUT_SIZE = 0xff00;
+const size_t BGZF_HEADER_SIZE = 18;
+const size_t BGZF_FOOTER_SIZE = 8;
+const size_t BGZF_MAX_SIZE = 0x10000;
+
+static void put_uint16(std::string& out, size_t pos, uint32_t value) {
+    out[pos] = char(value & 0xff);
+    out[pos + 1] = char((value >> 8) & 0xff);
+}
+
+static void put_uint32(std::string& out, size_t pos, uint32_t value) {
+    put_uint16(out, pos, value & 0xffff);
+    put_uint16(out, pos + 2, value >> 16);
+}
+
+static bool deflate_raw(const std::string& in, std::string& out,
+                        int level) {
+    z_stream zs;
+    std::memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, level, Z_DEFLATED, -15, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw Exception("Error initializing zlib");
+    }
+    size_t max_data = BGZF_MAX_SIZE - BGZF_HEADER_SIZE -
+                      BGZF_FOOTER_SIZE;
+    out.resize(BGZF_HEADER_SIZE + max_data);
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = in.size();
+    zs.next_out = reinterpret_cast<Bytef*>(&out[BGZF_HEADER_SIZE]);
+    zs.avail_out = max_data;
+    int status = deflate(&zs, Z_FINISH);
+    out.resize(BGZF_HEADER_SIZE + zs.total_out);
+    deflateEnd(&zs);
+    return status == Z_STREAM_END;
+}
+
+/** Compress data (at most BGZF_INPUT_SIZE bytes) to BGZF member */
+static void compress_block(const std::string& in, std::string& out) {
+    if (!deflate_raw(in, out, Z_DEFAULT_COMPRESSION)) {
+        // incompressible data, stored blocks fit for sure
+        if (!deflate_raw(in, out, 0)) {
+            throw Exception("Error compressing data");
+        }
+    }
+    const unsigned char HEADER[BGZF_HEADER_SIZE] = {
+        31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0
+    };
+    std::memcpy(&out[0], HEADER, BGZF_HEADER_SIZE);
+    size_t size = out.size() + BGZF_FOOTER_SIZE;
+    put_uint16(out, BGZF_HEADER_SIZE - 2, size - 1);
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, reinterpret_cast<const Bytef*>(in.data()),
+                in.size());
+    out.resize(size);
+    put_uint32(out, size - BGZF_FOOTER_SIZE, crc);
+    put_uint32(out, size - BGZF_FOOTER_SIZE + 4, in.size());
+}
+
+// Own threads are used instead of the global ThreadPool:
+// the stream can be written while all threads of the pool
+// wait for the writer (see AbstractOutput).
+class CompressTG : public ThreadGroup {
+public:
+    std::vector<std::string>& in_;
+    std::vector<std::string>& out_;
+    int next_;
+
+    CompressTG(std::vector<std::string>& in,
+               std::vector<std::string>& out, int workers):
+        in_(in), out_(out), next_(0) {
+        set_workers(workers);
+        out_.resize(in_.size());
+    }
+
+    ThreadTask* create_task_impl(ThreadWorker* worker);
+};
+
+class CompressTask : public ThreadTask {
+public:
+    int block_;
+
+    CompressTask(int block, ThreadWorker* worker):
+        ThreadTask(worker), block_(block) {
+    }
+
+    void run_impl() {
+        CompressTG* tg = D_CAST<CompressTG*>(thread_group());
+        compress_block(tg->in_[block_], tg->out_[block_]);
+    }
+};
+
+ThreadTask* CompressTG::create_task_impl(ThreadWorker* worker) {
+    if (next_ < in_.size()) {
+        int block = next_;
+        next_ += 1;
+        return new CompressTask(block, worker);
+    } else {
+        return 0;
+    }
+}
+
+class GzipOutBuf : public std::streambuf {
+public:
+    GzipOutBuf(boost::shared_ptr<std::ostream> output, int workers):
+        output_(output), workers_(workers),
+        buffer_(BGZF_INPUT_SIZE), closed_(false) {
+        setp(&buffer_[0], &buffer_[0] + buffer_.size());
+        if (workers_ == -1) {
+            workers_ = boost::thread::hardware_concurrency();
+        }
+        if (workers_ < 1) {
+            workers_ = 1;
+        }
+    }
+
+    void close() {
+        if (!closed_) {
+            closed_ = true;
+            finish_block();
+            write_pending();
+            // BGZF EOF marker: empty member
+            std::string eof;
+            compress_block(std::string(), eof);
+            output_->write(eof.c_str(), eof.size());
+            output_->flush();
+        }
+    }
+
+protected:
+    int overflow(int c) {
+        finish_block();
+        if (c != traits_type::eof()) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() {
+        finish_block();
+        write_pending();
+        output_->flush();
+        return output_->good() ? 0 : -1;
+    }
+
+private:
+    boost::shared_ptr<std::ostream> output_;
+    int workers_;
+    std::vector<char> buffer_;
+    std::vector<std::string> pending_;
+    bool closed_;
+
+    void finish_block() {
+        if (pptr() != pbase()) {
+            pending_.push_back(std::string(pbase(), pptr()));
+            setp(&buffer_[0], &buffer_[0] + buffer_.size());
+            if (pending_.size() >= workers_ * 4) {
+                write_pending();
+            }
+        }
+    }
+
+    void write_pending() {
+        std::vector<std::string> compressed;
+        if (workers_ == 1 || pending_.size() == 1) {
+            compressed.resize(pending_.size());
+            for (int i = 0; i < pending_.size(); i++) {
+                compress_block(pending_[i], compressed[i]);
+            }
+        } else {
+            CompressTG tg(pending_, compressed, workers_);
+            tg.perform();
+        }
+        for (int i = 0; i < compressed.size(); i++) {
+            output_->write(compressed[i].c_str(), compressed[i].size());
+        }
+        pending_.clear();
+    }
+};
+
+class GzipOstream : public std::ostream {
+public:
+    GzipOstream(boost::shared_ptr<std::ostream> output, int workers):
+        std::ostream(0), buf_(output, workers) {
+        rdbuf(&buf_);
+    }
+
+    ~GzipOstream() {
+        try {
+            buf_.close();
+        } catch (...) {
+        }
+    }
+
+private:
+    GzipOutBuf buf_;
+};
+
+boost::shared_ptr<std::ostream> gzip_ostream(
+    boost::shared_ptr<std::ostream> output, int workers) {
+    return boost::make_shared<GzipOstream>(output, workers);
+}
+
+// size of compressed data read at once
+const size_t INPUT_CHUNK = 256 * 1024;
+
+// size of decompressed chunk
+const size_t OUTPUT_CHUNK = 1024 * 1024;
+
+// number of decompressed chunks waiting in queue
+const size_t MAX_QUEUE = 4;
+
+class GzipInBuf : public std::streambuf {
+public:
+    GzipInBuf(boost::shared_ptr<std::istream> input):
+        input_(input), finished_(false), stop_(false) {
+        setg(0, 0, 0);
+        thread_ = boost::thread(boost::bind(&GzipInBuf::read_ahead,
+                                            this));
+    }
+
+    ~GzipInBuf() {
+        {
+            Lock lock(mutex_);
+            stop_ = true;
+        }
+        condition_.notify_all();
+        thread_.join();
+    }
+
+protected:
+    int underflow() {
+        if (gptr() < egptr()) {
+            return traits_type::to_int_type(*gptr());
+        }
+        Lock lock(mutex_);
+        while (queue_.empty() && !finished_) {
+            condition_.wait(lock);
+        }
+        if (queue_.empty()) {
+            if (!error_.empty()) {
+                throw Exception(error_);
+            }
+            return traits_type::eof();
+        }
+        current_.swap(queue_.front());
+        queue_.pop_front();
+        condition_.notify_all();
+        char* data = &current_[0];
+        setg(data, data, data + current_.size());
+        return traits_type::to_int_type(*gptr());
+    }
+
+private:
+    boost::shared_ptr<std::istream> input_;
+    boost::thread thread_;
+    Mutex mutex_;
+    Condition condition_;
+    std::deque<std::string> queue_;
+    std::string current_;
+    std::string error_;
+    bool finished_;
+    bool stop_;
+
+    /** Add decompressed chunk, return false if stopped */
+    bool push(std::string& chunk) {
+        Lock lock(mutex_);
+        while (queue_.size() >= MAX_QUEUE && !stop_) {
+            condition_.wait(lock);
+        }
+        if (stop_) {
+            return false;
+        }
+        queue_.push_back(std::string());
+        queue_.back().swap(chunk);
+        condition_.notify_all();
+        return true;
+    }
+
+    void finish(const std::string& error) {
+        Lock lock(mutex_);
+        error_ = error;
+        finished_ = true;
+        condition_.notify_all();
+    }
+
+    void read_ahead() {
+        try {
+            finish(decompress());
+        } catch (std::exception& e) {
+            finish(e.what());
+        } catch (...) {
+            finish("Unknown error in gzip stream");
+        }
+    }
+
+    /** Decompress all input, return error message or empty string */
+    std::string decompress() {
+        z_stream zs;
+        std::memset(&zs, 0, sizeof(zs));
+        // 32 means automatic detection of gzip or zlib header
+        if (inflateInit2(&zs, 15 + 32) != Z_OK) {
+            return "Error initializing zlib";
+        }
+        std::vector<char> in(INPUT_CHUNK);
+        std::string out(OUTPUT_CHUNK, '\0');
+        size_t out_size = 0;
+        bool in_member = false;
+        std::string error;
+        while (true) {
+            if (zs.avail_in == 0) {
+                input_->read(&in[0], in.size());
+                zs.avail_in = input_->gcount();
+                zs.next_in = reinterpret_cast<Bytef*>(&in[0]);
+                if (zs.avail_in == 0) {
+                    if (in_member) {
+                        error = "Unexpected end of gzip stream";
+                    }
+                    break;
+                }
+            }
+            zs.next_out = reinterpret_cast<Bytef*>(&out[out_size]);
+            zs.avail_out = out.size() - out_size;
+            in_member = true;
+            int status = inflate(&zs, Z_NO_FLUSH);
+            out_size = out.size() - zs.avail_out;
+            if (status == Z_STREAM_END) {
+                // next member may follow
+                inflateReset(&zs);
+                in_member = false;
+            } else if (status != Z_OK && status != Z_BUF_ERROR) {
+                error = "Error in gzip stream: " +
+                        std::string(zs.msg ? zs.msg : TO_S(status));
+                break;
+            }
+            if (out_size == out.size()) {
+                if (!push(out)) {
+                    break;
+                }
+                out.resize(OUTPUT_CHUNK);
+                out_size = 0;
+            }
+        }
+        inflateEnd(&zs);
+        if (out_size && error.empty()) {
+            out.resize(out_size);
+            push(out);
+        }
+        return error;
+    }
+};
+
+class GzipIstream : public std::istream {
+public:
+    GzipIstream(boost::shared_ptr<std::istream> input):
+        std::istream(0), buf_(input) {
+        rdbuf(&buf_);
+        // errors of decompression are thrown to reader
+        exceptions(std::ios_base::badbit);
+    }
+
+private:
+    GzipInBuf buf_;
+};
+
+boost::shared_ptr<std::istream> gzip_istream(
+    boost::shared_ptr<std::istream> input) {
+    return boost::make_shared<GzipIstream>(input);
+}
+
+}
+
@@ -0,0 +1,48 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_GZIP_STREAM_HPP_
+#define NPGE_GZIP_STREAM_HPP_
+
+#include <iosfwd>
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+namespace npge {
+
+/** Return if file name has extension of gzip file (.gz) */
+bool is_gzip_name(const std::string& name);
+
+/** Return output stream compressing data to BGZF format.
+Data is split into blocks of less than 64 KiB, each block is
+compressed independently as a gzip member with BGZF extra field,
+so the output can be read by gzip and by tools using BGZF
+(and is seekable by block offsets).
+Blocks are compressed in batches by several threads
+(workers = -1 means number of CPUs) and are written in order.
+The threads are not taken from ThreadPool, so the stream
+can be written from threads of the pool.
+Data is finished (with BGZF EOF block) when the stream
+is destroyed.
+*/
+boost::shared_ptr<std::ostream> gzip_ostream(
+    boost::shared_ptr<std::ostream> output, int workers = -1);
+
+/** Return input stream decompressing gzip data.
+Several gzip members (e.g., BGZF) are read one after another.
+Decompression is done in separate thread, which reads ahead
+while the data is being consumed.
+Truncated or corrupt data results in Exception thrown
+from reading functions of the stream.
+*/
+boost::shared_ptr<std::istream> gzip_istream(
+    boost::shared_ptr<std::istream> input);
+
+}
+
+#endif
+
@@ -0,0 +1,102 @@
+/*
+ * NPG-explorer, Nucleotide PanGenome explorer
+ * Copyright (C) 2012-2016 Boris Nagaev
+ *
+ * See the LICENSE file for terms of use.
+ */
+
+#ifndef NPGE_HASH128_HPP_
+#define NPGE_HASH128_HPP_
+
+#include "global.hpp"
+
+namespace npge {
+
+/** 128-bit hash value.
+Supports bit operations used by make_hash and reuse_hash,
+so it can be used instead of hash_t for fragments
+longer than MAX_ANCHOR_SIZE.
+*/
+struct hash128_t {
+    uint64_t lo_; ///< Bits 0-63
+    uint64_t hi_; ///< Bits 64-127
+
+    /** Constructor */
+    hash128_t(uint64_t lo = 0, uint64_t hi = 0):
+        lo_(lo), hi_(hi) {
+    }
+
+    hash128_t& operator^=(const hash128_t& o) {
+        lo_ ^= o.lo_;
+        hi_ ^= o.hi_;
+        return *this;
+    }
+
+    hash128_t operator<<(int shift) const {
+        if (shift == 0) {
+            return *this;
+        } else if (shift < 64) {
+            return hash128_t(lo_ << shift,
+                             (hi_ << shift) | (lo_ >> (64 - shift)));
+        } else {
+            return hash128_t(0, lo_ << (shift - 64));
+        }
+    }
+
+    hash128_t operator>>(int shift) const {
+        if (shift == 0) {
+            return *this;
+        } else if (shift < 64) {
+            return hash128_t((lo_ >> shift) | (hi_ << (64 - shift)),
+                             hi_ >> shift);
+        } else {
+            return hash128_t(hi_ >> (shift - 64), 0);
+        }
+    }
+
+    bool operator==(const hash128_t& o) const {
+        return lo_ == o.lo_ && hi_ == o.hi_;
+    }
+
+    bool operator!=(const hash128_t& o) const {
+        return !(*this == o);
+    }
+
+    bool operator<(const hash128_t& o) const {
+        return hi_ < o.hi_ || (hi_ == o.hi_ && lo_ < o.lo_);
+    }
+
+    bool operator<=(const hash128_t& o) const {
+        return !(o < *this);
+    }
+};
+
+inline hash128_t operator^(const hash128_t& a, const hash128_t& b) {
+    return hash128_t(a.lo_ ^ b.lo_, a.hi_ ^ b.hi_);
+}
+
+inline hash128_t operator&(const hash128_t& a, const hash128_t& b) {
+    return hash128_t(a.lo_ & b.lo_, a.hi_ & b.hi_);
+}
+
+inline hash128_t operator|(const hash128_t& a, const hash128_t& b) {
+    return hash128_t(a.lo_ | b.lo_, a.hi_ | b.hi_);
+}
+
+/** Max length of anchor, hash of which fits into hash128_t */
+const int MAX_WIDE_ANCHOR_SIZE = sizeof(hash128_t) * 8 / 2;
+
+/** Reduce hash to hash_t (e.g., to pass it to Bloom filter) */
+inline hash_t fold_hash(hash_t hash) {
+    return hash;
+}
+
+/** Reduce hash to hash_t (e.g., to pass it to Bloom filter) */
+inline hash_t fold_hash(const hash128_t& hash) {
+    return hash.lo_ ^ (hash.hi_ * 0x9e3779b97f4a7c15ULL);
+}
+
+}
+
+#endif
+
@@ -26,17 +26,29 @@ inline size_t shift_in_hash(int pos) {
     return ((pos * POS_BITS) % (sizeof(hash_t) * BYTE_BITS));
 }
 
-template<typename F, int ori>
-hash_t make_hash_base(F f, pos_t length) {
-    hash_t result = 0;
+/** Position of letter in hash of type H */
+template<typename H>
+inline size_t shift_in_hash(int pos) {
+    return ((pos * POS_BITS) % (sizeof(H) * BYTE_BITS));
+}
+
+/** Max number of letters, hash of which fits into H */
+template<typename H>
+inline int max_hash_letters() {
+    return sizeof(H) * BYTE_BITS / POS_BITS;
+}
+
+template<typename H, typename F, int ori>
+H make_hash_base(F f, pos_t length) {
+    H result = 0;
     for (pos_t j = 0; j < length; j++) {
         char c = f(j);
         size_t s = char_to_size(c) & LAST_TWO_BITS;
         if (ori == -1 && c != 'N') {
             s = complement_letter(s);
         }
-        hash_t value = s;
-        result ^= value << shift_in_hash(j);
+        H value = hash_t(s);
+        result ^= value << shift_in_hash<H>(j);
     }
     return result;
 }
@@ -59,54 +71,112 @@ struct FChar {
     }
 };
 
-/** Make hash value from fragment of sequence.
+/** Make hash value of type H from fragment of sequence.
 \param start Beginning of the fragment
 \param length Length of the fragment
 \param ori Orientation of the fragment (1 or -1)
 */
-inline hash_t make_hash(const char* start, pos_t length,
-                        int ori = 1) {
+template<typename H>
+H make_hash(const char* start, pos_t length, int ori = 1) {
     if (ori == 1) {
         typedef FChar<1> F;
         F fchar((start));
-        return make_hash_base<F, 1>(fchar, length);
+        return make_hash_base<H, F, 1>(fchar, length);
     } else {
         typedef FChar < -1 > F;
         F fchar((start));
-        return make_hash_base < F, -1 > (fchar, length);
+        return make_hash_base < H, F, -1 > (fchar, length);
     }
 }
 
-/** Make hash value from previous hash value (optimization).
-\param old_hash Previous hash value
+/** Make hash value from fragment of sequence.
+\param start Beginning of the fragment
 \param length Length of the fragment
-\param forward If moved in according with the fragment's direction
-\param remove_char Nucleotide, removed from the hash value.
-\param add_char New nucleotide, added to the hash value.
-Nucleotides add_char and remove_char should be pre-complement'ed, if needed.
+\param ori Orientation of the fragment (1 or -1)
 */
-inline hash_t reuse_hash(hash_t old_hash, pos_t length,
-                         char remove_char, char add_char,
-                         bool forward = true) {
-    hash_t remove = char_to_size(remove_char) & LAST_TWO_BITS;
-    old_hash ^= remove << shift_in_hash(forward ?
-                                        0 : length - 1);
+inline hash_t make_hash(const char* start, pos_t length,
+                        int ori = 1) {
+    return make_hash<hash_t>(start, length, ori);
+}
+
+/** Complement hash of fragment of length <= MAX_ANCHOR_SIZE.
+Equivalent to complement_hash(hash, letters_number) for
+hashes of fragments without 'N', but branch-free:
+letters are complemented and reordered with bit operations.
+*/
+inline hash_t complement_short_hash(hash_t hash,
+                                    int letters_number) {
+    // complement_letter(x) = x ^ 1
+    hash ^= hash_t(0x5555555555555555ULL);
+    // reverse order of 2-bit letters
+    hash = ((hash >> 2) & hash_t(0x3333333333333333ULL)) |
+           ((hash & hash_t(0x3333333333333333ULL)) << 2);
+    hash = ((hash >> 4) & hash_t(0x0F0F0F0F0F0F0F0FULL)) |
+           ((hash & hash_t(0x0F0F0F0F0F0F0F0FULL)) << 4);
+    hash = ((hash >> 8) & hash_t(0x00FF00FF00FF00FFULL)) |
+           ((hash & hash_t(0x00FF00FF00FF00FFULL)) << 8);
+    hash = ((hash >> 16) & hash_t(0x0000FFFF0000FFFFULL)) |
+           ((hash & hash_t(0x0000FFFF0000FFFFULL)) << 16);
+    hash = (hash >> 32) | (hash << 32);
+    int unused_bits = (MAX_ANCHOR_SIZE - letters_number) * POS_BITS;
+    return hash >> unused_bits;
+}
+
+/** Mix bits of hash value (finalizer of MurmurHash3).
+Hashes of neighbour k-mers differ in few bits;
+mixed hashes look random.
+*/
+inline hash_t mix_hash(hash_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+/** Make hash value of type H from previous hash value.
+\see reuse_hash(hash_t, pos_t, char, char, bool)
+*/
+template<typename H>
+H reuse_hash(H old_hash, pos_t length,
+             char remove_char, char add_char,
+             bool forward = true) {
+    H remove = hash_t(char_to_size(remove_char) & LAST_TWO_BITS);
+    old_hash ^= remove << shift_in_hash<H>(forward ?
+                                           0 : length - 1);
     int occupied = std::min(int(POS_BITS * length),
-                            int(BYTE_BITS * sizeof(hash_t)));
+                            int(BYTE_BITS * sizeof(H)));
+    H last_two_bits = LAST_TWO_BITS;
     if (forward) {
         old_hash = (old_hash >> POS_BITS) |
-                   ((old_hash & LAST_TWO_BITS) <<
+                   ((old_hash & last_two_bits) <<
                     (occupied - POS_BITS));
     } else {
         old_hash = (old_hash << POS_BITS) |
                    ((old_hash >> (occupied - POS_BITS)) &
-                    LAST_TWO_BITS);
+                    last_two_bits);
     }
-    hash_t add = char_to_size(add_char) & LAST_TWO_BITS;
-    old_hash ^= add << shift_in_hash(forward ? length - 1 : 0);
+    H add = hash_t(char_to_size(add_char) & LAST_TWO_BITS);
+    old_hash ^= add << shift_in_hash<H>(forward ? length - 1 : 0);
     return old_hash;
 }
 
+/** Make hash value from previous hash value (optimization).
+\param old_hash Previous hash value
+\param length Length of the fragment
+\param forward If moved in according with the fragment's direction
+\param remove_char Nucleotide, removed from the hash value.
+\param add_char New nucleotide, added to the hash value.
+Nucleotides add_char and remove_char should be pre-complement'ed, if needed.
+*/
+inline hash_t reuse_hash(hash_t old_hash, pos_t length,
+                         char remove_char, char add_char,
+                         bool forward = true) {
+    return reuse_hash<hash_t>(old_hash, length,
+                              remove_char, add_char, forward);
+}
+
 }
 
 #endif
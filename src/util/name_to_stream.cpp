@@ -38,6 +38,7 @@
 #include <boost/algorithm/string/replace.hpp>
 
 #include "name_to_stream.hpp"
+#include "gzip_stream.hpp"
 #include "reentrant_getenv.hpp"
 #include "Exception.hpp"
 
@@ -107,6 +108,9 @@ IstreamPtr name_to_istream(const std::string& name) {
         if (!result->is_open()) {
             throw Exception("Error opening file " + name);
         }
+        if (is_gzip_name(name)) {
+            return gzip_istream(result);
+        }
         return result;
     }
 }
@@ -129,11 +133,19 @@ OstreamPtr name_to_ostream(const std::string& name) {
     } else if (name.empty() || name[0] == ':') {
         return boost::make_shared<std::ostringstream>();
     } else {
+        bool gzip = is_gzip_name(name);
+        std::ios_base::openmode mode = std::ios_base::out;
+        if (gzip) {
+            mode |= std::ios_base::binary;
+        }
         boost::shared_ptr<std::ofstream> result =
-            boost::make_shared<std::ofstream>(name.c_str());
+            boost::make_shared<std::ofstream>(name.c_str(), mode);
         if (!result->is_open()) {
             throw Exception("Error opening file " + name);
         }
+        if (gzip) {
+            return gzip_ostream(result);
+        }
         return result;
     }
 }
@@ -166,6 +178,17 @@ void remove_file(const std::string& name) {
     }
 }
 
+void rename_file(const std::string& old_name,
+                 const std::string& new_name) {
+    using namespace boost::filesystem;
+    try {
+        rename(old_name, new_name);
+    } catch (const filesystem_error& e) {
+        throw Exception("Can't rename " + old_name + " to " +
+                        new_name + ": " + e.what());
+    }
+}
+
 // http://stackoverflow.com/a/13062069
 template<typename T>
 struct array_deleter {
@@ -278,6 +301,12 @@ bool file_exists(const std::string& p) {
     return fs::exists(fs::path(p));
 }
 
+bool is_newer(const std::string& path1,
+              const std::string& path2) {
+    return fs::last_write_time(fs::path(path1)) >
+           fs::last_write_time(fs::path(path2));
+}
+
 bool is_dir(const std::string& p) {
     return fs::is_directory(fs::path(p));
 }
@@ -22,6 +22,7 @@ If name is predefined (see set_istream()), returns corresponding stream.
 If name starts with ':' or is empty, returns std::istringstream.
 
 Otherwise returns std::ifstream.
+If name ends with ".gz", the file is decompressed (see gzip_istream()).
 
 Previous results are cached. To get them deleted/closed, call remove_istream().
 
@@ -47,6 +48,8 @@ If name is predefined (see set_ostream()), returns corresponding stream.
 If name starts with ':' or is empty, returns std::ostringstream.
 
 Otherwise returns std::ofstream.
+If name ends with ".gz", the output is compressed in BGZF format
+(see gzip_ostream()).
 
 Previous results are cached. To get them deleted/closed, call remove_ostream().
 
@@ -81,6 +84,12 @@ This function is thread-safe.
 */
 void remove_file(const std::string& name);
 
+/** Rename file replacing existing file new_name.
+Throws Exception on failure.
+*/
+void rename_file(const std::string& old_name,
+                 const std::string& new_name);
+
 /** Return home directory.
 Returns path to home directory in Windows and Unix,
 if fails, returns dftl.
@@ -112,6 +121,15 @@ std::string system_complete(const std::string& p);
 /** Return if path exists */
 bool file_exists(const std::string& path);
 
+/** Return if path1 was modified later than path2.
+Both files must exist.
+Modification time has resolution of one second, so files
+modified in the same second are not considered newer
+(path2 may have been changed after path1 was written).
+*/
+bool is_newer(const std::string& path1,
+              const std::string& path2);
+
 /** Return if path is directory */
 bool is_dir(const std::string& path);
 
@@ -4,6 +4,7 @@ seqs = {Sequence.new(),
     Sequence.new(Sequence.ASIS_SEQUENCE),
     Sequence.new(Sequence.COMPACT_SEQUENCE),
     Sequence.new(Sequence.COMPACT_LOW_N_SEQUENCE),
+    Sequence.new(Sequence.PACKED_SEQUENCE),
 }
 for _, s in pairs(seqs) do
     s:push_back("")